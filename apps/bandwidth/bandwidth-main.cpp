@@ -1,53 +1,282 @@
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include <vector>
 
+#include <unistd.h>
+
 #include <task.h>
 
 #include "bandwidth.h"
 
-void Bandwidth(task::mmaps<Elem, kBankCount> chan, uint64_t n, uint64_t flags);
+void Bandwidth(task::mmaps<Elem, kBankCount> chan,
+               task::mmaps<uint64_t, kBankCount> stats, uint64_t n,
+               uint64_t flags);
 
-int main(int argc, char *argv[]) {
-  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024 * 1024;
-  const uint64_t flags = argc > 2 ? atoll(argv[2]) : 6LL;
+namespace {
+
+// Runs BankCount banks of Copy<T, Outstanding>.
+template <typename T, int BankCount, int Outstanding>
+void Run(task::mmaps<T, BankCount> chan,
+         task::mmaps<uint64_t, BankCount> stats, uint64_t n, uint64_t flags) {
+  task::parallel().invoke<BankCount>(Copy<T, Outstanding>, chan, stats, n,
+                                     flags);
+}
+
+// The synthesized configuration runs the kernel itself.
+template <>
+void Run<Elem, kBankCount, kEstimatedLatency>(
+    task::mmaps<Elem, kBankCount> chan,
+    task::mmaps<uint64_t, kBankCount> stats, uint64_t n, uint64_t flags) {
+  Bandwidth(chan, stats, n, flags);
+}
+
+// Returns the upper bound of the latency bucket that contains the given
+// fraction of read requests.
+uint64_t GetPercentile(const uint64_t *histogram, double fraction) {
+  uint64_t total = 0;
+  for (int i = 0; i < kLatencyBucketCount; ++i) {
+    total += histogram[i];
+  }
+  uint64_t count = 0;
+  for (int i = 0; i < kLatencyBucketCount; ++i) {
+    count += histogram[i];
+    if (total > 0 && count >= fraction * total) {
+      return uint64_t(2) << i;
+    }
+  }
+  return 0;
+}
+
+// Reports the bandwidth and read latency of Copy in one line, given the
+// statistics written by each bank.
+template <typename T>
+void Report(int bank_count, int outstanding, uint64_t n, uint64_t flags,
+            double elapsed_ns, const std::vector<uint64_t> *stats) {
+  // a copy moves each element twice
+  const bool read = flags & kRead;
+  const bool write = flags & kWrite;
+  const uint64_t bytes_per_bank = n * sizeof(T) * (int(read) + int(write));
 
-  std::vector<float> chan[kBankCount];
-  for (int64_t i = 0; i < kBankCount; ++i) {
-    chan[i].resize(n * Elem::length);
-    for (int64_t j = 0; j < n * Elem::length; ++j) {
+  uint64_t histogram[kLatencyBucketCount] = {};
+  std::string per_bank;
+  for (int i = 0; i < bank_count; ++i) {
+    for (int j = 0; j < kLatencyBucketCount; ++j) {
+      histogram[j] += stats[i][j];
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%.3f", i == 0 ? "" : " ",
+             double(bytes_per_bank) / stats[i][kStatElapsed]);
+    per_bank += buf;
+  }
+
+  // bytes per ns is GB/s
+  printf("%10d %5d %11d %-10s %-5s %9.3f  %s", int(sizeof(T)), bank_count,
+         outstanding, flags & kRandom ? "random" : "sequential",
+         read ? write ? "copy" : "read" : "write",
+         bytes_per_bank * bank_count / elapsed_ns, per_bank.c_str());
+  if (read) {
+    printf("%*s  p50 < %" PRIu64, std::max(0, 24 - int(per_bank.size())), "",
+           GetPercentile(histogram, .5));
+    printf(" p99 < %" PRIu64 " |", GetPercentile(histogram, .99));
+    for (int i = 0; i < kLatencyBucketCount; ++i) {
+      if (histogram[i] > 0) {
+        printf(" %" PRIu64 ":%" PRIu64, uint64_t(1) << i, histogram[i]);
+      }
+    }
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+constexpr int64_t kErrorThreshold = 10; // only report up to these errors
+
+// Checks that element j of bank i still holds i ^ j after a copy, and returns
+// num_errors plus the number of mismatches.
+int64_t CheckBank(int64_t i, const float *bank, uint64_t size,
+                  int64_t num_errors) {
+  for (uint64_t j = 0; j < size; ++j) {
+    int64_t expected = i ^ j;
+    int64_t actual = bank[j];
+    if (actual != expected) {
+      if (num_errors < kErrorThreshold) {
+        LOG(ERROR) << "expected: " << expected << ", actual: " << actual;
+      } else if (num_errors == kErrorThreshold) {
+        LOG(ERROR) << "...";
+      }
+      ++num_errors;
+    }
+  }
+  return num_errors;
+}
+
+void ReportErrors(int64_t num_errors) {
+  if (num_errors > kErrorThreshold) {
+    LOG(WARNING) << " (+" << (num_errors - kErrorThreshold)
+                 << " more errors)";
+  }
+}
+
+// Measures the bandwidth of Copy with the given configuration, reports it in
+// one line per point, and returns the number of errors found in copied data.
+template <int Lanes, int BankCount, int Outstanding>
+int64_t Measure(uint64_t n, uint64_t flags, const task::memory_model *model) {
+  using T = task::vec_t<float, Lanes>;
+
+  // each bank is placed on its own NUMA node if there are enough
+  task::buffers<float, BankCount> chan(n * Lanes);
+  for (int64_t i = 0; i < BankCount; ++i) {
+    for (uint64_t j = 0; j < n * Lanes; ++j) {
       chan[i][j] = i ^ j;
     }
   }
+  std::vector<uint64_t> stats[BankCount];
+  for (auto &bank_stats : stats) {
+    bank_stats.resize(kStatCount);
+  }
+
+  task::mmaps<float, BankCount> mem(chan);
+  if (model != nullptr) {
+    task::memory_model bank_model = *model;
+    bank_model.max_outstanding = Outstanding;
+    mem.set_memory_model(bank_model);
+  }
 
-  Bandwidth(task::mmaps<float, kBankCount>(chan).vectorized<Elem::length>(), n,
-            flags);
+  const auto begin = std::chrono::steady_clock::now();
+  Run<T, BankCount, Outstanding>(mem.template vectorized<Lanes>(),
+                                 task::mmaps<uint64_t, BankCount>(stats), n,
+                                 flags);
+  const double elapsed_ns =
+      std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - begin)
+          .count();
+  Report<T>(BankCount, Outstanding, n, flags, elapsed_ns, stats);
 
   if (!((flags & kRead) && (flags & kWrite)))
     return 0;
 
   int64_t num_errors = 0;
-  const int64_t threshold = 10; // only report up to these errors
-  for (int64_t i = 0; i < kBankCount; ++i) {
-    for (int64_t j = 0; j < n * Elem::length; ++j) {
-      int64_t expected = i ^ j;
-      int64_t actual = chan[i][j];
-      if (actual != expected) {
-        if (num_errors < threshold) {
-          LOG(ERROR) << "expected: " << expected << ", actual: " << actual;
-        } else if (num_errors == threshold) {
-          LOG(ERROR) << "...";
-        }
-        ++num_errors;
-      }
+  for (int64_t i = 0; i < BankCount; ++i) {
+    num_errors = CheckBank(i, chan[i].data(), n * Lanes, num_errors);
+  }
+  ReportErrors(num_errors);
+  return num_errors;
+}
+
+// Measures the bandwidth of Copy on a temporary file of n elements instead of
+// memory, reports it in one line, and returns the number of errors found in
+// copied data.
+template <int Lanes> int64_t MeasureFile(uint64_t n, uint64_t flags) {
+  using T = task::vec_t<float, Lanes>;
+
+  std::vector<float> data(n * Lanes);
+  for (uint64_t j = 0; j < n * Lanes; ++j) {
+    data[j] = j;
+  }
+  const ssize_t bytes = data.size() * sizeof(float);
+  char path[] = "/tmp/bandwidth-XXXXXX";
+  const int fd = mkstemp(path);
+  CHECK_NE(fd, -1) << "cannot create '" << path << "'";
+  CHECK_EQ(pwrite(fd, data.data(), bytes, 0), bytes)
+      << "cannot write '" << path << "'";
+  std::vector<uint64_t> stats(kStatCount);
+
+  task::file<T> file(path, /*is_writable=*/true);
+  const auto begin = std::chrono::steady_clock::now();
+  task::parallel().invoke(Copy<T, kEstimatedLatency, task::async_file<T>>,
+                          file, task::mmap<uint64_t>(stats), n, flags);
+  const double elapsed_ns =
+      std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - begin)
+          .count();
+  Report<T>(1, kEstimatedLatency, n, flags, elapsed_ns, &stats);
+
+  // writes are acknowledged once they reach the page cache
+  CHECK_EQ(pread(fd, data.data(), bytes, 0), bytes)
+      << "cannot read '" << path << "'";
+  close(fd);
+  unlink(path);
+
+  if (!((flags & kRead) && (flags & kWrite)))
+    return 0;
+
+  const int64_t num_errors = CheckBank(0, data.data(), data.size(), 0);
+  ReportErrors(num_errors);
+  return num_errors;
+}
+
+// Measures each access pattern and read/write mix.
+template <int Lanes, int BankCount, int Outstanding>
+int64_t SweepFlags(uint64_t n, const task::memory_model *model) {
+  int64_t num_errors = 0;
+  for (uint64_t pattern : {uint64_t(0), kRandom}) {
+    for (uint64_t mix : {kRead, kWrite, kRead | kWrite}) {
+      num_errors +=
+          Measure<Lanes, BankCount, Outstanding>(n, pattern | mix, model);
     }
   }
+  return num_errors;
+}
+
+template <int Lanes, int BankCount>
+int64_t SweepOutstanding(uint64_t n, const task::memory_model *model) {
+  return SweepFlags<Lanes, BankCount, 1>(n, model) +
+         SweepFlags<Lanes, BankCount, 8>(n, model) +
+         SweepFlags<Lanes, BankCount, kEstimatedLatency>(n, model) +
+         SweepFlags<Lanes, BankCount, 256>(n, model);
+}
+
+template <int Lanes>
+int64_t SweepBanks(uint64_t n, const task::memory_model *model) {
+  return SweepOutstanding<Lanes, 1>(n, model) +
+         SweepOutstanding<Lanes, 2>(n, model) +
+         SweepOutstanding<Lanes, kBankCount>(n, model);
+}
+
+int64_t Sweep(uint64_t n, const task::memory_model *model) {
+  return SweepBanks<1>(n, model) + SweepBanks<4>(n, model) +
+         SweepBanks<Elem::length>(n, model) + SweepBanks<64>(n, model);
+}
+
+} // namespace
+
+// Usage: bandwidth [n] [flags] [latency_ns] [bandwidth_gbps]
+//
+// Each bank accesses n elements. Each line of the output reports a
+// configuration, its aggregate and per-bank bandwidth (in GB/s), and the
+// histogram of read latency (in ns), where "2^i:count" counts the requests
+// whose latency is in [2^i, 2^(i+1)).
+int main(int argc, char *argv[]) {
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 1024 * 1024;
+  const uint64_t flags = argc > 2 ? atoll(argv[2]) : 6LL;
+
+  // optionally models each bank as a memory channel with the given latency (in
+  // ns) and bandwidth (in GB/s)
+  task::memory_model model;
+  if (argc > 3) {
+    model.latency_ns = atof(argv[3]);
+    model.bandwidth_gbps = argc > 4 ? atof(argv[4]) : 0.;
+  }
+  const task::memory_model *model_ptr = argc > 3 ? &model : nullptr;
+
+  printf("elem_bytes banks outstanding pattern    mix        GB/s  "
+         "per-bank GB/s             read latency (ns)\n");
+  const int64_t num_errors =
+      flags & kSweep  ? Sweep(n, model_ptr)
+      : flags & kFile ? MeasureFile<Elem::length>(n, flags)
+                      : Measure<Elem::length, kBankCount, kEstimatedLatency>(
+                            n, flags, model_ptr);
+
+  if (!(flags & kSweep) && !((flags & kRead) && (flags & kWrite)))
+    return 0;
+
   if (num_errors == 0) {
     LOG(INFO) << "PASS!";
   } else {
-    if (num_errors > threshold) {
-      LOG(WARNING) << " (+" << (num_errors - threshold) << " more errors)";
-    }
     LOG(INFO) << "FAIL!";
   }
   return num_errors > 0 ? 1 : 0;
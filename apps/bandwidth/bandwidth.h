@@ -1,3 +1,9 @@
+#include <cstdint>
+
+#ifndef __SYNTHESIS__
+#include <chrono>
+#endif // __SYNTHESIS__
+
 #include <task.h>
 
 using Elem = task::vec_t<float, 16>;
@@ -7,3 +13,125 @@ constexpr int kEstimatedLatency = 50;
 constexpr uint64_t kRandom = 1 << 0;
 constexpr uint64_t kRead = 1 << 1;
 constexpr uint64_t kWrite = 1 << 2;
+// sweeps element width, bank count, outstanding requests, access pattern, and
+// read/write mix instead of running the configuration above
+constexpr uint64_t kSweep = 1 << 3;
+// accesses a temporary file via task::async_file instead of memory
+constexpr uint64_t kFile = 1 << 4;
+
+// Statistics written by each bank: bucket i counts the read requests whose
+// latency is in [2^i, 2^(i+1)), followed by the elapsed time of the bank.
+constexpr int kLatencyBucketCount = 32;
+constexpr int kStatElapsed = kLatencyBucketCount;
+constexpr int kStatCount = kLatencyBucketCount + 1;
+
+// Returns the current time in ns in software simulation, or the loop
+// iteration in hardware, where the loop is pipelined to 1 iteration per cycle.
+inline uint64_t Timestamp(uint64_t iteration) {
+#ifdef __SYNTHESIS__
+  return iteration;
+#else  // __SYNTHESIS__
+  (void)iteration;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif // __SYNTHESIS__
+}
+
+inline int GetLatencyBucket(uint64_t latency) {
+  int bucket = 0;
+  [[task::unroll]] for (int i = 1; i < kLatencyBucketCount; ++i) {
+    if (latency >= (1ULL << i)) {
+      bucket = i;
+    }
+  }
+  return bucket;
+}
+
+// Accesses n elements of mem, keeping up to Outstanding requests in flight.
+// Mem may be any type with the channels of task::async_mmap<T>, e.g.,
+// task::async_file<T>.
+template <typename T, int Outstanding, typename Mem = task::async_mmap<T>>
+void Copy(Mem mem, task::mmap<uint64_t> stats, uint64_t n, uint64_t flags) {
+  const bool random = flags & kRandom;
+  const bool read = flags & kRead;
+  const bool write = flags & kWrite;
+
+  if (!read && !write)
+    return;
+
+  uint16_t mask = 0xffffu;
+  [[task::unroll]] for (int i = 16; i > 0; --i) {
+    if (n < (1ULL << i)) {
+      mask >>= 1;
+    }
+  }
+
+  uint16_t lfsr_rd = 0xbeefu;
+  uint16_t lfsr_wr = 0xbeefu;
+  bool valid = false;
+  bool addr_ready = false;
+  bool data_ready = false;
+  T elem;
+
+  // read responses arrive in order, so the issue time of each outstanding
+  // request is kept in a ring buffer
+  uint64_t issue_time[Outstanding] = {};
+  uint64_t histogram[kLatencyBucketCount] = {};
+  uint64_t iteration = 0;
+  const uint64_t begin = Timestamp(iteration);
+
+  for (uint64_t i_rd_req = 0, i_rd_resp = 0, i_wr_req = 0, i_wr_resp = 0;
+       write ? (i_wr_resp < n) : (i_rd_resp < n); ++iteration) {
+
+    if (read && i_rd_req < i_rd_resp + Outstanding && i_rd_req < n &&
+        mem.read_addr.try_write(random ? uint64_t(lfsr_rd & mask)
+                                       : i_rd_req)) {
+      issue_time[i_rd_req % Outstanding] = Timestamp(iteration);
+      ++i_rd_req;
+      uint16_t bit =
+          (lfsr_rd >> 0) ^ (lfsr_rd >> 2) ^ (lfsr_rd >> 3) ^ (lfsr_rd >> 5);
+      lfsr_rd = (lfsr_rd >> 1) | (bit << 15);
+    }
+
+    if (read && (!write || !valid) && mem.read_data.try_read(elem)) {
+      const uint64_t latency =
+          Timestamp(iteration) - issue_time[i_rd_resp % Outstanding];
+      ++histogram[GetLatencyBucket(latency)];
+      valid = true;
+      ++i_rd_resp;
+    }
+
+    if (write && !addr_ready && i_wr_req < n) {
+      auto addr = random ? uint64_t(lfsr_wr & mask) : i_wr_req;
+      addr_ready = mem.write_addr.try_write(addr);
+    }
+
+    if (write && (!read || valid) && !data_ready && i_wr_req < n) {
+      data_ready = mem.write_data.try_write(elem);
+    }
+
+    // polls responses only if enough writes are outstanding so that writes
+    // can be served in bursts
+    if (write && (i_wr_req == n || i_wr_req >= i_wr_resp + Outstanding) &&
+        !mem.write_resp.empty()) {
+      i_wr_resp += mem.write_resp.read(nullptr) + 1;
+    }
+
+    if (addr_ready && data_ready) {
+      valid = false;
+      addr_ready = false;
+      data_ready = false;
+      ++i_wr_req;
+      uint16_t bit =
+          (lfsr_wr >> 0) ^ (lfsr_wr >> 2) ^ (lfsr_wr >> 3) ^ (lfsr_wr >> 5);
+      lfsr_wr = (lfsr_wr >> 1) | (bit << 15);
+    }
+  }
+
+  const uint64_t end = Timestamp(iteration);
+  for (int i = 0; i < kLatencyBucketCount; ++i) {
+    stats[i] = histogram[i];
+  }
+  stats[kStatElapsed] = end - begin;
+}
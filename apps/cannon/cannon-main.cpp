@@ -37,38 +37,9 @@ int main(int argc, char *argv[]) {
   }
 
   auto start = high_resolution_clock::now();
-  // reshape the matrices into 2x2 blocks (each has size n/2 x n/2)
-  const int p = 2;
-  vector<float> a_buf(n * n);
-  vector<float> b_buf(n * n);
-  vector<float> c_buf(n * n);
-  auto a_block = reinterpret_cast<float(*)[p][n / p][n / p]>(a_buf.data());
-  auto b_block = reinterpret_cast<float(*)[p][n / p][n / p]>(b_buf.data());
-  auto c_block = reinterpret_cast<float(*)[p][n / p][n / p]>(c_buf.data());
-
-  for (uint64_t i = 0; i < p; ++i) {
-    for (uint64_t j = 0; j < p; ++j) {
-      for (uint64_t ii = 0; ii < n / p; ++ii) {
-        for (uint64_t jj = 0; jj < n / p; ++jj) {
-          a_block[i][(i + j) % p][ii][jj] = a[i * n / p + ii][j * n / p + jj];
-          b_block[(i + j) % p][j][ii][jj] = b[i * n / p + ii][j * n / p + jj];
-        }
-      }
-    }
-  }
-
-  Cannon(task::mmap<const float>(a_buf), task::mmap<const float>(b_buf),
-         task::mmap<float>(c_buf), n);
-
-  for (uint64_t i = 0; i < p; ++i) {
-    for (uint64_t j = 0; j < p; ++j) {
-      for (uint64_t ii = 0; ii < n / p; ++ii) {
-        for (uint64_t jj = 0; jj < n / p; ++jj) {
-          c[i * n / p + ii][j * n / p + jj] = c_block[i][j][ii][jj];
-        }
-      }
-    }
-  }
+  // the kernel reads and writes the blocks of each matrix in place
+  Cannon(task::mmap<const float>(a_vec), task::mmap<const float>(b_vec),
+         task::mmap<float>(c_vec), n);
   auto stop = high_resolution_clock::now();
   duration<double> elapsed = stop - start;
   clog << "elapsed time: " << elapsed.count() << " s" << endl;
@@ -9,48 +9,44 @@ const int p = 2;
 // Handles kN x kN matrices maximum.
 const int kN = 64; // Use fixed value for efficient hardware generation.
 
-// Scatter n*n matrix into p*p blocks, each block.
-void Scatter(task::mmap<const float> matrix_ptr, task::ostream<float> &block_00,
-             task::ostream<float> &block_01, task::ostream<float> &block_10,
-             task::ostream<float> &block_11) {
-  const uint64_t kNumElems = (kN / p) * (kN / p);
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_00.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_01.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_10.write(*matrix_ptr);
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    block_11.write(*matrix_ptr);
-    ++matrix_ptr;
+// Scatter n*n matrix into p*p blocks, each block to one PE. The PE at (i, j)
+// initially gets block (i, j - i) of a if is_b is false, or block (i - j, j)
+// of b otherwise, wrapping around. Blocks are read in place row by row.
+void Scatter(task::mmap_view<const float, 2> matrix, bool is_b,
+             task::ostream<float> &block_00, task::ostream<float> &block_01,
+             task::ostream<float> &block_10, task::ostream<float> &block_11) {
+  task::ostream<float> *blocks[p][p] = {{&block_00, &block_01},
+                                        {&block_10, &block_11}};
+  for (uint64_t i = 0; i < p; ++i) {
+    for (uint64_t j = 0; j < p; ++j) {
+      auto block = is_b ? matrix.tile<kN / p, kN / p>((i + p - j) % p, j)
+                        : matrix.tile<kN / p, kN / p>(i, (j + p - i) % p);
+      for (uint64_t ii = 0; ii < kN / p; ++ii) {
+        auto row = block.row(ii);
+        for (uint64_t jj = 0; jj < kN / p; ++jj) {
+          blocks[i][j]->write(row[jj]);
+        }
+      }
+    }
   }
 }
 
-void Gather(task::mmap<float> matrix_ptr, task::istream<float> &block_00,
+// Gather p*p blocks into n*n matrix, each block from one PE.
+void Gather(task::mmap_view<float, 2> matrix, task::istream<float> &block_00,
             task::istream<float> &block_01, task::istream<float> &block_10,
             task::istream<float> &block_11) {
-  const uint64_t kNumElems = (kN / p) * (kN / p);
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_00.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_01.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_10.read();
-    ++matrix_ptr;
-  }
-  for (uint64_t i = 0; i < kNumElems; ++i) {
-    *matrix_ptr = block_11.read();
-    ++matrix_ptr;
+  task::istream<float> *blocks[p][p] = {{&block_00, &block_01},
+                                        {&block_10, &block_11}};
+  for (uint64_t i = 0; i < p; ++i) {
+    for (uint64_t j = 0; j < p; ++j) {
+      auto block = matrix.tile<kN / p, kN / p>(i, j);
+      for (uint64_t ii = 0; ii < kN / p; ++ii) {
+        auto row = block.row(ii);
+        for (uint64_t jj = 0; jj < kN / p; ++jj) {
+          row[jj] = blocks[i][j]->read();
+        }
+      }
+    }
   }
 }
 
@@ -104,7 +100,7 @@ void ProcElem(task::istream<float> &a_fifo, task::istream<float> &b_fifo,
 void Cannon(task::mmap<const float> a_vec, task::mmap<const float> b_vec,
             task::mmap<float> c_vec, uint64_t n) {
   assert(kN % p == 0);
-  assert(n <= kN);
+  assert(n == kN);
 
   task::stream<float, 2> a_00("a->PE00");
   task::stream<float, 2> a_01("a->PE01");
@@ -128,8 +124,8 @@ void Cannon(task::mmap<const float> a_vec, task::mmap<const float> b_vec,
   task::stream<float, 8> fifo_11_01("PE11->PE01");
 
   task::parallel()
-      .invoke(Scatter, a_vec, a_00, a_01, a_10, a_11)
-      .invoke(Scatter, b_vec, b_00, b_01, b_10, b_11)
+      .invoke(Scatter, a_vec.reshape(n, n), false, a_00, a_01, a_10, a_11)
+      .invoke(Scatter, b_vec.reshape(n, n), true, b_00, b_01, b_10, b_11)
       .invoke(ProcElem, a_00, b_00, c_00, fifo_00_10, fifo_10_00, fifo_00_01,
               fifo_01_00)
       .invoke(ProcElem, a_01, b_01, c_01, fifo_01_11, fifo_11_01, fifo_01_00,
@@ -138,5 +134,5 @@ void Cannon(task::mmap<const float> a_vec, task::mmap<const float> b_vec,
               fifo_11_10)
       .invoke(ProcElem, a_11, b_11, c_11, fifo_11_01, fifo_01_11, fifo_11_10,
               fifo_10_11)
-      .invoke(Gather, c_vec, c_00, c_01, c_10, c_11);
+      .invoke(Gather, c_vec.reshape(n, n), c_00, c_01, c_10, c_11);
 }
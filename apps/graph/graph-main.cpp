@@ -3,6 +3,7 @@
 #include <chrono>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -38,12 +39,13 @@ void Graph(Pid num_partitions, task::mmap<const Vid> num_vertices,
            task::mmap<const Eid> num_edges, task::mmap<VertexAttr> vertices,
            task::mmap<const Edge> edges, task::mmap<Update> updates);
 
-void Graph(Vid base_vid, vector<VertexAttr> &vertices,
-           const vector<Edge> &edges) {
+void Graph(Vid base_vid, vector<VertexAttr> &vertices, const Edge *edges,
+           Eid num_edges) {
   bool has_update = true;
   while (has_update) {
     has_update = false;
-    for (const auto &edge : edges) {
+    for (Eid i = 0; i < num_edges; ++i) {
+      const auto &edge = edges[i];
       if (vertices[edge.src - base_vid] < vertices[edge.dst - base_vid]) {
         vertices[edge.dst - base_vid] = vertices[edge.src - base_vid];
         has_update = true;
@@ -52,10 +54,39 @@ void Graph(Vid base_vid, vector<VertexAttr> &vertices,
   }
 }
 
+// Usage: graph <edge list or cache> [partition size] [cache to write]
+//
+// The input is either a text edge list, which is partitioned and optionally
+// saved as a cache, or a cache saved before, which is mapped into memory
+// without parsing or copying.
 int main(int argc, char *argv[]) {
-  const size_t partition_size = argc > 2 ? atoi(argv[2]) : 1024;
-  auto partitions =
-      nxgraph::LoadEdgeList<Vid, Eid, VertexAttr>(argv[1], partition_size);
+  size_t partition_size = argc > 2 ? atoi(argv[2]) : 1024;
+  if (sizeof(Edge) != sizeof(nxgraph::Edge<Vid>)) {
+    throw runtime_error("inconsistent Edge type");
+  }
+
+  std::unique_ptr<task::mapped_file<const char>> cache_file;
+  vector<nxgraph::Partition<Vid, Eid, VertexAttr, std::nullptr_t>> partitions;
+  const Edge *cached_edges = nullptr;
+  if (nxgraph::IsCache(argv[1])) {
+    cache_file.reset(new task::mapped_file<const char>(argv[1]));
+    nxgraph::CacheView<Vid, Eid, VertexAttr> cache(cache_file->get(),
+                                                   cache_file->size());
+    LOG_IF(WARNING, argc > 2 && partition_size != cache.header().partition_size)
+        << "using partition size " << cache.header().partition_size
+        << " of the cache";
+    partition_size = cache.header().partition_size;
+    partitions = cache.partitions();
+    cached_edges = reinterpret_cast<const Edge *>(cache.edges());
+  } else {
+    nxgraph::VertexMapping<Vid> mapping;
+    partitions = nxgraph::LoadEdgeList<Vid, Eid, VertexAttr>(
+        argv[1], partition_size, &mapping);
+    if (argc > 3) {
+      nxgraph::SaveCache(argv[3], partitions, mapping, Vid(partition_size));
+      LOG(INFO) << "saved graph cache to " << argv[3];
+    }
+  }
   for (const auto &partition : partitions) {
     VLOG(6) << "partition";
     VLOG(6) << "num vertices: " << partition.num_vertices;
@@ -86,14 +117,17 @@ int main(int argc, char *argv[]) {
     vertices_baseline[i] = base_vid + i;
   }
 
-  vector<Edge> edges(total_num_edges);
-  if (sizeof(Edge) != sizeof(nxgraph::Edge<Vid>)) {
-    throw runtime_error("inconsistent Edge type");
-  }
-  auto edge_ptr = edges.data();
-  for (size_t i = 0; i < num_partitions; ++i) {
-    memcpy(edge_ptr, partitions[i].shard.get(), num_edges[i] * sizeof(Edge));
-    edge_ptr += num_edges[i];
+  // Shards of a cache are contiguous already.
+  vector<Edge> edge_buffer;
+  const Edge *edges = cached_edges;
+  if (edges == nullptr) {
+    edge_buffer.resize(total_num_edges);
+    auto edge_ptr = edge_buffer.data();
+    for (size_t i = 0; i < num_partitions; ++i) {
+      memcpy(edge_ptr, partitions[i].shard.get(), num_edges[i] * sizeof(Edge));
+      edge_ptr += num_edges[i];
+    }
+    edges = edge_buffer.data();
   }
   vector<Update> updates(total_num_edges * num_partitions);
   VLOG(10) << "num_vertices";
@@ -109,14 +143,15 @@ int main(int argc, char *argv[]) {
     VLOG(10) << v;
   }
   VLOG(10) << "edges: ";
-  for (auto e : edges) {
-    VLOG(10) << e.src << " -> " << e.dst;
+  for (Eid i = 0; i < total_num_edges; ++i) {
+    VLOG(10) << edges[i].src << " -> " << edges[i].dst;
   }
   VLOG(10) << "updates: " << updates.size();
   Graph(num_partitions, task::mmap<const Vid>(num_vertices),
         task::mmap<const Eid>(num_edges), task::mmap<VertexAttr>(vertices),
-        task::mmap<const Edge>(edges), task::mmap<Update>(updates));
-  Graph(base_vid, vertices_baseline, edges);
+        task::mmap<const Edge>(edges, total_num_edges),
+        task::mmap<Update>(updates));
+  Graph(base_vid, vertices_baseline, edges, total_num_edges);
   VLOG(10) << "vertices: ";
   for (auto v : vertices) {
     VLOG(10) << v;
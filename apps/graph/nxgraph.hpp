@@ -1,6 +1,10 @@
 
+#include <cctype>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <algorithm>
 #include <functional>
@@ -8,6 +12,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <fcntl.h>
@@ -18,6 +23,10 @@
 
 #include <glog/logging.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
 namespace nxgraph {
 
 template <typename Vid, typename EdgeAttr = std::nullptr_t> struct Edge {
@@ -50,89 +59,214 @@ struct Partition {
   std::unique_ptr<EdgeType, std::function<void(EdgeType *)>> shard;
 };
 
-// Processes text between begin_ptr and end_ptr and return the edge array as a
-// unique_ptr. If max_vid or min_vid is not nullptr, it will be updated.
-template <typename Vid, typename EdgeAttr = std::nullptr_t>
-inline std::vector<Edge<Vid, EdgeAttr>>
-ProcessEdgeList(const char *begin_ptr, const char *end_ptr,
-                Vid *max_vid = nullptr, Vid *min_vid = nullptr) {
-  using std::nullptr_t;
-  using std::numeric_limits;
-  using std::string;
-  using std::strtoull;
-  using std::unique_ptr;
-  using std::vector;
-  using EdgeType = Edge<Vid, EdgeAttr>;
-  if (max_vid != nullptr) {
-    *max_vid = numeric_limits<Vid>::min();
+// Vertex base_vid + i of the edge list is renamed to vids[i] in the partitions.
+template <typename Vid> struct VertexMapping {
+  Vid base_vid;
+  std::vector<Vid> vids;
+};
+
+namespace internal {
+
+// Chunks smaller than this are not worth a thread.
+constexpr size_t kMinChunkSize = 1 << 20;
+
+inline bool IsDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+// Converts 8 digit values, the most significant in the lowest byte, to an
+// integer with 3 multiplications.
+inline uint64_t ConvertEightDigits(uint64_t val) {
+  val = (val * 10) + (val >> 8);
+  return (((val & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+          (((val >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >>
+         32;
+}
+
+// Parses the decimal digits at ptr into *value and returns the pointer past
+// them, or ptr if there is no digit.
+inline const char *ParseDigits(const char *ptr, const char *end_ptr,
+                               uint64_t *value) {
+#if defined(__SSE2__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (end_ptr - ptr >= 16) {
+    // Finds the length of the digit run by comparing 16 characters at once;
+    // digits are the characters whose unsigned difference from '0' is < 10.
+    const __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    const __m128i biased = _mm_xor_si128(
+        _mm_sub_epi8(chars, _mm_set1_epi8('0')), _mm_set1_epi8(-128));
+    const unsigned mask = _mm_movemask_epi8(
+        _mm_cmplt_epi8(biased, _mm_set1_epi8(-128 + 10)));
+    const int length = __builtin_ctz(~mask);
+    if (length == 0) {
+      *value = 0;
+      return ptr;
+    }
+    if (length < 16) {
+      // Shifting left right-aligns the digits and drops the following
+      // characters; borrows of subtracting '0' only propagate to the latter.
+      constexpr uint64_t kZeros = 0x3030303030303030;
+      uint64_t first;
+      memcpy(&first, ptr, sizeof(first));
+      first -= kZeros;
+      if (length <= 8) {
+        *value = ConvertEightDigits(first << (8 * (8 - length)));
+      } else {
+        uint64_t last;
+        memcpy(&last, ptr + length - 8, sizeof(last));
+        *value = ConvertEightDigits(first << (8 * (16 - length))) * 100000000 +
+                 ConvertEightDigits(last - kZeros);
+      }
+      return ptr + length;
+    }
   }
-  if (min_vid != nullptr) {
-    *min_vid = numeric_limits<Vid>::max();
+#endif // __SSE2__
+  uint64_t result = 0;
+  for (; ptr < end_ptr && IsDigit(*ptr); ++ptr) {
+    result = result * 10 + (*ptr - '0');
   }
-  const char *next_pos = nullptr;
-  vector<EdgeType> edges;
-  for (const char *ptr = begin_ptr; ptr < end_ptr; ++ptr) {
+  *value = result;
+  return ptr;
+}
+
+// Returns the pointer past the next newline, or end_ptr if there is none.
+inline const char *SkipLine(const char *ptr, const char *end_ptr) {
+  auto newline = static_cast<const char *>(memchr(ptr, '\n', end_ptr - ptr));
+  return newline == nullptr ? end_ptr : newline + 1;
+}
+
+// Parses the complete lines between begin_ptr and end_ptr, appending the edges
+// to edges and updating max_vid and min_vid.
+template <typename Vid, typename EdgeAttr>
+void ProcessEdgeListChunk(const char *begin_ptr, const char *end_ptr,
+                          std::vector<Edge<Vid, EdgeAttr>> *edges,
+                          Vid *max_vid, Vid *min_vid) {
+  using EdgeType = Edge<Vid, EdgeAttr>;
+  // Roughly 10 characters per edge in SNAP files.
+  edges->reserve((end_ptr - begin_ptr) / 10);
+  Vid local_max_vid = *max_vid;
+  Vid local_min_vid = *min_vid;
+  for (const char *ptr = begin_ptr; ptr < end_ptr;) {
     // Skip spaces and tabs.
-    for (; isblank(*ptr); ++ptr) {
-      if (ptr >= end_ptr) {
-        break;
-      }
+    for (; ptr < end_ptr && isblank(*ptr); ++ptr) {
     }
 
-    /// Skip comment lines.
-    for (; *ptr == '#'; ++ptr) {
-      for (; *ptr != '\n' && *ptr != '\r'; ++ptr) {
-        if (ptr >= end_ptr) {
-          break;
-        }
-      }
-      for (; isblank(*ptr); ++ptr) {
-        if (ptr >= end_ptr) {
-          break;
-        }
-      }
-      if (ptr >= end_ptr) {
-        break;
-      }
+    // Skip empty lines, comments, and lines not starting with a vertex id.
+    if (ptr == end_ptr || !IsDigit(*ptr)) {
+      ptr = SkipLine(ptr, end_ptr);
+      continue;
     }
 
-    /// Swallows empty lines.
-    const Vid src = strtoull(ptr, const_cast<char **>(&next_pos), 10);
-    if (next_pos == ptr) {
-      break;
-    }
+    uint64_t src;
+    ptr = ParseDigits(ptr, end_ptr, &src);
 
-    /// Skip non-digits.
-    for (; !isdigit(*next_pos); ++next_pos) {
-      if (next_pos >= end_ptr) {
-        break;
-      }
+    // Skip the separator.
+    for (; ptr < end_ptr && !IsDigit(*ptr) && *ptr != '\n'; ++ptr) {
     }
 
-    const Vid dst = strtoull(next_pos, const_cast<char **>(&ptr), 10);
+    uint64_t dst;
+    const char *next_pos = ParseDigits(ptr, end_ptr, &dst);
     if (next_pos == ptr) {
-      break;
+      ptr = SkipLine(ptr, end_ptr);
+      continue;
     }
+    ptr = next_pos;
 
-    /// Skip spaces and tabs.
-    for (; isblank(*ptr); ++ptr) {
-      if (ptr >= end_ptr) {
-        break;
-      }
+    // Skip spaces and tabs.
+    for (; ptr < end_ptr && isblank(*ptr); ++ptr) {
     }
 
-    EdgeType edge{src, dst};
-    if (*ptr != '\n' && *ptr != '\r') {
+    EdgeType edge{Vid(src), Vid(dst)};
+    if (ptr < end_ptr && *ptr != '\n' && *ptr != '\r') {
       edge.LoadAttr(ptr, &next_pos);
       ptr = next_pos;
     }
-    if (max_vid != nullptr) {
-      *max_vid = std::max({*max_vid, src, dst});
-    }
-    if (min_vid != nullptr) {
-      *min_vid = std::min({*min_vid, src, dst});
-    }
-    edges.push_back(edge);
+    ptr = SkipLine(ptr, end_ptr);
+    local_max_vid = std::max({local_max_vid, edge.src, edge.dst});
+    local_min_vid = std::min({local_min_vid, edge.src, edge.dst});
+    edges->push_back(edge);
+  }
+  *max_vid = local_max_vid;
+  *min_vid = local_min_vid;
+}
+
+} // namespace internal
+
+// Processes text between begin_ptr and end_ptr and return the edge array as a
+// unique_ptr. If max_vid or min_vid is not nullptr, it will be updated.
+//
+// The text is split at line boundaries into up to thread_count chunks (default:
+// one per hardware thread), which are parsed in parallel and concatenated in
+// order.
+template <typename Vid, typename EdgeAttr = std::nullptr_t>
+inline std::vector<Edge<Vid, EdgeAttr>>
+ProcessEdgeList(const char *begin_ptr, const char *end_ptr,
+                Vid *max_vid = nullptr, Vid *min_vid = nullptr,
+                size_t thread_count = 0) {
+  using std::numeric_limits;
+  using std::vector;
+  using EdgeType = Edge<Vid, EdgeAttr>;
+
+  if (thread_count == 0) {
+    thread_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+  const size_t length = end_ptr - begin_ptr;
+  const size_t chunk_count =
+      std::max(size_t(1),
+               std::min(thread_count, length / internal::kMinChunkSize));
+
+  // Chunk i spans [chunk_ptrs[i], chunk_ptrs[i + 1]).
+  vector<const char *> chunk_ptrs(chunk_count + 1, end_ptr);
+  chunk_ptrs[0] = begin_ptr;
+  for (size_t i = 1; i < chunk_count; ++i) {
+    chunk_ptrs[i] = internal::SkipLine(
+        std::max(chunk_ptrs[i - 1], begin_ptr + length / chunk_count * i),
+        end_ptr);
+  }
+
+  vector<vector<EdgeType>> chunk_edges(chunk_count);
+  vector<Vid> chunk_max_vids(chunk_count, numeric_limits<Vid>::min());
+  vector<Vid> chunk_min_vids(chunk_count, numeric_limits<Vid>::max());
+  auto process_chunk = [&](size_t i) {
+    internal::ProcessEdgeListChunk(chunk_ptrs[i], chunk_ptrs[i + 1],
+                                   &chunk_edges[i], &chunk_max_vids[i],
+                                   &chunk_min_vids[i]);
+  };
+  vector<std::thread> threads;
+  for (size_t i = 1; i < chunk_count; ++i) {
+    threads.emplace_back(process_chunk, i);
+  }
+  process_chunk(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  if (max_vid != nullptr) {
+    *max_vid = *std::max_element(chunk_max_vids.begin(), chunk_max_vids.end());
+  }
+  if (min_vid != nullptr) {
+    *min_vid = *std::min_element(chunk_min_vids.begin(), chunk_min_vids.end());
+  }
+  if (chunk_count == 1) {
+    return std::move(chunk_edges[0]);
+  }
+
+  // Chunk i is copied to edges[offsets[i]] in parallel.
+  vector<size_t> offsets(chunk_count + 1, 0);
+  for (size_t i = 0; i < chunk_count; ++i) {
+    offsets[i + 1] = offsets[i] + chunk_edges[i].size();
+  }
+  vector<EdgeType> edges(offsets[chunk_count]);
+  auto merge_chunk = [&](size_t i) {
+    std::copy(chunk_edges[i].begin(), chunk_edges[i].end(),
+              edges.begin() + offsets[i]);
+    vector<EdgeType>().swap(chunk_edges[i]);
+  };
+  for (size_t i = 1; i < chunk_count; ++i) {
+    threads.emplace_back(merge_chunk, i);
+  }
+  merge_chunk(0);
+  for (auto &thread : threads) {
+    thread.join();
   }
   return edges;
 }
@@ -140,7 +274,8 @@ ProcessEdgeList(const char *begin_ptr, const char *end_ptr,
 template <typename Vid, typename Eid, typename VertexAttr,
           typename EdgeAttr = std::nullptr_t>
 std::vector<Partition<Vid, Eid, VertexAttr, EdgeAttr>>
-LoadEdgeList(const std::string &filename, Vid partition_size) {
+LoadEdgeList(const std::string &filename, Vid partition_size,
+             VertexMapping<Vid> *mapping = nullptr) {
   using std::runtime_error;
   using PartitionType = Partition<Vid, Eid, VertexAttr, EdgeAttr>;
   using EdgeType = Edge<Vid, EdgeAttr>;
@@ -171,6 +306,12 @@ LoadEdgeList(const std::string &filename, Vid partition_size) {
           << " num vertices: " << num_vertices;
 
   const size_t num_partitions = (num_vertices - 1) / partition_size + 1;
+  auto map = [&](Vid vid) -> Vid {
+    // do not use 0 as vid
+    return std::max(Vid(1), min_vid) +
+           (vid - min_vid) % num_partitions * partition_size +
+           (vid - min_vid) / num_partitions;
+  };
   std::vector<std::vector<EdgeType> *> shards(num_partitions);
   for (auto &shard : shards) {
     shard = new std::vector<EdgeType>;
@@ -178,14 +319,15 @@ LoadEdgeList(const std::string &filename, Vid partition_size) {
   for (const auto &edge : edges) {
     VLOG(10) << "src: " << edge.src << " dst: " << edge.dst;
     const size_t pid = (edge.src - min_vid) % num_partitions;
-    auto map = [&](Vid vid) -> Vid {
-      // do not use 0 as vid
-      return std::max(Vid(1), min_vid) +
-             (vid - min_vid) % num_partitions * partition_size +
-             (vid - min_vid) / num_partitions;
-    };
     shards[pid]->push_back({map(edge.src), map(edge.dst)});
   }
+  if (mapping != nullptr) {
+    mapping->base_vid = min_vid;
+    mapping->vids.resize(num_vertices);
+    for (Vid i = 0; i < num_vertices; ++i) {
+      mapping->vids[i] = map(min_vid + i);
+    }
+  }
 
   std::vector<PartitionType> partitions;
   partitions.reserve(num_partitions);
@@ -211,4 +353,230 @@ LoadEdgeList(const std::string &filename, Vid partition_size) {
   return partitions;
 }
 
+// Binary cache of partitioned edge lists, so that a graph is parsed and
+// partitioned once and then mapped into memory in later runs. The file has
+// the native byte order and holds, in order:
+//
+//   CacheHeader
+//   CachePartition[num_partitions]
+//   Vid[mapping_size]                 vertex mapping
+//   padding to a page boundary
+//   EdgeType[num_edges]               shards of each partition, in order
+//
+// Offsets are in bytes from the start of the file.
+
+constexpr char kCacheMagic[8] = {'N', 'X', 'G', 'R', 'A', 'P', 'H', '\0'};
+constexpr uint32_t kCacheVersion = 1;
+constexpr uint64_t kCacheAlignment = 4096;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  // Sizes of the types the file is written with; must match when loaded.
+  uint32_t vid_bytes;
+  uint32_t eid_bytes;
+  uint32_t edge_bytes;
+  uint64_t partition_size;
+  uint64_t num_partitions;
+  uint64_t num_edges;
+  uint64_t mapping_base_vid;
+  uint64_t mapping_size;
+  uint64_t partition_offset;
+  uint64_t mapping_offset;
+  uint64_t edge_offset;
+  uint64_t file_size;
+};
+
+struct CachePartition {
+  uint64_t base_vid;
+  uint64_t num_vertices;
+  uint64_t num_edges;
+  // Index of the first edge of the partition.
+  uint64_t edge_index;
+};
+
+// Returns whether filename starts with the cache magic.
+inline bool IsCache(const std::string &filename) {
+  char magic[sizeof(kCacheMagic)] = {};
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("cannot open file " + filename);
+  }
+  const bool is_cache = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                        memcmp(magic, kCacheMagic, sizeof(magic)) == 0;
+  close(fd);
+  return is_cache;
+}
+
+// Writes partitions and mapping to the cache file filename, replacing it
+// atomically.
+template <typename Vid, typename Eid, typename VertexAttr,
+          typename EdgeAttr = std::nullptr_t>
+void SaveCache(const std::string &filename,
+               const std::vector<Partition<Vid, Eid, VertexAttr, EdgeAttr>>
+                   &partitions,
+               const VertexMapping<Vid> &mapping, Vid partition_size) {
+  using std::runtime_error;
+  using EdgeType = Edge<Vid, EdgeAttr>;
+  auto align = [](uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  };
+
+  CacheHeader header = {};
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.vid_bytes = sizeof(Vid);
+  header.eid_bytes = sizeof(Eid);
+  header.edge_bytes = sizeof(EdgeType);
+  header.partition_size = partition_size;
+  header.num_partitions = partitions.size();
+  header.mapping_base_vid = mapping.base_vid;
+  header.mapping_size = mapping.vids.size();
+  std::vector<CachePartition> cache_partitions;
+  for (const auto &partition : partitions) {
+    cache_partitions.push_back({partition.base_vid, partition.num_vertices,
+                                partition.num_edges, header.num_edges});
+    header.num_edges += partition.num_edges;
+  }
+  header.partition_offset = sizeof(CacheHeader);
+  header.mapping_offset = align(
+      header.partition_offset + sizeof(CachePartition) * partitions.size(),
+      alignof(Vid));
+  header.edge_offset = align(
+      header.mapping_offset + sizeof(Vid) * header.mapping_size,
+      kCacheAlignment);
+  header.file_size = header.edge_offset + sizeof(EdgeType) * header.num_edges;
+
+  // Written to a temporary file first so that a failed write never leaves a
+  // truncated cache behind.
+  const std::string tmp_filename = filename + ".tmp";
+  FILE *file = fopen(tmp_filename.c_str(), "wb");
+  if (file == nullptr) {
+    throw runtime_error("cannot open file " + tmp_filename);
+  }
+  bool ok = true;
+  uint64_t pos = 0;
+  // Writes bytes at ptr to offset, padding with zeros since pos.
+  auto write_at = [&](uint64_t offset, const void *ptr, uint64_t bytes) {
+    static const char kZeros[kCacheAlignment] = {};
+    for (uint64_t padding; ok && pos < offset; pos += padding) {
+      padding = std::min<uint64_t>(offset - pos, sizeof(kZeros));
+      ok = fwrite(kZeros, 1, padding, file) == padding;
+    }
+    ok = ok && (bytes == 0 || fwrite(ptr, 1, bytes, file) == bytes);
+    pos += bytes;
+  };
+  write_at(0, &header, sizeof(header));
+  write_at(header.partition_offset, cache_partitions.data(),
+           sizeof(CachePartition) * cache_partitions.size());
+  write_at(header.mapping_offset, mapping.vids.data(),
+           sizeof(Vid) * mapping.vids.size());
+  uint64_t offset = header.edge_offset;
+  for (const auto &partition : partitions) {
+    write_at(offset, partition.shard.get(),
+             sizeof(EdgeType) * partition.num_edges);
+    offset += sizeof(EdgeType) * partition.num_edges;
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    unlink(tmp_filename.c_str());
+    throw runtime_error("failed to write " + filename);
+  }
+}
+
+// Views a cache file mapped into memory, without copying it.
+template <typename Vid, typename Eid, typename VertexAttr,
+          typename EdgeAttr = std::nullptr_t>
+class CacheView {
+public:
+  using PartitionType = Partition<Vid, Eid, VertexAttr, EdgeAttr>;
+  using EdgeType = Edge<Vid, EdgeAttr>;
+
+  // Checks the cache file of size bytes at data, which must be page-aligned,
+  // and throws std::runtime_error if it is not a valid cache.
+  CacheView(const void *data, uint64_t size)
+      : data_(static_cast<const char *>(data)) {
+    using std::runtime_error;
+    if (size < sizeof(CacheHeader) ||
+        memcmp(header().magic, kCacheMagic, sizeof(kCacheMagic)) != 0) {
+      throw runtime_error("not a graph cache");
+    }
+    if (header().version != kCacheVersion) {
+      throw runtime_error("unsupported graph cache version " +
+                          std::to_string(header().version));
+    }
+    if (header().vid_bytes != sizeof(Vid) ||
+        header().eid_bytes != sizeof(Eid) ||
+        header().edge_bytes != sizeof(EdgeType)) {
+      throw runtime_error("graph cache written with different types");
+    }
+    if (header().file_size != size) {
+      throw runtime_error("graph cache truncated");
+    }
+
+    // Whether count elements of elem_bytes each at offset are within the
+    // file and aligned to alignment, without overflowing.
+    auto is_valid = [size](uint64_t offset, uint64_t count,
+                           uint64_t elem_bytes, uint64_t alignment) {
+      return offset % alignment == 0 && offset <= size &&
+             count <= (size - offset) / elem_bytes;
+    };
+    if (!is_valid(header().partition_offset, header().num_partitions,
+                  sizeof(CachePartition), alignof(CachePartition)) ||
+        !is_valid(header().mapping_offset, header().mapping_size,
+                  sizeof(Vid), alignof(Vid)) ||
+        !is_valid(header().edge_offset, header().num_edges, sizeof(EdgeType),
+                  kCacheAlignment)) {
+      throw runtime_error("graph cache corrupted");
+    }
+    for (uint64_t i = 0; i < header().num_partitions; ++i) {
+      const auto &partition = cache_partitions()[i];
+      if (partition.edge_index > header().num_edges ||
+          partition.num_edges > header().num_edges - partition.edge_index) {
+        throw runtime_error("graph cache corrupted");
+      }
+    }
+  }
+
+  const CacheHeader &header() const {
+    return *reinterpret_cast<const CacheHeader *>(data_);
+  }
+
+  const CachePartition *cache_partitions() const {
+    return reinterpret_cast<const CachePartition *>(data_ +
+                                                    header().partition_offset);
+  }
+
+  // Returns the partitions, whose shards point into the cache.
+  std::vector<PartitionType> partitions() const {
+    std::vector<PartitionType> result;
+    for (uint64_t i = 0; i < header().num_partitions; ++i) {
+      const auto &partition = cache_partitions()[i];
+      result.push_back(
+          {Vid(partition.base_vid),
+           Vid(partition.num_vertices),
+           Eid(partition.num_edges),
+           {const_cast<EdgeType *>(edges() + partition.edge_index),
+            [](EdgeType *) {}}});
+    }
+    return result;
+  }
+
+  // Vertex mapping_base_vid() + i of the edge list is renamed to mapping()[i].
+  Vid mapping_base_vid() const { return header().mapping_base_vid; }
+  const Vid *mapping() const {
+    return reinterpret_cast<const Vid *>(data_ + header().mapping_offset);
+  }
+  uint64_t mapping_size() const { return header().mapping_size; }
+
+  // Shards of all partitions, concatenated.
+  const EdgeType *edges() const {
+    return reinterpret_cast<const EdgeType *>(data_ + header().edge_offset);
+  }
+  uint64_t num_edges() const { return header().num_edges; }
+
+private:
+  const char *data_;
+};
+
 } // namespace nxgraph
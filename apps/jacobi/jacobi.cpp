@@ -31,9 +31,10 @@ void Module0Func(task::ostream<float> &fifo_st_0,
                  task::istream<task::vec_t<float, 2>> &dram_t1_bank_0_fifo) {
 module_0_epoch:
   while (!dram_t1_bank_0_fifo.eot()) {
-    auto dram_t1_bank_0_buf = dram_t1_bank_0_fifo.read(nullptr);
-    fifo_st_0.write(dram_t1_bank_0_buf[1]);
-    fifo_st_1.write(dram_t1_bank_0_buf[0]);
+    auto dram_t1_bank_0_buf =
+        task::shuffle<1, 0>(dram_t1_bank_0_fifo.read(nullptr));
+    fifo_st_0.write(dram_t1_bank_0_buf[0]);
+    fifo_st_1.write(dram_t1_bank_0_buf[1]);
   }
   fifo_st_0.close();
   fifo_st_1.close();
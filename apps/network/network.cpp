@@ -14,39 +14,47 @@ constexpr int kN = 8; // kN x kN network
 
 void Switch2x2(int b, istream<pkt_t> &pkt_in_q0, istream<pkt_t> &pkt_in_q1,
                ostreams<pkt_t, 2> &pkt_out_q) {
+  vec_t<pkt_t, 2> lanes; // output of each input if forwarded straight
+  lanes.set(0, 0);
+  lanes.set(1, 1);
+
   uint8_t priority = 0;
-  [[task::latency(0, 0)]] for (bool valid_0, valid_1;;) {
-    auto pkt_0 = pkt_in_q0.peek(valid_0);
-    auto pkt_1 = pkt_in_q1.peek(valid_1);
-    bool fwd_0_0 = valid_0 && (pkt_0 & (1 << b)) == 0;
-    bool fwd_0_1 = valid_0 && (pkt_0 & (1 << b)) != 0;
-    bool fwd_1_0 = valid_1 && (pkt_1 & (1 << b)) == 0;
-    bool fwd_1_1 = valid_1 && (pkt_1 & (1 << b)) != 0;
+  [[task::latency(0, 0)]] for (vec_t<bool, 2> valid;;) {
+    vec_t<pkt_t, 2> pkt;
+    pkt.set(0, pkt_in_q0.peek(valid[0]));
+    pkt.set(1, pkt_in_q1.peek(valid[1]));
 
-    bool conflict =
-        valid_0 && valid_1 && fwd_0_0 == fwd_1_0 && fwd_0_1 == fwd_1_1;
-    bool prioritize_1 = priority & 1;
+    // lane i of straight (cross) is whether input i goes to output i (1 - i)
+    const auto dst = (pkt >> b) & pkt_t(1);
+    const auto straight = valid & (dst == lanes);
+    const auto cross = valid & (dst != lanes);
+    const auto cross_in = task::shuffle<1, 0>(cross); // to output i
 
-    bool read_0 = !((!fwd_0_0 && !fwd_0_1) || (prioritize_1 && conflict));
-    bool read_1 = !((!fwd_1_0 && !fwd_1_1) || (!prioritize_1 && conflict));
-    bool write_0 = fwd_0_0 || fwd_1_0;
-    bool write_1 = fwd_1_1 || fwd_0_1;
-    bool write_0_0 = fwd_0_0 && (!fwd_1_0 || !prioritize_1);
-    bool write_1_1 = fwd_1_1 && (!fwd_0_1 || prioritize_1);
+    // both inputs go to the same output; round robin priority of both ins
+    const bool conflict = task::all(valid) && dst[0] == dst[1];
+    vec_t<bool, 2> prioritized;
+    prioritized.set(0, (priority & 1) == 0);
+    prioritized.set(1, (priority & 1) != 0);
 
     // if can forward through (0->0 or 1->1), do it
-    // otherwise, check for conflict
-    const bool written_0 =
-        write_0 && pkt_out_q[0].try_write(write_0_0 ? pkt_0 : pkt_1);
-    const bool written_1 =
-        write_1 && pkt_out_q[1].try_write(write_1_1 ? pkt_1 : pkt_0);
+    // otherwise, forward the crossing input
+    const auto fwd_straight = straight & ((cross_in == false) | prioritized);
+    const auto pkt_out =
+        task::select(fwd_straight, pkt, task::shuffle<1, 0>(pkt));
+    const auto write = straight | cross_in; // whether output i has a packet
+    vec_t<bool, 2> written;
+    [[task::unroll]] for (int i = 0; i < 2; ++i) {
+      written.set(i, write[i] && pkt_out_q[i].try_write(pkt_out[i]));
+    }
 
-    // if can forward through (0->0 or 1->1), do it
-    // otherwise, round robin priority of both ins
-    if (read_0 && (write_0_0 ? written_0 : written_1)) {
+    // an input is consumed if its packet is written to its output
+    const auto read = valid & (prioritized | !conflict);
+    const auto consumed = read & task::select(fwd_straight, written,
+                                              task::shuffle<1, 0>(written));
+    if (consumed[0]) {
       pkt_in_q0.read(nullptr);
     }
-    if (read_1 && (write_1_1 ? written_1 : written_0)) {
+    if (consumed[1]) {
       pkt_in_q1.read(nullptr);
     }
 
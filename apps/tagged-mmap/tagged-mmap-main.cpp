@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <cstdlib>
+
+#include <iostream>
+#include <vector>
+
+#include <task.h>
+
+using std::clog;
+using std::endl;
+using std::vector;
+
+void TaggedMmap(task::mmap<uint64_t> src, task::mmap<uint64_t> dst, uint64_t n,
+                task::mmap<uint64_t> errors);
+
+// Usage: tagged-mmap [n]
+//
+// Copies n elements through task::tagged_async_mmap reads, task::reorder, and
+// task::tagged_async_mmap writes, and checks the copy against the source.
+int main(int argc, char *argv[]) {
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 16384;
+
+  vector<uint64_t> src(n);
+  vector<uint64_t> dst(n);
+  vector<uint64_t> errors(1);
+  for (uint64_t i = 0; i < n; ++i) {
+    src[i] = i * 2654435761 + 1;
+  }
+  TaggedMmap(task::mmap<uint64_t>(src), task::mmap<uint64_t>(dst), n,
+             task::mmap<uint64_t>(errors));
+
+  uint64_t num_errors = errors[0];
+  if (num_errors != 0) {
+    clog << num_errors << " write tags not acknowledged exactly once" << endl;
+  }
+  for (uint64_t i = 0; i < n; ++i) {
+    if (dst[i] != src[i]) {
+      if (num_errors < 10) {
+        clog << "element " << i << ": expected: " << src[i]
+             << ", actual: " << dst[i] << endl;
+      }
+      ++num_errors;
+    }
+  }
+  if (num_errors == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+#include <cstdint>
+
+#include <algorithm>
+#include <vector>
+
+#include <task.h>
+
+// Maximum number of responses ahead of the next one in order.
+constexpr uint64_t kWindow = 64;
+
+// Reads src[0, n) tagged with their addresses, kWindow requests at a time.
+// Each window is requested backwards, so that responses come out of order.
+void Read(task::tagged_async_mmap<uint64_t> src, uint64_t n,
+          task::ostream<task::tagged<uint64_t>> &data) {
+  for (uint64_t begin = 0; begin < n; begin += kWindow) {
+    const uint64_t end = std::min(begin + kWindow, n);
+    for (uint64_t i_req = end, i_resp = begin; i_resp < end;) {
+      if (i_req > begin &&
+          src.read_addr.try_write({i_req - 1, int64_t(i_req - 1)})) {
+        --i_req;
+      }
+      task::tagged<uint64_t> resp;
+      if (src.read_data.try_read(resp)) {
+        data.write(resp);
+        ++i_resp;
+      }
+    }
+  }
+  data.close();
+}
+
+// Writes n values to dst in order, tagged with their addresses, and counts the
+// tags that are not acknowledged exactly once.
+void Write(task::istream<uint64_t> &data, task::tagged_async_mmap<uint64_t> dst,
+           uint64_t n, task::mmap<uint64_t> errors) {
+  std::vector<bool> is_acked(n);
+  uint64_t num_errors = 0;
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    if (i_req < n && !data.empty() && !dst.write_addr.full() &&
+        !dst.write_data.full()) {
+      dst.write_addr.write({i_req, int64_t(i_req)});
+      dst.write_data.write(data.read());
+      ++i_req;
+    }
+    uint64_t tag;
+    if (dst.write_resp.try_read(tag)) {
+      if (tag >= n || is_acked[tag]) {
+        ++num_errors;
+      } else {
+        is_acked[tag] = true;
+      }
+      ++i_resp;
+    }
+  }
+  data.open();
+  errors[0] = num_errors;
+}
+
+void TaggedMmap(task::mmap<uint64_t> src, task::mmap<uint64_t> dst, uint64_t n,
+                task::mmap<uint64_t> errors) {
+  task::stream<task::tagged<uint64_t>, 2> data_q("data");
+  task::stream<uint64_t, 2> ordered_q("ordered");
+
+  task::parallel()
+      .invoke(Read, src, n, data_q)
+      .invoke(task::reorder<uint64_t, kWindow>, data_q, ordered_q)
+      .invoke(Write, ordered_q, dst, n, errors);
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <cstdlib>
+
+#include <iostream>
+#include <vector>
+
+#include <task.h>
+
+using std::clog;
+using std::endl;
+using std::vector;
+
+void WriteCombiner(task::mmap<uint64_t> mem, task::mmap<const uint64_t> view,
+                   uint64_t n, uint64_t region_count, uint64_t round_count,
+                   bool is_async, task::mmap<uint64_t> errors);
+
+// Usage: write-combiner [n] [region count] [round count]
+//
+// Scatters n elements through a task::write_combiner to both a task::mmap and
+// a task::async_mmap, and checks that the data are visible right after each
+// flush() and in the end.
+int main(int argc, char *argv[]) {
+  const uint64_t n = argc > 1 ? atoll(argv[1]) : 65536;
+  const uint64_t region_count = argc > 2 ? atoll(argv[2]) : 64;
+  const uint64_t round_count = argc > 3 ? atoll(argv[3]) : 16;
+  const uint64_t region_length = (n - 1) / region_count + 1;
+
+  uint64_t num_errors = 0;
+  for (bool is_async : {false, true}) {
+    vector<uint64_t> mem(region_length * region_count);
+    vector<uint64_t> errors(1);
+    WriteCombiner(task::mmap<uint64_t>(mem), task::mmap<const uint64_t>(mem), n,
+                  region_count, round_count, is_async,
+                  task::mmap<uint64_t>(errors));
+    const char *name = is_async ? "async_mmap" : "mmap";
+    if (errors[0] != 0) {
+      clog << name << ": " << errors[0] << " elements not written after flush"
+           << endl;
+    }
+    num_errors += errors[0];
+    for (uint64_t i = 0; i < n; ++i) {
+      const uint64_t actual = mem[i % region_count * region_length +
+                                  i / region_count];
+      if (actual != i + 1) {
+        if (num_errors < 10) {
+          clog << name << ": element " << i << ": expected: " << i + 1
+               << ", actual: " << actual << endl;
+        }
+        ++num_errors;
+      }
+    }
+  }
+  if (num_errors == 0) {
+    clog << "PASS!" << endl;
+  } else {
+    clog << "FAIL!" << endl;
+  }
+  return num_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#include <cstdint>
+
+#include <task.h>
+
+namespace {
+
+// Writes element i, with value i + 1, to address
+// i % region_count * region_length + i / region_count of mem through a
+// task::write_combiner, i.e., as region_count interleaved sequential streams.
+// After each of round_count rounds, counts the elements that are not visible
+// in view right after flush() returns.
+template <typename Mem>
+void Scatter(Mem &mem, task::mmap<const uint64_t> view, uint64_t n,
+             uint64_t region_count, uint64_t round_count,
+             task::mmap<uint64_t> errors) {
+  task::write_combiner<uint64_t, 64> combiner(mem, region_count);
+  const uint64_t region_length = (n - 1) / region_count + 1;
+  uint64_t num_errors = 0;
+  for (uint64_t round = 0; round < round_count; ++round) {
+    const uint64_t begin = n * round / round_count;
+    const uint64_t end = n * (round + 1) / round_count;
+    for (uint64_t i = begin; i < end; ++i) {
+      const uint64_t region = i % region_count;
+      combiner.write(region, region * region_length + i / region_count, i + 1);
+    }
+    combiner.flush();
+    for (uint64_t i = begin; i < end; ++i) {
+      if (view[i % region_count * region_length + i / region_count] != i + 1) {
+        ++num_errors;
+      }
+    }
+  }
+  errors[0] = num_errors;
+}
+
+void ScatterToMmap(task::mmap<uint64_t> mem, task::mmap<const uint64_t> view,
+                   uint64_t n, uint64_t region_count, uint64_t round_count,
+                   task::mmap<uint64_t> errors) {
+  Scatter(mem, view, n, region_count, round_count, errors);
+}
+
+void ScatterToAsyncMmap(task::async_mmap<uint64_t> mem,
+                        task::mmap<const uint64_t> view, uint64_t n,
+                        uint64_t region_count, uint64_t round_count,
+                        task::mmap<uint64_t> errors) {
+  Scatter(mem, view, n, region_count, round_count, errors);
+}
+
+} // namespace
+
+void WriteCombiner(task::mmap<uint64_t> mem, task::mmap<const uint64_t> view,
+                   uint64_t n, uint64_t region_count, uint64_t round_count,
+                   bool is_async, task::mmap<uint64_t> errors) {
+  if (is_async) {
+    task::parallel().invoke(ScatterToAsyncMmap, mem, view, n, region_count,
+                            round_count, errors);
+  } else {
+    task::parallel().invoke(ScatterToMmap, mem, view, n, region_count,
+                            round_count, errors);
+  }
+}
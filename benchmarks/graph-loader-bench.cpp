@@ -0,0 +1,149 @@
+// Measures how fast nxgraph loads edge lists in the SNAP text format.
+//
+// Usage: graph-loader-bench [max_edge_count] [repetitions]
+//
+// Edge lists of increasing sizes are generated, parsed from memory with one
+// thread and with all hardware threads, and loaded and partitioned from a
+// file. Parsed edges are checked against the generated ones.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "nxgraph.hpp"
+
+using std::string;
+using std::vector;
+
+using Vid = uint32_t;
+using Eid = uint32_t;
+
+namespace {
+
+int repetition_count = 5;
+int error_count = 0;
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns the next state of a xorshift64 generator.
+uint64_t NextRandom(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Returns the median seconds of running run() repetition_count times.
+template <typename Run> double Measure(Run run) {
+  vector<double> times;
+  for (int i = 0; i < repetition_count; ++i) {
+    const double begin = Now();
+    run();
+    times.push_back(Now() - begin);
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+void Report(const char *name, uint64_t edge_count, uint64_t bytes,
+            double seconds) {
+  printf("%-18s %10lu edges %10.3f ms %9.1f MB/s %8.2f Medges/s\n", name,
+         static_cast<unsigned long>(edge_count), seconds * 1e3,
+         bytes / seconds / 1e6, edge_count / seconds / 1e6);
+}
+
+void Check(const char *name, const vector<nxgraph::Edge<Vid>> &actual,
+           const vector<nxgraph::Edge<Vid>> &expected) {
+  bool is_equal = actual.size() == expected.size();
+  for (size_t i = 0; is_equal && i < actual.size(); ++i) {
+    is_equal = actual[i].src == expected[i].src &&
+               actual[i].dst == expected[i].dst;
+  }
+  if (!is_equal) {
+    fprintf(stderr, "%s: parsed edges mismatch\n", name);
+    ++error_count;
+  }
+}
+
+void Bench(uint64_t edge_count) {
+  // Like SNAP files, with a header and tab-separated vertex ids of varying
+  // lengths.
+  vector<nxgraph::Edge<Vid>> expected(edge_count);
+  string text = "# Directed graph: generated\n# FromNodeId\tToNodeId\n";
+  uint64_t state = 0x9e3779b97f4a7c15;
+  for (auto &edge : expected) {
+    edge.src = NextRandom(state) % (edge_count * 4) + 1;
+    edge.dst = NextRandom(state) % (edge_count * 4) + 1;
+    text += std::to_string(edge.src) + '\t' + std::to_string(edge.dst) + '\n';
+  }
+  const char *begin_ptr = text.data();
+  const char *end_ptr = begin_ptr + text.size();
+
+  vector<nxgraph::Edge<Vid>> edges;
+  Vid max_vid;
+  Vid min_vid;
+  Report("parse (1 thread)", edge_count, text.size(), Measure([&] {
+           edges = nxgraph::ProcessEdgeList<Vid>(begin_ptr, end_ptr, &max_vid,
+                                                 &min_vid, 1);
+         }));
+  Check("parse (1 thread)", edges, expected);
+  Report("parse", edge_count, text.size(), Measure([&] {
+           edges = nxgraph::ProcessEdgeList<Vid>(begin_ptr, end_ptr, &max_vid,
+                                                 &min_vid);
+         }));
+  Check("parse", edges, expected);
+  Vid expected_max_vid = 0;
+  Vid expected_min_vid = ~Vid(0);
+  for (const auto &edge : expected) {
+    expected_max_vid = std::max({expected_max_vid, edge.src, edge.dst});
+    expected_min_vid = std::min({expected_min_vid, edge.src, edge.dst});
+  }
+  if (max_vid != expected_max_vid || min_vid != expected_min_vid) {
+    fprintf(stderr, "parse: vertex id range mismatch\n");
+    ++error_count;
+  }
+
+  char filename[] = "/tmp/graph-loader-bench-XXXXXX";
+  const int fd = mkstemp(filename);
+  if (fd == -1 || write(fd, text.data(), text.size()) != ssize_t(text.size()) ||
+      close(fd) != 0) {
+    fprintf(stderr, "cannot write %s\n", filename);
+    ++error_count;
+    return;
+  }
+  Report("load and partition", edge_count, text.size(), Measure([&] {
+           nxgraph::LoadEdgeList<Vid, Eid, Vid>(filename, 1024);
+         }));
+  unlink(filename);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const uint64_t max_edge_count = argc > 1 ? atoll(argv[1]) : 1 << 22;
+  if (argc > 2) {
+    repetition_count = std::max(1, atoi(argv[2]));
+  }
+
+  for (uint64_t edge_count = 1 << 10; edge_count <= max_edge_count;
+       edge_count *= 16) {
+    Bench(edge_count);
+  }
+
+  if (error_count > 0) {
+    fprintf(stderr, "%d errors\n", error_count);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,353 @@
+// Measures the costs of the libtask runtime: streams, scheduling, and
+// async_mmap.
+//
+// Usage: runtime-bench [repetitions] [filter]
+//
+// Each benchmark is repeated (default: 5 times) and reported in JSON on stdout
+// with the median, minimum, and maximum time per operation, so that results
+// can be compared across commits. Only benchmarks whose names contain filter
+// are run. Compare with runtime-bench-locked, which is built with
+// TASK_USE_LOCKED_QUEUE, to see the speedup of the lock-free queue. The number
+// of workers is set by environment variable TASK_CONCURRENCY as usual; with a
+// single worker, tasks communicating via streams switch coroutines on the same
+// thread.
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <task.h>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Outstanding requests of each async_mmap benchmark.
+constexpr uint64_t kOutstanding = 64;
+
+int repetition_count = 5;
+const char *filter = "";
+
+// Prevents the compiler from optimizing away computation of val.
+template <typename T> void Escape(const T &val) {
+  asm volatile("" : : "g"(&val) : "memory");
+}
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns the next state of a xorshift64 generator.
+uint64_t NextRandom(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+// Number of workers, determined like the runtime does.
+int GetWorkerCount() {
+  if (auto concurrency = getenv("TASK_CONCURRENCY")) {
+    return atoi(concurrency);
+  }
+  return std::thread::hardware_concurrency();
+}
+
+struct Result {
+  string name;
+  string params;        // JSON members, e.g., "\"depth\": 2"
+  uint64_t op_count;    // operations per repetition
+  uint64_t op_bytes;    // bytes moved per operation, or 0
+  vector<double> times; // seconds of each repetition
+};
+
+vector<Result> results;
+
+// Runs `run`, which returns the seconds taken by op_count operations, for each
+// repetition if the benchmark is selected.
+template <typename Run>
+void Measure(const string &name, const string &params, uint64_t op_count,
+             uint64_t op_bytes, Run run) {
+  if (name.find(filter) == string::npos) {
+    return;
+  }
+  Result result{name, params, op_count, op_bytes, {}};
+  for (int i = 0; i < repetition_count; ++i) {
+    result.times.push_back(run());
+  }
+  results.push_back(result);
+  fprintf(stderr, "%-16s %-32s done\n", name.c_str(), params.c_str());
+}
+
+void PrintJson() {
+  printf("{\n  \"benchmark\": \"runtime-bench\",\n");
+#ifdef TASK_USE_LOCKED_QUEUE
+  printf("  \"queue\": \"locked\",\n");
+#else  // TASK_USE_LOCKED_QUEUE
+  printf("  \"queue\": \"lock-free\",\n");
+#endif // TASK_USE_LOCKED_QUEUE
+  printf("  \"workers\": %d,\n  \"repetitions\": %d,\n  \"results\": [",
+         GetWorkerCount(), repetition_count);
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto &result = results[i];
+    std::sort(result.times.begin(), result.times.end());
+    const double median = result.times[result.times.size() / 2];
+    const double scale = 1e9 / double(result.op_count);
+    printf("%s\n    {\"name\": \"%s\", %s%s\"ops\": %" PRIu64
+           ", \"ns_per_op\": {\"median\": %.3f, \"min\": %.3f, \"max\": %.3f}",
+           i == 0 ? "" : ",", result.name.c_str(), result.params.c_str(),
+           result.params.empty() ? "" : ", ", result.op_count, median * scale,
+           result.times.front() * scale, result.times.back() * scale);
+    if (result.op_bytes > 0) {
+      printf(", \"gbps\": %.3f",
+             double(result.op_bytes) * result.op_count / median / 1e9);
+    }
+    printf("}");
+  }
+  printf("\n  ]\n}\n");
+}
+
+// Streams: the consumer measures from its first to its last token, so that
+// launching the tasks is excluded.
+
+template <typename T> void Produce(task::ostream<T> &out, uint64_t n) {
+  T val;
+  for (uint64_t i = 0; i < n; ++i) {
+    val = i;
+    out.write(val);
+  }
+}
+
+template <typename T>
+void Consume(task::istream<T> &in, uint64_t n, double *seconds) {
+  Escape(in.read());
+  const double begin = Now();
+  for (uint64_t i = 1; i < n; ++i) {
+    Escape(in.read());
+  }
+  *seconds = Now() - begin;
+}
+
+template <int Bytes, uint64_t Depth> void BenchStream() {
+  using T = task::vec_t<uint64_t, Bytes / 8>;
+  const uint64_t n = (8 << 20) / Bytes;
+  Measure("stream",
+          "\"elem_bytes\": " + std::to_string(Bytes) +
+              ", \"depth\": " + std::to_string(Depth),
+          n - 1, Bytes, [n] {
+            task::stream<T, Depth> q("q");
+            double seconds = 0;
+            task::parallel()
+                .invoke(Produce<T>, q, n)
+                .invoke(Consume<T>, q, n, &seconds);
+            return seconds;
+          });
+}
+
+template <int Bytes> void BenchStreams() {
+  BenchStream<Bytes, 2>();
+  BenchStream<Bytes, 32>();
+  BenchStream<Bytes, 1024>();
+}
+
+void Relay(task::istream<uint64_t> &in, task::ostream<uint64_t> &out,
+           uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i) {
+    out.write(in.read());
+  }
+}
+
+template <int StageCount> void BenchPipeline() {
+  const uint64_t n = 1 << 18;
+  Measure("pipeline", "\"stages\": " + std::to_string(StageCount), n - 1,
+          sizeof(uint64_t), [n] {
+            task::streams<uint64_t, StageCount + 1, 32> q("q");
+            double seconds = 0;
+            task::parallel()
+                .invoke(Produce<uint64_t>, q, n)
+                .template invoke<StageCount>(Relay, q, q, n)
+                .invoke(Consume<uint64_t>, q, n, &seconds);
+            return seconds;
+          });
+}
+
+// Ping-pong: a token makes round trips between Ping and Relay, which are
+// scheduled on different workers if there are at least 2, unless there are
+// `idle_count` tasks in between; see BenchSwitch.
+
+void Ping(task::ostream<uint64_t> &out, task::istream<uint64_t> &in,
+          uint64_t n, double *seconds) {
+  const double begin = Now();
+  for (uint64_t i = 0; i < n; ++i) {
+    out.write(i);
+    Escape(in.read());
+  }
+  *seconds = Now() - begin;
+}
+
+void Idle() {}
+
+double PingPong(uint64_t n, int idle_count) {
+  task::stream<uint64_t, 2> ping("ping");
+  task::stream<uint64_t, 2> pong("pong");
+  double seconds = 0;
+  {
+    task::parallel region;
+    region.invoke(Ping, ping, pong, n, &seconds);
+    for (int i = 0; i < idle_count; ++i) {
+      region.invoke(Idle);
+    }
+    region.invoke(Relay, ping, pong, n);
+  }
+  return seconds;
+}
+
+void BenchPingPong() {
+  const uint64_t n = 1 << 16;
+  Measure("ping_pong", "", n, 0, [n] { return PingPong(n, 0); });
+}
+
+// Tasks of a top-level task::parallel are assigned to workers round-robin, so
+// Ping and Relay share a worker if there are W - 1 tasks in between, and each
+// round trip takes 2 coroutine switches.
+void BenchSwitch() {
+  const uint64_t n = 1 << 16;
+  Measure("coroutine_switch", "", n * 2, 0,
+          [n] { return PingPong(n, GetWorkerCount() - 1); });
+}
+
+// Fan-out: a task invokes FanOut children at a time; "invoke" measures the
+// caller, and "invoke_complete" the whole top-level task::parallel until all
+// children finish.
+
+template <int FanOut> void Launch(uint64_t round_count, double *seconds) {
+  const double begin = Now();
+  for (uint64_t i = 0; i < round_count; ++i) {
+    task::parallel().invoke<FanOut>(Idle);
+  }
+  *seconds = Now() - begin;
+}
+
+template <int FanOut> void BenchInvoke() {
+  const uint64_t task_count = 1 << 14;
+  const uint64_t round_count = task_count / FanOut;
+  const string params = "\"fan_out\": " + std::to_string(FanOut);
+  Measure("invoke", params, task_count, 0, [round_count] {
+    double seconds = 0;
+    task::parallel().invoke(Launch<FanOut>, round_count, &seconds);
+    return seconds;
+  });
+  Measure("invoke_complete", params, task_count, 0, [round_count] {
+    double seconds = 0;
+    const double begin = Now();
+    task::parallel().invoke(Launch<FanOut>, round_count, &seconds);
+    return Now() - begin;
+  });
+}
+
+// async_mmap: up to kOutstanding requests are in flight.
+
+void Read(task::async_mmap<uint64_t> mem, uint64_t n, bool is_random,
+          double *seconds) {
+  uint64_t state = 0x9e3779b97f4a7c15;
+  uint64_t addr = is_random ? NextRandom(state) % n : 0;
+  uint64_t sum = 0;
+  const double begin = Now();
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    if (i_req < n && i_req < i_resp + kOutstanding &&
+        mem.read_addr.try_write(addr)) {
+      ++i_req;
+      addr = is_random ? NextRandom(state) % n : i_req;
+    }
+    uint64_t val;
+    if (mem.read_data.try_read(val)) {
+      sum += val;
+      ++i_resp;
+    }
+  }
+  *seconds = Now() - begin;
+  Escape(sum);
+}
+
+void Write(task::async_mmap<uint64_t> mem, uint64_t n, bool is_random,
+           double *seconds) {
+  uint64_t state = 0x9e3779b97f4a7c15;
+  uint64_t addr = is_random ? NextRandom(state) % n : 0;
+  bool is_addr_sent = false;
+  const double begin = Now();
+  for (uint64_t i_req = 0, i_resp = 0; i_resp < n;) {
+    if (i_req < n && i_req < i_resp + kOutstanding) {
+      if (!is_addr_sent) {
+        is_addr_sent = mem.write_addr.try_write(addr);
+      }
+      if (is_addr_sent && mem.write_data.try_write(i_req)) {
+        is_addr_sent = false;
+        ++i_req;
+        addr = is_random ? NextRandom(state) % n : i_req;
+      }
+    }
+    if (!mem.write_resp.empty()) {
+      i_resp += mem.write_resp.read(nullptr) + 1;
+    }
+  }
+  *seconds = Now() - begin;
+}
+
+void BenchAsyncMmap() {
+  const uint64_t n = 1 << 20;
+  vector<uint64_t> data(n, 1);
+  for (bool is_random : {false, true}) {
+    const string params =
+        string("\"pattern\": \"") + (is_random ? "random" : "sequential") +
+        "\"";
+    Measure("async_mmap_read", params, n, sizeof(uint64_t), [&] {
+      task::mmap<uint64_t> mem(data);
+      double seconds = 0;
+      task::parallel().invoke(Read, mem, n, is_random, &seconds);
+      return seconds;
+    });
+    Measure("async_mmap_write", params, n, sizeof(uint64_t), [&] {
+      task::mmap<uint64_t> mem(data);
+      double seconds = 0;
+      task::parallel().invoke(Write, mem, n, is_random, &seconds);
+      return seconds;
+    });
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    repetition_count = std::max(1, atoi(argv[1]));
+  }
+  if (argc > 2) {
+    filter = argv[2];
+  }
+
+  BenchStreams<8>();
+  BenchStreams<64>();
+  BenchStreams<512>();
+  BenchPingPong();
+  BenchPipeline<1>();
+  BenchPipeline<4>();
+  BenchPipeline<16>();
+  BenchInvoke<1>();
+  BenchInvoke<16>();
+  BenchInvoke<256>();
+  BenchSwitch();
+  BenchAsyncMmap();
+
+  PrintJson();
+  return 0;
+}
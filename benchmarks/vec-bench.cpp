@@ -0,0 +1,362 @@
+// Measures the throughput of each task::vec_t operator, conversion, and math
+// function.
+//
+// Usage: vec-bench [iterations]
+//
+// Compare with vec-bench-scalar, which is built with TASK_USE_SCALAR_VEC, to
+// see the speedup of the SIMD operators; build with -march=native to target
+// the widest ISA of the host. Results are checked against scalar arithmetic.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include <task.h>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Vectors per array; small enough to stay in L1 so that arithmetic dominates.
+constexpr int kVecCount = 256;
+
+int iteration_count = 2000;
+int error_count = 0;
+
+// Prevents the compiler from optimizing away or hoisting computation on ptr.
+template <typename T> void Escape(T *ptr) {
+  asm volatile("" : : "g"(ptr) : "memory");
+}
+
+template <typename T> const char *GetTypeName() {
+  return std::is_same<T, float>::value                 ? "float"
+         : std::is_same<T, double>::value              ? "double"
+         : std::is_same<T, int32_t>::value             ? "int32"
+         : std::is_same<T, uint8_t>::value             ? "uint8"
+         : std::is_same<T, int64_t>::value             ? "int64"
+         : std::is_same<T, task::uint_t<3>>::value     ? "uint_t<3>"
+         : std::is_same<T, task::uint_t<12>>::value    ? "uint_t<12>"
+         : std::is_same<T, task::half>::value          ? "half"
+         : std::is_same<T, task::bfloat16>::value      ? "bfloat16"
+         : std::is_same<T, task::fixed<16, 12>>::value ? "fixed<16, 12>"
+                                                       : typeid(T).name();
+}
+
+// Whether actual matches expected; floating-point results may differ in the
+// order of operations.
+template <typename T> bool IsClose(T actual, T expected) {
+  return std::is_integral<T>::value
+             ? actual == expected
+             : std::abs(double(actual) - double(expected)) <=
+                   1e-5 * std::abs(double(expected));
+}
+
+// Reports the time of computing `kVecCount` results with op(lhs, rhs) and
+// checks each result with is_correct(result, lhs, rhs).
+template <typename T, int N, typename Op, typename Check>
+void Run(const string &name, Op op, Check is_correct) {
+  using Vec = task::vec_t<T, N>;
+  vector<Vec> lhs(kVecCount), rhs(kVecCount);
+  vector<decltype(op(Vec(), Vec()))> out(kVecCount);
+  for (int i = 0; i < kVecCount; ++i) {
+    for (int j = 0; j < N; ++j) {
+      // nonzero, so that division is defined
+      lhs[i].set(j, T(i * N + j) / T(3) + T(1));
+      rhs[i].set(j, T((i + j) % 7 + 1));
+    }
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  for (int iter = 0; iter < iteration_count; ++iter) {
+    Escape(lhs.data());
+    for (int i = 0; i < kVecCount; ++i) {
+      out[i] = op(lhs[i], rhs[i]);
+    }
+    Escape(out.data());
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+
+  const string type =
+      string("vec_t<") + GetTypeName<T>() + ", " + std::to_string(N) + ">";
+  for (int i = 0; i < kVecCount; ++i) {
+    if (!is_correct(out[i], lhs[i], rhs[i]) && error_count++ < 10) {
+      fprintf(stderr, "%s %s mismatches at [%d]\n", name.c_str(),
+              type.c_str(), i);
+    }
+  }
+
+  const double ns = seconds * 1e9 / (double(iteration_count) * kVecCount);
+  printf("%-16s %-20s %8.2f ns/vec %8.3f ns/lane\n", name.c_str(),
+         type.c_str(), ns, ns / N);
+}
+
+// Returns a check of each lane of an element-wise result against scalar_op.
+template <typename T, int N, typename ScalarOp>
+auto LaneWise(ScalarOp scalar_op) {
+  using Vec = task::vec_t<T, N>;
+  return [scalar_op](const Vec &out, const Vec &a, const Vec &b) {
+    for (int j = 0; j < N; ++j) {
+      if (out[j] != scalar_op(a[j], b[j])) {
+        return false;
+      }
+    }
+    return true;
+  };
+}
+
+// Same as LaneWise, but within the tolerance of IsClose.
+template <typename T, int N, typename ScalarOp>
+auto LaneWiseClose(ScalarOp scalar_op) {
+  using Vec = task::vec_t<T, N>;
+  return [scalar_op](const Vec &out, const Vec &a, const Vec &b) {
+    for (int j = 0; j < N; ++j) {
+      if (!IsClose(out[j], T(scalar_op(a[j], b[j])))) {
+        return false;
+      }
+    }
+    return true;
+  };
+}
+
+// Benchmarks vector-vector, vector-scalar, and compound assignment forms.
+#define DEFINE_BENCH(name, op)                                                 \
+  template <typename T, int N> void name() {                                   \
+    using Vec = task::vec_t<T, N>;                                             \
+    Run<T, N>(                                                                 \
+        #op, [](Vec a, const Vec &b) { return a op b; },                       \
+        LaneWise<T, N>([](T a, T b) { return T(a op b); }));                   \
+    Run<T, N>(                                                                 \
+        #op " scalar", [](Vec a, const Vec &) { return a op T(3); },           \
+        LaneWise<T, N>([](T a, T) { return T(a op T(3)); }));                  \
+    Run<T, N>(                                                                 \
+        #op "=", [](Vec a, const Vec &b) { return a op## = b; },               \
+        LaneWise<T, N>([](T a, T b) { return T(a op b); }));                   \
+  }
+DEFINE_BENCH(BenchAdd, +)
+DEFINE_BENCH(BenchSub, -)
+DEFINE_BENCH(BenchMul, *)
+DEFINE_BENCH(BenchDiv, /)
+DEFINE_BENCH(BenchAnd, &)
+DEFINE_BENCH(BenchOr, |)
+DEFINE_BENCH(BenchXor, ^)
+#undef DEFINE_BENCH
+
+template <typename T, int N> void BenchArithmetic() {
+  BenchAdd<T, N>();
+  BenchSub<T, N>();
+  BenchMul<T, N>();
+  BenchDiv<T, N>();
+}
+
+template <typename T, int N> void BenchBitwise() {
+  BenchAnd<T, N>();
+  BenchOr<T, N>();
+  BenchXor<T, N>();
+}
+
+template <typename T, int N> void BenchMasks() {
+  using Vec = task::vec_t<T, N>;
+  using Mask = task::vec_t<bool, N>;
+  Run<T, N>(
+      "<", [](const Vec &a, const Vec &b) { return a < b; },
+      [](const Mask &out, const Vec &a, const Vec &b) {
+        for (int j = 0; j < N; ++j) {
+          if (out[j] != (a[j] < b[j])) {
+            return false;
+          }
+        }
+        return true;
+      });
+  Run<T, N>(
+      "select", [](const Vec &a, const Vec &b) {
+        return task::select(a < b, a, b);
+      },
+      LaneWise<T, N>([](T a, T b) { return std::min(a, b); }));
+  Run<T, N>(
+      "permute", [](const Vec &a, const Vec &b) {
+        return task::permute(a, task::vec_t<int, N>(b));
+      },
+      [](const Vec &out, const Vec &a, const Vec &b) {
+        for (int j = 0; j < N; ++j) {
+          if (out[j] != a[int(b[j])]) {
+            return false;
+          }
+        }
+        return true;
+      });
+}
+
+template <typename T, int N> void BenchReductions() {
+  using Vec = task::vec_t<T, N>;
+  Run<T, N>(
+      "sum", [](const Vec &a, const Vec &) { return task::sum(a); },
+      [](T out, const Vec &a, const Vec &) {
+        T expected = 0;
+        for (int j = 0; j < N; ++j) {
+          expected += a[j];
+        }
+        return IsClose(out, expected);
+      });
+  Run<T, N>(
+      "max", [](const Vec &a, const Vec &) { return task::max(a); },
+      [](T out, const Vec &a, const Vec &) {
+        return out == *std::max_element(&a[0], &a[0] + N);
+      });
+  Run<T, N>(
+      "argmin", [](const Vec &, const Vec &b) { return task::argmin(b); },
+      [](int out, const Vec &, const Vec &b) {
+        return out == std::min_element(&b[0], &b[0] + N) - &b[0];
+      });
+  Run<T, N>(
+      "dot", [](const Vec &a, const Vec &b) { return task::dot(a, b); },
+      [](T out, const Vec &a, const Vec &b) {
+        T expected = 0;
+        for (int j = 0; j < N; ++j) {
+          expected += a[j] * b[j];
+        }
+        return IsClose(out, expected);
+      });
+  Run<T, N>(
+      "fma", [](const Vec &a, const Vec &b) { return task::fma(a, b, a); },
+      [](const Vec &out, const Vec &a, const Vec &b) {
+        for (int j = 0; j < N; ++j) {
+          if (!IsClose(out[j], T(a[j] * b[j] + a[j]))) {
+            return false;
+          }
+        }
+        return true;
+      });
+}
+
+// Packed lanes are computed on whole words for +, -, bitwise operators, and
+// equality, and lane by lane otherwise.
+template <int W, int N> void BenchPacked() {
+  using T = task::uint_t<W>;
+  using Vec = task::vec_t<T, N>;
+  BenchAdd<T, N>();
+  BenchSub<T, N>();
+  BenchMul<T, N>();
+  BenchXor<T, N>();
+  Run<T, N>(
+      "==", [](const Vec &a, const Vec &b) { return a == b; },
+      [](const task::vec_t<bool, N> &out, const Vec &a, const Vec &b) {
+        for (int j = 0; j < N; ++j) {
+          if (out[j] != (a[j] == b[j])) {
+            return false;
+          }
+        }
+        return true;
+      });
+}
+
+// Conversions of float lanes to and from 16-bit types, which are vectorized
+// with F16C or AVX-512 instructions for task::half if available.
+template <typename T, int N> void BenchConversions() {
+  using Vec = task::vec_t<float, N>;
+  using Narrow = task::vec_t<T, N>;
+  const string name = GetTypeName<T>();
+  Run<float, N>(
+      "to " + name,
+      [](const Vec &a, const Vec &) { return static_cast<Narrow>(a); },
+      [](const Narrow &out, const Vec &a, const Vec &) {
+        for (int j = 0; j < N; ++j) {
+          if (float(out[j]) != float(T(a[j]))) {
+            return false;
+          }
+        }
+        return true;
+      });
+  Run<float, N>(
+      "to " + name + " and back",
+      [](const Vec &a, const Vec &) {
+        return static_cast<Vec>(static_cast<Narrow>(a));
+      },
+      LaneWise<float, N>([](float a, float) { return float(T(a)); }));
+}
+
+// The scalar build calls libm for each lane.
+template <typename T, int N> void BenchMath() {
+  using Vec = task::vec_t<T, N>;
+  // b is in [1, 7] and a is in [1, 1400]
+  Run<T, N>(
+      "exp", [](const Vec &, const Vec &b) { return task::exp(b); },
+      LaneWiseClose<T, N>([](T, T b) { return std::exp(b); }));
+  Run<T, N>(
+      "fast::exp", [](const Vec &, const Vec &b) { return task::fast::exp(b); },
+      LaneWiseClose<T, N>([](T, T b) { return std::exp(b); }));
+  Run<T, N>(
+      "log", [](const Vec &a, const Vec &) { return task::log(a); },
+      LaneWiseClose<T, N>([](T a, T) { return std::log(a); }));
+  Run<T, N>(
+      "sqrt", [](const Vec &a, const Vec &) { return task::sqrt(a); },
+      LaneWiseClose<T, N>([](T a, T) { return std::sqrt(a); }));
+  Run<T, N>(
+      "fast::rsqrt",
+      [](const Vec &a, const Vec &) { return task::fast::rsqrt(a); },
+      LaneWiseClose<T, N>([](T a, T) { return 1 / std::sqrt(a); }));
+  Run<T, N>(
+      "sin", [](const Vec &a, const Vec &) { return task::sin(a); },
+      LaneWiseClose<T, N>([](T a, T) { return std::sin(a); }));
+  Run<T, N>(
+      "cos", [](const Vec &a, const Vec &) { return task::cos(a); },
+      LaneWiseClose<T, N>([](T a, T) { return std::cos(a); }));
+  Run<T, N>(
+      "tanh", [](const Vec &, const Vec &b) { return task::tanh(b - T(4)); },
+      LaneWiseClose<T, N>([](T, T b) { return std::tanh(b - T(4)); }));
+  Run<T, N>(
+      "pow", [](const Vec &a, const Vec &b) { return task::pow(a, b); },
+      LaneWiseClose<T, N>([](T a, T b) { return std::pow(a, b); }));
+  Run<T, N>(
+      "fast::pow",
+      [](const Vec &a, const Vec &b) { return task::fast::pow(a, b); },
+      LaneWiseClose<T, N>([](T a, T b) { return std::pow(a, b); }));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    iteration_count = atoi(argv[1]);
+  }
+  printf("isa: %s\n", task::internal::get_simd_isa());
+
+  BenchArithmetic<float, 16>();
+  BenchArithmetic<float, 2>();
+  BenchArithmetic<double, 8>();
+  BenchArithmetic<int32_t, 16>();
+  BenchBitwise<int32_t, 16>();
+  BenchArithmetic<uint8_t, 64>();
+  BenchBitwise<uint8_t, 64>();
+  BenchArithmetic<int64_t, 8>();
+  BenchMasks<float, 16>();
+  BenchMasks<int32_t, 16>();
+  BenchReductions<float, 16>();
+  BenchReductions<float, 100>();
+  BenchReductions<double, 8>();
+  BenchReductions<int32_t, 16>();
+  BenchReductions<int32_t, 100>();
+  BenchPacked<3, 64>();
+  BenchPacked<12, 20>();
+  BenchConversions<task::half, 16>();
+  BenchConversions<task::bfloat16, 16>();
+  BenchConversions<task::fixed<16, 12>, 16>();
+  BenchMath<float, 16>();
+  BenchMath<double, 8>();
+
+  if (error_count > 0) {
+    fprintf(stderr, "%d errors\n", error_count);
+    return 1;
+  }
+  return 0;
+}
@@ -1,23 +1,48 @@
 #include "task.h"
+#include "task/metrics.h"
+#include "task/trace.h"
 
+#include <cerrno>
+#include <cinttypes>
 #include <csignal>
+#include <cstdio>
 #include <cstring>
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <fstream>
+#include <iomanip>
 #include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <ostream>
 #include <queue>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <linux/io_uring.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <semaphore.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/coroutine2/coroutine.hpp>
@@ -47,18 +72,1029 @@ namespace task {
 
 namespace internal {
 
+// Maximum number of performance counters attributed to each task.
+constexpr int kPerfEventCount = 4;
+
+// Shared by the task::parallel that creates the region and the task instances
+// invoked in it, so that it lives as long as any of them.
+struct region_info {
+  region_info(int id, const task_info *parent) : id(id), parent(parent) {}
+
+  const int id;
+  const task_info *const parent; // nullptr if top-level or not recorded
+  std::vector<const task_info *> tasks; // only if recorded
+
+  // number of task instances created per function or label
+  mutex mtx;
+  std::map<std::pair<const void *, string>, int> instance_counts;
+};
+
+class task_info {
+public:
+  task_info(int id, std::shared_ptr<region_info> region, const void *func,
+            string label, int index, mode m, int64_t create_time)
+      : id(id), region(std::move(region)), func(func),
+        label(std::move(label)), index(index), m(m),
+        create_time(create_time) {}
+
+  const int id;
+  const std::shared_ptr<region_info> region;
+  const void *const func; // nullptr for runtime-internal tasks
+  const string label;     // used as the name if func is nullptr
+  const int index;        // among the same function or label in the region
+  const mode m;
+  const int64_t create_time;
+
+  // Scheduler statistics and states are only updated by the worker running
+  // this task, but may be read by monitors at any time.
+  std::atomic<uint64_t> resume_count{0};
+  std::atomic<int64_t> finish_time{0}; // 0 if not finished
+
+  // channel this task is suspended on; nullptr if running or ready
+  std::atomic<const base_queue *> blocked_queue{nullptr};
+  std::atomic<bool> is_blocked_on_full{false};
+
+  // performance counters accumulated while this task is running
+  std::atomic<uint64_t> perf_counts[kPerfEventCount] = {};
+};
+
+namespace {
+
+// Increments a counter that only has a single writer.
+void increment(std::atomic<uint64_t> &counter, uint64_t delta = 1) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+} // namespace
+
 namespace {
 
 thread_local pull_type *current_handle;
+thread_local task_info *current_task = nullptr;
+thread_local std::weak_ptr<region_info> last_created_region;
 thread_local bool debug = false;
 mutex debug_mtx; // Print stacktrace one-by-one.
 
+enum class perf_source { none, hardware, software, clock };
+perf_source perf_events = perf_source::none;
+
+const std::vector<const char *> &get_perf_event_names(perf_source source) {
+  static const std::vector<const char *> names[] = {
+      {},
+      {"instructions", "cycles", "cache-misses", "branch-misses"},
+      {"task-clock", "context-switches", "page-faults", "cpu-migrations"},
+      {"task-clock"},
+  };
+  return names[static_cast<int>(source)];
+}
+
+const uint64_t *get_perf_event_configs(perf_source source) {
+  static const uint64_t hardware[kPerfEventCount] = {
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  static const uint64_t software[kPerfEventCount] = {
+      PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_CONTEXT_SWITCHES,
+      PERF_COUNT_SW_PAGE_FAULTS, PERF_COUNT_SW_CPU_MIGRATIONS};
+  return source == perf_source::hardware ? hardware : software;
+}
+
+uint64_t get_time_ns() {
+  timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
+}
+
+// Resolves function addresses to names for reports. Executables do not export
+// their functions by default, so the symbol tables of the object files are
+// read instead of relying on dladdr.
+class symbolizer {
+  struct symbol {
+    uintptr_t addr;
+    uintptr_t size;
+    string name;
+  };
+
+  // dict mapping object file path to its function symbols sorted by address
+  unordered_map<string, std::vector<symbol>> objects;
+
+  static std::vector<symbol> load(const string &path, uintptr_t bias) {
+    std::vector<symbol> symbols;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return symbols;
+    }
+    struct stat sb;
+    void *ptr = MAP_FAILED;
+    if (fstat(fd, &sb) == 0 && sb.st_size >= off_t(sizeof(Elf64_Ehdr))) {
+      ptr = ::mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      return symbols;
+    }
+    const auto base = static_cast<const char *>(ptr);
+    const auto ehdr = reinterpret_cast<const Elf64_Ehdr *>(base);
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0 &&
+        ehdr->e_ident[EI_CLASS] == ELFCLASS64 &&
+        ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) <=
+            uint64_t(sb.st_size)) {
+      const auto shdrs =
+          reinterpret_cast<const Elf64_Shdr *>(base + ehdr->e_shoff);
+      for (int i = 0; i < ehdr->e_shnum; ++i) {
+        const auto &shdr = shdrs[i];
+        if ((shdr.sh_type != SHT_SYMTAB && shdr.sh_type != SHT_DYNSYM) ||
+            shdr.sh_link >= ehdr->e_shnum ||
+            shdr.sh_offset + shdr.sh_size > uint64_t(sb.st_size)) {
+          continue;
+        }
+        const auto &strtab = shdrs[shdr.sh_link];
+        const auto syms =
+            reinterpret_cast<const Elf64_Sym *>(base + shdr.sh_offset);
+        for (size_t j = 0; j < shdr.sh_size / sizeof(Elf64_Sym); ++j) {
+          const auto &sym = syms[j];
+          if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_value == 0 ||
+              sym.st_name >= strtab.sh_size) {
+            continue;
+          }
+          symbols.push_back({sym.st_value + bias, sym.st_size,
+                             base + strtab.sh_offset + sym.st_name});
+        }
+      }
+    }
+    munmap(ptr, sb.st_size);
+    std::sort(symbols.begin(), symbols.end(),
+              [](const symbol &lhs, const symbol &rhs) {
+                return lhs.addr < rhs.addr;
+              });
+    return symbols;
+  }
+
+  static string demangle(const string &mangled) {
+    int status = 0;
+    char *demangled =
+        abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    string name = status == 0 ? demangled : mangled;
+    free(demangled);
+
+    // strip the parameter list
+    int depth = 0;
+    for (size_t i = 0; i < name.size(); ++i) {
+      if (name[i] == '<') {
+        ++depth;
+      } else if (name[i] == '>') {
+        --depth;
+      } else if (name[i] == '(' && depth == 0 && i > 0) {
+        return name.substr(0, i);
+      }
+    }
+    return name;
+  }
+
+public:
+  string lookup(const void *func) {
+    struct query {
+      uintptr_t addr;
+      string path;
+      uintptr_t bias;
+      bool found;
+    } q{reinterpret_cast<uintptr_t>(func), "", 0, false};
+    dl_iterate_phdr(
+        [](dl_phdr_info *info, size_t, void *data) {
+          auto q = static_cast<query *>(data);
+          for (int i = 0; i < info->dlpi_phnum; ++i) {
+            const auto &phdr = info->dlpi_phdr[i];
+            const uintptr_t begin = info->dlpi_addr + phdr.p_vaddr;
+            if (phdr.p_type == PT_LOAD && q->addr >= begin &&
+                q->addr < begin + phdr.p_memsz) {
+              q->path = info->dlpi_name;
+              q->bias = info->dlpi_addr;
+              q->found = true;
+              return 1;
+            }
+          }
+          return 0;
+        },
+        &q);
+    if (q.found) {
+      if (q.path.empty()) {
+        q.path = "/proc/self/exe";
+      }
+      auto it = this->objects.find(q.path);
+      if (it == this->objects.end()) {
+        it = this->objects.emplace(q.path, load(q.path, q.bias)).first;
+      }
+      const auto &symbols = it->second;
+      auto sym = std::upper_bound(
+          symbols.begin(), symbols.end(), q.addr,
+          [](uintptr_t addr, const symbol &sym) { return addr < sym.addr; });
+      if (sym != symbols.begin()) {
+        --sym;
+        if (q.addr < sym->addr + std::max<uintptr_t>(sym->size, 1)) {
+          return demangle(sym->name);
+        }
+      }
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%p", func);
+    return buf;
+  }
+};
+
+// Bookkeeping of all parallel regions, task instances, and channels under the
+// top-level task::parallel. Only accessed when tasks are created and finished
+// and when reports are generated; the data path never touches it.
+//
+// Live tasks and channels are always kept, in shards so that workers creating
+// and finishing tasks rarely contend. Unless an exporter that reports on the
+// whole run is enabled, nothing else is kept and the registry lock is never
+// taken on behalf of the workers, so that the bookkeeping neither grows with
+// the run nor changes its behavior.
+class registry {
+  struct channel_info {
+    std::shared_ptr<base_queue> queue;
+    std::vector<const task_info *> producers;
+    std::vector<const task_info *> consumers;
+  };
+
+  struct live_channel {
+    std::weak_ptr<base_queue> queue;
+    uint64_t id;
+  };
+
+  // Unfinished tasks and channels that may still be alive; tasks are owned
+  // here unless recorded.
+  struct shard {
+    mutex mtx;
+    unordered_map<const task_info *, std::unique_ptr<task_info>> tasks;
+    unordered_map<const base_queue *, live_channel> channels;
+    size_t channel_limit = 64; // prunes expired channels beyond this
+  };
+  static constexpr int kShardCount = 16;
+  mutable shard shards[kShardCount];
+
+  shard &get_shard(const void *ptr) const {
+    // both tasks and channels are larger than 64 bytes
+    return this->shards[reinterpret_cast<uintptr_t>(ptr) / 64 % kShardCount];
+  }
+
+  // set before the first region is created
+  bool is_recording = false;
+  std::atomic<int> region_count{0};
+  std::atomic<int> unrecorded_task_count{0};
+  std::atomic<uint64_t> channel_count{0};
+
+  // recorded bookkeeping, guarded by mtx
+  mutable mutex mtx;
+  std::vector<std::shared_ptr<region_info>> regions;
+  std::deque<task_info> tasks;
+  std::vector<channel_info> channels;
+  unordered_map<const base_queue *, size_t> channel_table;
+
+  // function names are resolved lazily and cached since symbolization is
+  // expensive; guarded by mtx
+  mutable symbolizer symbols;
+  mutable unordered_map<const void *, string> func_names;
+
+  string get_name(const task_info &task) const {
+    string name = task.label;
+    if (task.func != nullptr) {
+      auto it = this->func_names.find(task.func);
+      if (it == this->func_names.end()) {
+        it = this->func_names.emplace(task.func, symbols.lookup(task.func))
+                 .first;
+      }
+      name = it->second;
+    }
+    return name + "[" + std::to_string(task.index) + "]";
+  }
+
+public:
+  // Must be set before the first region is created.
+  void set_recording(bool is_recording) {
+    unique_lock lock(this->mtx);
+    this->is_recording = is_recording;
+  }
+
+  std::shared_ptr<region_info> create_region(const task_info *parent) {
+    if (!this->is_recording) {
+      // the parent task may finish and be released before the region
+      return std::make_shared<region_info>(this->region_count++, nullptr);
+    }
+    unique_lock lock(this->mtx);
+    this->regions.push_back(
+        std::make_shared<region_info>(this->region_count++, parent));
+    return this->regions.back();
+  }
+
+  task_info *create_task(const std::shared_ptr<region_info> &region,
+                         const void *func, string label, mode m) {
+    int index = 0;
+    if (region != nullptr) {
+      unique_lock lock(region->mtx);
+      index = region->instance_counts[std::make_pair(func, label)]++;
+    }
+    task_info *task;
+    std::unique_ptr<task_info> owner;
+    if (this->is_recording) {
+      unique_lock lock(this->mtx);
+      this->tasks.emplace_back(this->tasks.size(), region, func,
+                               std::move(label), index, m, get_time_ns());
+      task = &this->tasks.back();
+      if (region != nullptr) {
+        region->tasks.push_back(task);
+      }
+    } else {
+      task = new task_info(this->unrecorded_task_count++, region, func,
+                           std::move(label), index, m, get_time_ns());
+      owner.reset(task);
+    }
+    auto &shard = this->get_shard(task);
+    unique_lock lock(shard.mtx);
+    shard.tasks.emplace(task, std::move(owner));
+    return task;
+  }
+
+  void bind_channel(const task_info *task,
+                    const std::shared_ptr<base_queue> &queue, bool is_output) {
+    {
+      auto &shard = this->get_shard(queue.get());
+      unique_lock lock(shard.mtx);
+      if (shard.channels.size() >= shard.channel_limit) {
+        for (auto it = shard.channels.begin(); it != shard.channels.end();) {
+          it = it->second.queue.expired() ? shard.channels.erase(it) : ++it;
+        }
+        shard.channel_limit = std::max<size_t>(64, shard.channels.size() * 2);
+      }
+      // the address of an expired channel may be reused by a new one
+      auto it = shard.channels.find(queue.get());
+      if (it == shard.channels.end()) {
+        shard.channels.emplace(queue.get(),
+                               live_channel{queue, this->channel_count++});
+      } else if (it->second.queue.expired()) {
+        it->second = {queue, this->channel_count++};
+      }
+    }
+    if (!this->is_recording) {
+      return;
+    }
+    unique_lock lock(this->mtx);
+    auto it = this->channel_table.find(queue.get());
+    if (it == this->channel_table.end()) {
+      it = this->channel_table.emplace(queue.get(), this->channels.size())
+               .first;
+      this->channels.push_back({queue, {}, {}});
+    }
+    auto &channel = this->channels[it->second];
+    (is_output ? channel.producers : channel.consumers).push_back(task);
+  }
+
+  // Releases a finished task unless it is recorded. The task must not be
+  // accessed afterwards.
+  void finish_task(const task_info *task) {
+    auto &shard = this->get_shard(task);
+    unique_lock lock(shard.mtx);
+    shard.tasks.erase(task);
+  }
+
+  void write_topology(const string &filename) const;
+  void write_snapshot(std::ostream &os) const;
+  void publish(metrics::header *segment) const;
+  void log_perf_counts() const;
+  void write_trace_tasks(string &buffer) const;
+
+  void clear() {
+    unique_lock lock(this->mtx);
+    for (auto &shard : this->shards) {
+      unique_lock shard_lock(shard.mtx);
+      shard.tasks.clear();
+      shard.channels.clear();
+      shard.channel_limit = 64;
+    }
+    this->channel_table.clear();
+    this->channels.clear();
+    this->tasks.clear();
+    this->regions.clear();
+    this->region_count = 0;
+    this->unrecorded_task_count = 0;
+    this->channel_count = 0;
+  }
+};
+
+// escapes a string for both JSON and DOT string literals
+string quote(const string &str) {
+  string result = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
+void registry::log_perf_counts() const {
+  unique_lock lock(this->mtx);
+  const auto &event_names = get_perf_event_names(perf_events);
+  std::vector<const task_info *> tasks;
+  for (const auto &task : this->tasks) {
+    tasks.push_back(&task);
+  }
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](const task_info *lhs, const task_info *rhs) {
+                     return lhs->perf_counts[0] > rhs->perf_counts[0];
+                   });
+
+  std::ostringstream os;
+  char buf[32];
+  os << "per-task performance counters:\n";
+  os << std::left << std::setw(40) << "task" << std::right;
+  for (auto name : event_names) {
+    snprintf(buf, sizeof(buf), " %16s", name);
+    os << buf;
+  }
+  snprintf(buf, sizeof(buf), " %12s", "resumes");
+  os << buf;
+  for (auto task : tasks) {
+    string name = this->get_name(*task);
+    if (name.size() > 40) {
+      name = name.substr(0, 37) + "...";
+    }
+    os << '\n' << std::left << std::setw(40) << name << std::right;
+    for (size_t i = 0; i < event_names.size(); ++i) {
+      snprintf(buf, sizeof(buf), " %16" PRIu64, task->perf_counts[i].load());
+      os << buf;
+    }
+    snprintf(buf, sizeof(buf), " %12" PRIu64, task->resume_count.load());
+    os << buf;
+  }
+  LOG(INFO) << os.str();
+}
+
+void registry::write_topology(const string &filename) const {
+  unique_lock lock(this->mtx);
+  const int64_t now = get_time_ns();
+
+  std::vector<string> names;
+  for (const auto &task : this->tasks) {
+    names.push_back(this->get_name(task));
+  }
+
+  // Tasks that merely forward a channel to their children are not endpoints.
+  auto is_forwarded = [](const task_info *task,
+                         const std::vector<const task_info *> &endpoints) {
+    for (auto other : endpoints) {
+      for (const region_info *region = other->region.get(); region != nullptr;
+           region = region->parent == nullptr ? nullptr
+                                              : region->parent->region.get()) {
+        if (region->parent == task) {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+  std::vector<channel_info> channels;
+  for (const auto &channel : this->channels) {
+    channels.push_back({channel.queue, {}, {}});
+    for (auto task : channel.producers) {
+      if (!is_forwarded(task, channel.producers)) {
+        channels.back().producers.push_back(task);
+      }
+    }
+    for (auto task : channel.consumers) {
+      if (!is_forwarded(task, channel.consumers)) {
+        channels.back().consumers.push_back(task);
+      }
+    }
+  }
+
+  // measures each channel over the lifetime of the tasks connected to it
+  auto get_throughput = [now](const channel_info &channel) {
+    int64_t begin = now;
+    int64_t end = 0;
+    for (auto endpoints : {&channel.producers, &channel.consumers}) {
+      for (auto task : *endpoints) {
+        begin = std::min(begin, task->create_time);
+        const int64_t finish_time = task->finish_time;
+        end = std::max(end, finish_time == 0 ? now : finish_time);
+      }
+    }
+    const auto token_count = channel.queue->get_token_count();
+    return end > begin ? token_count * 1e9 / (end - begin) : 0.;
+  };
+
+  std::ofstream os(filename);
+  if (ends_with(filename, ".json")) {
+    os << "{\n  \"regions\": [";
+    for (const auto &region : this->regions) {
+      os << (region->id == 0 ? "" : ",") << "\n    {\"id\": " << region->id
+         << ", \"parent\": ";
+      if (region->parent == nullptr) {
+        os << "null";
+      } else {
+        os << region->parent->id;
+      }
+      os << ", \"tasks\": [";
+      for (size_t i = 0; i < region->tasks.size(); ++i) {
+        os << (i == 0 ? "" : ", ") << region->tasks[i]->id;
+      }
+      os << "]}";
+    }
+    os << "\n  ],\n  \"tasks\": [";
+    for (const auto &task : this->tasks) {
+      os << (task.id == 0 ? "" : ",") << "\n    {\"id\": " << task.id
+         << ", \"region\": "
+         << (task.region == nullptr ? -1 : task.region->id)
+         << ", \"name\": " << quote(names[task.id])
+         << ", \"index\": " << task.index << ", \"mode\": \""
+         << (task.m == join ? "join" : "detach")
+         << "\", \"resume_count\": " << task.resume_count.load()
+         << ", \"finished\": " << (task.finish_time != 0 ? "true" : "false");
+      const auto &event_names = get_perf_event_names(perf_events);
+      if (!event_names.empty()) {
+        os << ", \"perf\": {";
+        for (size_t i = 0; i < event_names.size(); ++i) {
+          os << (i == 0 ? "" : ", ") << quote(event_names[i]) << ": "
+             << task.perf_counts[i].load();
+        }
+        os << "}";
+      }
+      os << "}";
+    }
+    os << "\n  ],\n  \"channels\": [";
+    for (size_t i = 0; i < channels.size(); ++i) {
+      const auto &channel = channels[i];
+      os << (i == 0 ? "" : ",") << "\n    {\"id\": " << i
+         << ", \"name\": " << quote(channel.queue->get_name())
+         << ", \"depth\": " << channel.queue->get_depth()
+         << ", \"token_count\": " << channel.queue->get_token_count()
+         << ", \"tokens_per_second\": " << get_throughput(channel);
+      for (auto endpoints : {std::make_pair("producers", &channel.producers),
+                             std::make_pair("consumers", &channel.consumers)}) {
+        os << ", \"" << endpoints.first << "\": [";
+        for (size_t j = 0; j < endpoints.second->size(); ++j) {
+          os << (j == 0 ? "" : ", ") << (*endpoints.second)[j]->id;
+        }
+        os << "]";
+      }
+      os << "}";
+    }
+    os << "\n  ]\n}\n";
+  } else {
+    os << "digraph task {\n  node [shape=box];\n";
+    for (const auto &region : this->regions) {
+      os << "  subgraph cluster_" << region->id << " {\n    label="
+         << quote("parallel #" + std::to_string(region->id) +
+                  (region->parent == nullptr
+                       ? ""
+                       : " in " + names[region->parent->id]))
+         << ";\n";
+      for (auto task : region->tasks) {
+        std::ostringstream label;
+        label << names[task->id];
+        const auto &event_names = get_perf_event_names(perf_events);
+        for (size_t i = 0; i < event_names.size(); ++i) {
+          label << "\n" << event_names[i] << ": " << task->perf_counts[i];
+        }
+        os << "    task_" << task->id << " [label=" << quote(label.str())
+           << (task->m == detach ? ", style=dashed" : "") << "];\n";
+      }
+      os << "  }\n";
+    }
+    for (size_t i = 0; i < channels.size(); ++i) {
+      const auto &channel = channels[i];
+      std::ostringstream label;
+      label << channel.queue->get_name() << "\n"
+            << "depth: " << channel.queue->get_depth() << "\n"
+            << channel.queue->get_token_count() << " tokens\n"
+            << get_throughput(channel) << " tokens/s";
+
+      // dangling channels are connected to a point
+      const string point = "channel_" + std::to_string(i);
+      if (channel.producers.empty() || channel.consumers.empty()) {
+        os << "  " << point << " [shape=point];\n";
+      }
+      std::vector<string> producers{point};
+      std::vector<string> consumers{point};
+      if (!channel.producers.empty()) {
+        producers.clear();
+        for (auto task : channel.producers) {
+          producers.push_back("task_" + std::to_string(task->id));
+        }
+      }
+      if (!channel.consumers.empty()) {
+        consumers.clear();
+        for (auto task : channel.consumers) {
+          consumers.push_back("task_" + std::to_string(task->id));
+        }
+      }
+      for (const auto &producer : producers) {
+        for (const auto &consumer : consumers) {
+          os << "  " << producer << " -> " << consumer
+             << " [label=" << quote(label.str()) << "];\n";
+        }
+      }
+    }
+    os << "}\n";
+  }
+
+  if (os) {
+    LOG(INFO) << "topology of " << this->regions.size()
+              << " parallel regions written to '" << filename << "'";
+  } else {
+    LOG(WARNING) << "failed to write topology to '" << filename << "'";
+  }
+}
+
+void registry::write_snapshot(std::ostream &os) const {
+  unique_lock lock(this->mtx);
+
+  // channels are only dereferenced while kept alive here
+  unordered_map<const base_queue *, std::shared_ptr<base_queue>> channels;
+  for (auto &shard : this->shards) {
+    unique_lock shard_lock(shard.mtx);
+    for (const auto &pair : shard.channels) {
+      if (auto queue = pair.second.queue.lock()) {
+        channels.emplace(pair.first, std::move(queue));
+      }
+    }
+  }
+
+  std::vector<std::pair<int, string>> lines; // sorted by task id
+  for (auto &shard : this->shards) {
+    unique_lock shard_lock(shard.mtx);
+    for (const auto &pair : shard.tasks) {
+      const auto &task = *pair.first;
+      if (task.finish_time.load(std::memory_order_relaxed) != 0) {
+        continue;
+      }
+      std::ostringstream line;
+      line << this->get_name(task);
+      auto queue = task.blocked_queue.load(std::memory_order_acquire);
+      if (queue != nullptr && channels.count(queue) != 0) {
+        line << ": blocked on "
+             << (task.is_blocked_on_full.load(std::memory_order_relaxed)
+                     ? "full"
+                     : "empty")
+             << " channel '" << queue->get_name() << "' ("
+             << queue->get_size() << "/" << queue->get_depth() << ")\n";
+      } else if (queue != nullptr) {
+        line << ": blocked on unknown channel\n";
+      } else {
+        line << ": running\n";
+      }
+      lines.emplace_back(task.id, line.str());
+    }
+  }
+  std::sort(lines.begin(), lines.end());
+  for (const auto &line : lines) {
+    os << line.second;
+  }
+}
+
+void registry::publish(metrics::header *segment) const {
+  unique_lock lock(this->mtx);
+  const uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+  segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto copy_name = [](char(&dst)[metrics::kNameLength], const string &src) {
+    strncpy(dst, src.c_str(), metrics::kNameLength - 1);
+    dst[metrics::kNameLength - 1] = '\0';
+  };
+
+  // channels are held while published; expired ones are dropped
+  std::vector<std::pair<uint64_t, std::shared_ptr<base_queue>>> queues;
+  for (auto &shard : this->shards) {
+    unique_lock shard_lock(shard.mtx);
+    for (auto it = shard.channels.begin(); it != shard.channels.end();) {
+      if (auto queue = it->second.queue.lock()) {
+        queues.emplace_back(it->second.id, std::move(queue));
+        ++it;
+      } else {
+        it = shard.channels.erase(it);
+      }
+    }
+  }
+  std::sort(queues.begin(), queues.end(),
+            [](const std::pair<uint64_t, std::shared_ptr<base_queue>> &lhs,
+               const std::pair<uint64_t, std::shared_ptr<base_queue>> &rhs) {
+              return lhs.first < rhs.first;
+            });
+  const auto channel_count =
+      std::min<size_t>(queues.size(), metrics::kChannelCapacity);
+  unordered_map<const base_queue *, int32_t> channel_indices;
+  for (size_t i = 0; i < channel_count; ++i) {
+    const auto &queue = queues[i].second;
+    auto &slot = metrics::channels(segment)[i];
+    slot.id = queues[i].first;
+    copy_name(slot.name, queue->get_name());
+    slot.depth = queue->get_depth();
+    slot.size = queue->get_size();
+    slot.token_count = queue->get_token_count();
+    channel_indices[queue.get()] = i;
+  }
+
+  size_t task_count = 0;
+  auto add_task = [&](const task_info &task) {
+    auto &slot = metrics::tasks(segment)[task_count++];
+    slot.id = task.id;
+    copy_name(slot.name, this->get_name(task));
+    slot.region = task.region == nullptr ? -1 : task.region->id;
+    slot.detached = task.m == detach;
+    slot.resume_count = task.resume_count.load(std::memory_order_relaxed);
+    slot.blocked_channel = -1;
+    if (task.finish_time.load(std::memory_order_relaxed) != 0) {
+      slot.state = metrics::kFinished;
+    } else if (auto queue =
+                   task.blocked_queue.load(std::memory_order_acquire)) {
+      slot.state = task.is_blocked_on_full.load(std::memory_order_relaxed)
+                       ? metrics::kBlockedFull
+                       : metrics::kBlockedEmpty;
+      auto it = channel_indices.find(queue);
+      if (it != channel_indices.end()) {
+        slot.blocked_channel = it->second;
+      }
+    } else {
+      slot.state = metrics::kRunning;
+    }
+  };
+  auto sort_tasks = [segment](size_t begin, size_t end) {
+    std::sort(metrics::tasks(segment) + begin, metrics::tasks(segment) + end,
+              [](const metrics::task_slot &lhs, const metrics::task_slot &rhs) {
+                return lhs.id < rhs.id;
+              });
+  };
+
+  // unfinished tasks first, which are only accessed under their shard lock
+  for (auto &shard : this->shards) {
+    unique_lock shard_lock(shard.mtx);
+    for (const auto &pair : shard.tasks) {
+      if (task_count < metrics::kTaskCapacity &&
+          pair.first->finish_time.load(std::memory_order_relaxed) == 0) {
+        add_task(*pair.first);
+      }
+    }
+  }
+  sort_tasks(0, task_count);
+
+  // then the most recently created of the finished tasks, if recorded
+  const size_t unfinished_count = task_count;
+  for (auto it = this->tasks.rbegin();
+       it != this->tasks.rend() && task_count < metrics::kTaskCapacity;
+       ++it) {
+    if (it->finish_time.load(std::memory_order_relaxed) != 0) {
+      add_task(*it);
+    }
+  }
+  sort_tasks(unfinished_count, task_count);
+
+  segment->timestamp_ns = get_time_ns();
+  segment->task_count = task_count;
+  segment->channel_count = channel_count;
+  std::atomic_thread_fence(std::memory_order_release);
+  segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void registry::write_trace_tasks(string &buffer) const {
+  unique_lock lock(this->mtx);
+  buffer.push_back(trace::kTaskTag);
+  trace::put_varint(buffer, this->tasks.size());
+  for (const auto &task : this->tasks) {
+    const string name = this->get_name(task);
+    trace::put_varint(buffer, task.id);
+    trace::put_varint(buffer, name.size());
+    buffer += name;
+  }
+}
+
+registry *topology = new registry; // never destructed; outlives workers
+
+// Periodically publishes the counters in the registry to a shared-memory
+// segment for external monitors such as tasktop. Workers only update their own
+// counters, so the data path is not affected.
+class metrics_publisher {
+  string name;
+  metrics::header *segment = nullptr;
+  mutex mtx;
+  condition_variable cv;
+  bool done = false;
+  std::thread thread;
+
+public:
+  metrics_publisher(int64_t interval_ms)
+      : name(metrics::segment_name(getpid())) {
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd == -1) {
+      LOG(WARNING) << "cannot create metrics segment '" << this->name
+                   << "': " << std::strerror(errno);
+      return;
+    }
+    void *ptr = MAP_FAILED;
+    if (ftruncate(fd, metrics::segment_size()) == 0) {
+      ptr = ::mmap(nullptr, metrics::segment_size(), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      LOG(WARNING) << "cannot map metrics segment '" << this->name
+                   << "': " << std::strerror(errno);
+      shm_unlink(this->name.c_str());
+      return;
+    }
+    this->segment = new (ptr) metrics::header{};
+    this->segment->magic = metrics::kMagic;
+    this->segment->version = metrics::kVersion;
+    this->segment->pid = getpid();
+    LOG(INFO) << "publishing metrics to /dev/shm" << this->name;
+
+    this->thread = std::thread([this, interval_ms] {
+      unique_lock lock(this->mtx);
+      while (!this->cv.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                                [this] { return this->done; })) {
+        topology->publish(this->segment);
+      }
+      topology->publish(this->segment);
+    });
+  }
+
+  ~metrics_publisher() {
+    if (this->segment == nullptr) {
+      return;
+    }
+    {
+      unique_lock lock(this->mtx);
+      this->done = true;
+    }
+    this->cv.notify_all();
+    this->thread.join();
+    munmap(this->segment, metrics::segment_size());
+    shm_unlink(this->name.c_str());
+  }
+};
+
+// Writes the blocked state of all live tasks to a file upon request. Unlike
+// the SIGINT stacktraces, this neither involves nor disturbs the workers.
+class snapshot_writer {
+  string filename;
+  sem_t sem;
+  std::thread thread;
+
+public:
+  snapshot_writer() {
+    if (auto filename = getenv("TASK_SNAPSHOT_FILE")) {
+      this->filename = filename;
+    } else {
+      this->filename = "/tmp/task." + std::to_string(getpid()) + ".snapshot";
+    }
+    sem_init(&this->sem, /*pshared=*/0, /*value=*/0);
+    this->thread = std::thread([this] {
+      for (;;) {
+        if (sem_wait(&this->sem) != 0) {
+          continue; // EINTR
+        }
+        const int64_t begin = get_time_ns();
+        std::ostringstream os;
+        topology->write_snapshot(os);
+        std::ofstream(this->filename) << os.str();
+        LOG(INFO) << "wrote snapshot to '" << this->filename << "' in "
+                  << (get_time_ns() - begin) / 1000 << " us";
+      }
+    });
+    this->thread.detach();
+  }
+
+  // async-signal-safe
+  void request() { sem_post(&this->sem); }
+};
+
+snapshot_writer *snapshot = nullptr; // never destructed; outlives workers
+
+// Records memory accesses to the file named by TASK_TRACE. Each worker appends
+// to its own chunk, so the data path only takes a lock to resolve a new bank or
+// to write a full chunk to the file.
+class trace_recorder {
+  // Records of one thread since its chunk was last written.
+  struct chunk {
+    string data;
+    trace::record prev;
+    unordered_map<const void *, uint64_t> banks; // cache of bank_table
+  };
+
+  // Flush a chunk once it reaches this size (in bytes).
+  static constexpr size_t kChunkSize = 1 << 20;
+
+  const uint64_t generation;
+  std::ofstream file;
+  mutex mtx;
+  std::vector<std::unique_ptr<chunk>> chunks;
+  unordered_map<const void *, uint64_t> bank_table;
+  std::atomic<uint64_t> record_count{0};
+
+  static std::atomic<uint64_t> &last_generation() {
+    static std::atomic<uint64_t> generation{0};
+    return generation;
+  }
+
+  // Returns the chunk of the calling thread, created on first use.
+  chunk &get_chunk() {
+    thread_local chunk *current = nullptr;
+    thread_local uint64_t current_generation = 0;
+    if (current_generation != this->generation) {
+      unique_lock lock(this->mtx);
+      this->chunks.emplace_back(new chunk);
+      current = this->chunks.back().get();
+      current_generation = this->generation;
+    }
+    return *current;
+  }
+
+  uint64_t get_bank(chunk &c, const void *base) {
+    auto it = c.banks.find(base);
+    if (it == c.banks.end()) {
+      unique_lock lock(this->mtx);
+      const auto bank =
+          this->bank_table.emplace(base, this->bank_table.size()).first;
+      it = c.banks.emplace(base, bank->second).first;
+    }
+    return it->second;
+  }
+
+  // Appends the chunk to the file; lock must be held.
+  void write(chunk &c) {
+    string header(1, trace::kChunkTag);
+    trace::put_varint(header, c.data.size());
+    this->file << header << c.data;
+    c.data.clear();
+    c.prev = trace::record();
+  }
+
+public:
+  explicit trace_recorder(const string &filename)
+      : generation(++last_generation()),
+        file(filename, std::ios::binary | std::ios::trunc) {
+    if (!this->file) {
+      LOG(ERROR) << "cannot open trace file '" << filename << "'";
+    }
+    this->file.write(trace::kMagic, sizeof(trace::kMagic));
+  }
+
+  void record(const task_info &task, const void *base, uint64_t offset,
+              uint64_t size, trace::access_kind kind) {
+    chunk &c = this->get_chunk();
+    trace::record curr;
+    curr.task = task.id;
+    curr.bank = this->get_bank(c, base);
+    curr.offset = offset;
+    curr.size = size;
+    curr.timestamp_ns = get_time_ns();
+    curr.kind = kind;
+    trace::encode(c.prev, curr, c.data);
+    c.prev = curr;
+    this->record_count.fetch_add(1, std::memory_order_relaxed);
+    if (c.data.size() >= kChunkSize) {
+      unique_lock lock(this->mtx);
+      this->write(c);
+    }
+  }
+
+  // Writes the remaining records and the tables; workers must have exited.
+  void finish(const string &filename) {
+    unique_lock lock(this->mtx);
+    for (auto &c : this->chunks) {
+      this->write(*c);
+    }
+    string buffer;
+    topology->write_trace_tasks(buffer);
+    buffer.push_back(trace::kBankTag);
+    trace::put_varint(buffer, this->bank_table.size());
+    for (const auto &bank : this->bank_table) {
+      trace::put_varint(buffer, bank.second);
+      trace::put_varint(buffer, reinterpret_cast<uintptr_t>(bank.first));
+    }
+    this->file << buffer;
+    this->file.close();
+    LOG(INFO) << "wrote " << this->record_count << " memory accesses to '"
+              << filename << "'";
+  }
+};
+
+trace_recorder *tracer = nullptr;
+
 } // namespace
 
-void yield(const string &msg) {
+void yield(const base_queue &queue, bool is_full) {
+  current_task->is_blocked_on_full.store(is_full, std::memory_order_relaxed);
+  current_task->blocked_queue.store(&queue, std::memory_order_release);
   if (debug) {
     unique_lock l(debug_mtx);
-    LOG(INFO) << msg;
+    LOG(INFO) << "channel '" << queue.get_name() << "' is "
+              << (is_full ? "full" : "empty");
 #if TASK_ENABLE_STACKTRACE
     for (auto &frame : boost::stacktrace::stacktrace()) {
       const auto line = frame.source_line();
@@ -85,12 +1121,6 @@ void yield(const string &msg) {
 
 namespace {
 
-uint64_t get_time_ns() {
-  timespec tp;
-  clock_gettime(CLOCK_MONOTONIC, &tp);
-  return static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
-}
-
 rlim_t get_stack_size() {
   rlimit rl;
   if (getrlimit(RLIMIT_STACK, &rl) != 0) {
@@ -99,15 +1129,99 @@ rlim_t get_stack_size() {
   return rl.rlim_cur;
 }
 
+// Group of performance counters of the calling thread. Hardware events are
+// preferred; software events are used where hardware counters are unavailable
+// (e.g., in VMs), and the thread CPU clock if perf_event_open is unavailable
+// altogether.
+class perf_group {
+  perf_source source;
+  std::vector<int> fds;
+
+public:
+  explicit perf_group(perf_source source) : source(source) {
+    if (source != perf_source::hardware && source != perf_source::software) {
+      return;
+    }
+    for (int i = 0; i < kPerfEventCount; ++i) {
+      perf_event_attr attr = {};
+      attr.size = sizeof(attr);
+      attr.type = source == perf_source::hardware ? PERF_TYPE_HARDWARE
+                                                  : PERF_TYPE_SOFTWARE;
+      attr.config = get_perf_event_configs(source)[i];
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      const int fd =
+          syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                  /*group_fd=*/this->fds.empty() ? -1 : this->fds[0], 0);
+      if (fd == -1) {
+        this->close_all();
+        return;
+      }
+      this->fds.push_back(fd);
+    }
+  }
+
+  perf_group(const perf_group &) = delete;
+  perf_group &operator=(const perf_group &) = delete;
+
+  ~perf_group() { this->close_all(); }
+
+  bool is_open() const {
+    return this->source == perf_source::clock || !this->fds.empty();
+  }
+
+  // Reads the current counts; counts of unused events are left unchanged.
+  bool read(uint64_t (&counts)[kPerfEventCount]) const {
+    if (this->source == perf_source::clock) {
+      timespec tp;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tp);
+      counts[0] = static_cast<uint64_t>(tp.tv_sec) * 1000000000 + tp.tv_nsec;
+      return true;
+    }
+    if (this->fds.empty()) {
+      return false;
+    }
+    uint64_t buf[1 + kPerfEventCount]; // {nr, values[nr]}
+    if (::read(this->fds[0], buf, sizeof(buf)) != sizeof(buf)) {
+      return false;
+    }
+    std::copy(buf + 1, buf + 1 + kPerfEventCount, counts);
+    return true;
+  }
+
+  // Selects the best source that can be opened in the calling thread.
+  static perf_source detect() {
+    for (auto source : {perf_source::hardware, perf_source::software}) {
+      if (perf_group(source).is_open()) {
+        return source;
+      }
+    }
+    return perf_source::clock;
+  }
+
+private:
+  void close_all() {
+    for (int fd : this->fds) {
+      close(fd);
+    }
+    this->fds.clear();
+  }
+};
+
 class worker {
   // dict mapping mode to list of coroutine
   // list is used because the stable pointer can be used as key in handle_table
   unordered_map<mode, std::list<push_type>> coroutines;
 
-  // dict mapping coroutine to handle
-  unordered_map<push_type *, pull_type *> handle_table;
+  // dict mapping coroutine to handle and bookkeeping
+  struct coroutine_info {
+    pull_type *handle;
+    task_info *task;
+  };
+  unordered_map<push_type *, coroutine_info> handle_table;
 
-  std::queue<std::tuple<mode, function<void()>>> tasks;
+  std::queue<std::tuple<task_info *, function<void()>>> tasks;
   mutex mtx;
   condition_variable task_cv;
   condition_variable wait_cv;
@@ -119,6 +1233,17 @@ public:
   worker() {
     auto stack_size = get_stack_size();
     this->thread = std::thread([this, stack_size]() {
+      std::unique_ptr<perf_group> counters;
+      if (perf_events != perf_source::none) {
+        counters.reset(new perf_group(perf_events));
+        if (!counters->is_open()) {
+          LOG(WARNING) << "cannot open performance counters in worker: "
+                       << std::strerror(errno);
+          counters.reset();
+        }
+      }
+      uint64_t prev_counts[kPerfEventCount] = {};
+      uint64_t curr_counts[kPerfEventCount] = {};
       for (;;) {
         // accept new tasks
         {
@@ -134,24 +1259,28 @@ public:
 
           // create coroutines
           while (!this->tasks.empty()) {
-            mode m;
+            task_info *task;
             function<void()> f;
-            std::tie(m, f) = this->tasks.front();
+            std::tie(task, f) = this->tasks.front();
             this->tasks.pop();
 
-            auto &l = this->coroutines[m]; // list of coroutines
+            auto &l = this->coroutines[task->m]; // list of coroutines
             auto coroutine = new push_type *;
             auto call_back = [this, &l, f, coroutine](pull_type &handle) {
-              this->handle_table[*coroutine] = current_handle = &handle;
+              this->handle_table[*coroutine].handle = current_handle = &handle;
               delete coroutine;
               f();
             };
             l.emplace_back(fixedsize_stack(stack_size), call_back);
             *coroutine = &l.back();
+            this->handle_table[*coroutine] = {nullptr, task};
           }
         }
 
         // iterate over all tasks and their coroutines
+        if (counters != nullptr) {
+          counters->read(prev_counts);
+        }
         bool active = false;
         bool debugging = this->signal;
         if (debugging)
@@ -160,9 +1289,24 @@ public:
           mode m = pair.first;
           auto &coroutines = pair.second;
           for (auto it = coroutines.begin(); it != coroutines.end();) {
+            auto &info = this->handle_table[&*it];
             if (auto &coroutine = *it) {
-              current_handle = this->handle_table[&coroutine];
+              current_handle = info.handle;
+              current_task = info.task;
+              increment(info.task->resume_count);
+              info.task->blocked_queue.store(nullptr,
+                                             std::memory_order_relaxed);
               coroutine();
+              current_task = nullptr;
+
+              // attribute counts since the last switch to this task
+              if (counters != nullptr && counters->read(curr_counts)) {
+                for (int i = 0; i < kPerfEventCount; ++i) {
+                  increment(info.task->perf_counts[i],
+                            curr_counts[i] - prev_counts[i]);
+                  prev_counts[i] = curr_counts[i];
+                }
+              }
             }
 
             if (*it) {
@@ -170,6 +1314,10 @@ public:
                 active = true;
               ++it;
             } else {
+              info.task->finish_time.store(get_time_ns(),
+                                           std::memory_order_relaxed);
+              topology->finish_task(info.task);
+              this->handle_table.erase(&*it);
               unique_lock lock(this->mtx);
               it = coroutines.erase(it);
             }
@@ -186,10 +1334,10 @@ public:
     });
   }
 
-  void add_task(mode m, const function<void()> &f) {
+  void add_task(task_info *task, const function<void()> &f) {
     {
       unique_lock lock(this->mtx);
-      this->tasks.emplace(m, f);
+      this->tasks.emplace(task, f);
     }
     this->task_cv.notify_one();
   }
@@ -222,7 +1370,11 @@ class thread_pool {
 
 public:
   thread_pool(size_t worker_count = 0) {
+    if (snapshot == nullptr) {
+      snapshot = new snapshot_writer;
+    }
     signal(SIGINT, signal_handler);
+    signal(SIGUSR1, signal_handler);
     if (worker_count == 0) {
       if (auto concurrency = getenv("TASK_CONCURRENCY")) {
         worker_count = atoi(concurrency);
@@ -241,9 +1393,9 @@ public:
     }
   }
 
-  void add_task(mode m, const function<void()> &f) {
+  void add_task(task_info *task, const function<void()> &f) {
     unique_lock lock(this->worker_mtx);
-    it->add_task(m, f);
+    it->add_task(task, f);
     ++it;
     if (it == this->workers.end())
       it = this->workers.begin();
@@ -266,6 +1418,7 @@ public:
 };
 
 thread_pool *pool = nullptr;
+metrics_publisher *publisher = nullptr;
 const parallel *top_task = nullptr;
 mutex mtx;
 
@@ -275,6 +1428,9 @@ mutex mtx;
 // 2. Each worker sets `this->signal`;
 // 3. Each worker prints debug info in next iteration of coroutines;
 // 4. Each worker clears `this->signal`.
+//
+// SIGUSR1 instead wakes up the snapshot writer, which writes one line per live
+// task to `TASK_SNAPSHOT_FILE` (default: /tmp/task.<pid>.snapshot).
 constexpr int64_t kSignalThreshold = 500 * 1000 * 1000; // 500 ms
 int64_t last_signal_timestamp = 0;
 void signal_handler(int signal) {
@@ -289,6 +1445,8 @@ void signal_handler(int signal) {
     LOG(INFO) << "caught SIGINT";
     last_signal_timestamp = signal_timestamp;
     pool->send(signal);
+  } else if (signal == SIGUSR1) {
+    snapshot->request();
   } else {
     last_signal_timestamp = get_time_ns();
   }
@@ -296,24 +1454,515 @@ void signal_handler(int signal) {
 
 } // namespace
 
-void schedule(mode m, const function<void()> &f) { pool->add_task(m, f); }
+void *map_file(const string &path, map_flag flags, uint64_t &bytes) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    LOG(FATAL) << "cannot open '" << path << "': " << strerror(errno);
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    LOG(FATAL) << "cannot stat '" << path << "': " << strerror(errno);
+  }
+  bytes = sb.st_size;
+  void *ptr = nullptr;
+  if (bytes > 0) {
+    const int prot = has_flag(flags, map_flag::copy_on_write)
+                         ? PROT_READ | PROT_WRITE
+                         : PROT_READ;
+    const int map_flags = has_flag(flags, map_flag::populate)
+                              ? MAP_PRIVATE | MAP_POPULATE
+                              : MAP_PRIVATE;
+    ptr = ::mmap(nullptr, bytes, prot, map_flags, fd, 0);
+    if (ptr == MAP_FAILED) {
+      LOG(FATAL) << "cannot map '" << path << "': " << strerror(errno);
+    }
+    for (auto advice : {std::make_pair(map_flag::sequential, MADV_SEQUENTIAL),
+                        std::make_pair(map_flag::random, MADV_RANDOM),
+                        std::make_pair(map_flag::huge_page, MADV_HUGEPAGE)}) {
+      if (has_flag(flags, advice.first) &&
+          madvise(ptr, bytes, advice.second) != 0) {
+        // hints are best-effort, e.g., huge pages of regular files are
+        // unsupported by many file systems
+        LOG(WARNING) << "cannot advise '" << path << "' ("
+                     << static_cast<uint32_t>(advice.first)
+                     << "): " << strerror(errno);
+      }
+    }
+  }
+  close(fd);
+  return ptr;
+}
+
+void unmap_file(void *ptr, uint64_t bytes) { munmap(ptr, bytes); }
+
+file_handle::file_handle(const string &path, bool is_writable) : path(path) {
+  this->fd = open(path.c_str(), is_writable ? O_RDWR : O_RDONLY);
+  if (this->fd == -1) {
+    LOG(FATAL) << "cannot open '" << path << "': " << strerror(errno);
+  }
+  struct stat sb;
+  if (fstat(this->fd, &sb) != 0) {
+    LOG(FATAL) << "cannot stat '" << path << "': " << strerror(errno);
+  }
+  this->size = sb.st_size;
+  this->direct_fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+  LOG_IF(INFO, this->direct_fd == -1)
+      << "cannot open '" << path << "' for direct I/O (" << strerror(errno)
+      << "); reading via the page cache";
+}
+
+file_handle::~file_handle() {
+  close(this->fd);
+  if (this->direct_fd != -1) {
+    close(this->direct_fd);
+  }
+}
+
+namespace {
+
+// Performs file I/O via a pool of threads calling pread/pwrite.
+class threaded_file_io : public file_io {
+public:
+  explicit threaded_file_io(uint32_t depth) {
+    // enough threads to keep a device busy but not one per request
+    const uint32_t thread_count = std::min<uint32_t>(depth, 8);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      this->threads.emplace_back([this] { this->run(); });
+    }
+  }
+
+  ~threaded_file_io() override {
+    {
+      unique_lock lock(this->mtx);
+      this->is_stopped = true;
+    }
+    this->cv.notify_all();
+    for (auto &thread : this->threads) {
+      thread.join();
+    }
+  }
+
+  void submit(file_request *request) override {
+    {
+      unique_lock lock(this->mtx);
+      this->requests.push_back(request);
+    }
+    this->cv.notify_one();
+  }
+
+  bool poll() override {
+    const uint64_t done_count = this->done_count;
+    const bool is_done = done_count != this->polled_count;
+    this->polled_count = done_count;
+    return is_done;
+  }
+
+private:
+  mutex mtx;
+  condition_variable cv;
+  std::deque<file_request *> requests;
+  bool is_stopped = false;
+  std::atomic<uint64_t> done_count{0};
+  uint64_t polled_count = 0;
+  std::vector<std::thread> threads;
+
+  void run() {
+    for (;;) {
+      file_request *request;
+      {
+        unique_lock lock(this->mtx);
+        this->cv.wait(lock, [this] {
+          return this->is_stopped || !this->requests.empty();
+        });
+        if (this->requests.empty()) {
+          return;
+        }
+        request = this->requests.front();
+        this->requests.pop_front();
+      }
+      // retries until the whole request is done, the end of the file, or
+      // an error
+      int64_t result = 0;
+      while (uint64_t(result) < request->size) {
+        auto buffer = static_cast<char *>(request->buffer) + result;
+        const uint64_t size = request->size - result;
+        const uint64_t offset = request->offset + result;
+        const ssize_t count =
+            request->is_write ? pwrite(request->fd, buffer, size, offset)
+                              : pread(request->fd, buffer, size, offset);
+        if (count < 0 && errno == EINTR) {
+          continue;
+        }
+        if (count <= 0) {
+          result = count < 0 && result == 0 ? -errno : result;
+          break;
+        }
+        result += count;
+      }
+      request->result = result;
+      request->is_done = true;
+      ++this->done_count;
+    }
+  }
+};
+
+// Performs file I/O via io_uring, without liburing. Kernels older than 5.6
+// support io_uring but not IORING_OP_READ and IORING_OP_WRITE, and fail such
+// requests with -EINVAL; if the first request fails so, this and all later
+// requests fall back to a threaded_file_io.
+class uring_file_io : public file_io {
+public:
+  // Returns nullptr if io_uring is unavailable.
+  static std::unique_ptr<uring_file_io> create(uint32_t depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, depth, &params);
+    if (fd < 0) {
+      LOG(INFO) << "io_uring is unavailable (" << strerror(errno) << ")";
+      return nullptr;
+    }
+    std::unique_ptr<uring_file_io> io(new uring_file_io(fd, depth, params));
+    if (io->sqes == MAP_FAILED || io->sq_ring == MAP_FAILED ||
+        io->cq_ring == MAP_FAILED) {
+      LOG(WARNING) << "cannot map io_uring (" << strerror(errno) << ")";
+      return nullptr;
+    }
+    return io;
+  }
+
+  ~uring_file_io() override {
+    if (this->sqes != MAP_FAILED) {
+      munmap(this->sqes, this->sqes_size);
+    }
+    if (this->cq_ring != MAP_FAILED && this->cq_ring != this->sq_ring) {
+      munmap(this->cq_ring, this->cq_ring_size);
+    }
+    if (this->sq_ring != MAP_FAILED) {
+      munmap(this->sq_ring, this->sq_ring_size);
+    }
+    close(this->fd);
+  }
+
+  void submit(file_request *request) override {
+    if (this->fallback != nullptr) {
+      this->fallback->submit(request);
+      return;
+    }
+    // the kernel consumes entries as they are submitted; waits for it to
+    // consume one instead of overwriting an entry still pending
+    auto tail = this->sq_tail->load(std::memory_order_relaxed);
+    while (tail - this->sq_head->load(std::memory_order_acquire) >=
+           this->sq_entries) {
+      if (!this->poll()) {
+        std::this_thread::yield();
+      }
+      if (this->fallback != nullptr) {
+        this->fallback->submit(request);
+        return;
+      }
+    }
+    const unsigned index = tail & this->sq_mask;
+    io_uring_sqe &sqe = this->sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = request->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe.fd = request->fd;
+    sqe.off = request->offset;
+    sqe.addr = reinterpret_cast<uint64_t>(request->buffer);
+    sqe.len = request->size;
+    sqe.user_data = reinterpret_cast<uint64_t>(request);
+    this->sq_array[index] = index;
+    this->sq_tail->store(tail + 1, std::memory_order_release);
+    ++this->pending_count;
+  }
+
+  bool poll() override {
+    // submits all requests at once
+    while (this->pending_count > 0) {
+      const int count = syscall(__NR_io_uring_enter, this->fd,
+                                this->pending_count, 0, 0, nullptr, 0);
+      if (count < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+          break; // retried by the next poll
+        }
+        LOG(FATAL) << "cannot submit to io_uring: " << strerror(errno);
+      }
+      this->pending_count -= count;
+    }
+
+    auto head = this->cq_head->load(std::memory_order_relaxed);
+    const auto tail = this->cq_tail->load(std::memory_order_acquire);
+    bool is_done = false;
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = this->cqes[head & this->cq_mask];
+      auto request = reinterpret_cast<file_request *>(cqe.user_data);
+      if (!this->is_supported && cqe.res == -EINVAL) {
+        if (this->fallback == nullptr) {
+          LOG(INFO) << "io_uring does not support file reads and writes; "
+                       "falling back to threads";
+          this->fallback.reset(new threaded_file_io(this->depth));
+        }
+        this->fallback->submit(request);
+        continue;
+      }
+      this->is_supported = true;
+      request->result = cqe.res;
+      request->is_done = true;
+      is_done = true;
+    }
+    this->cq_head->store(head, std::memory_order_release);
+    if (this->fallback != nullptr) {
+      is_done |= this->fallback->poll();
+    }
+    return is_done;
+  }
+
+private:
+  using ring_index = std::atomic<unsigned>;
+
+  const int fd;
+  const uint32_t depth;
+  unsigned pending_count = 0; // requests not yet submitted to the kernel
+
+  // set once a request completes other than with -EINVAL
+  bool is_supported = false;
+  std::unique_ptr<threaded_file_io> fallback;
+
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  void *sq_ring;
+  void *cq_ring;
+  io_uring_sqe *sqes;
+
+  ring_index *sq_head;
+  ring_index *sq_tail;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned *sq_array;
+  ring_index *cq_head;
+  ring_index *cq_tail;
+  unsigned cq_mask;
+  io_uring_cqe *cqes;
+
+  uring_file_io(int fd, uint32_t depth, const io_uring_params &params)
+      : fd(fd), depth(depth) {
+    this->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    this->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      this->sq_ring_size = this->cq_ring_size =
+          std::max(this->sq_ring_size, this->cq_ring_size);
+    }
+    this->sq_ring = ::mmap(nullptr, this->sq_ring_size,
+                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_SQ_RING);
+    this->cq_ring =
+        params.features & IORING_FEAT_SINGLE_MMAP
+            ? this->sq_ring
+            : ::mmap(nullptr, this->cq_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    this->sqes = static_cast<io_uring_sqe *>(
+        ::mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (this->sq_ring == MAP_FAILED || this->cq_ring == MAP_FAILED) {
+      return;
+    }
+    auto sq = static_cast<char *>(this->sq_ring);
+    auto cq = static_cast<char *>(this->cq_ring);
+    this->sq_head = reinterpret_cast<ring_index *>(sq + params.sq_off.head);
+    this->sq_tail = reinterpret_cast<ring_index *>(sq + params.sq_off.tail);
+    this->sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    this->sq_entries =
+        *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+    this->sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    this->cq_head = reinterpret_cast<ring_index *>(cq + params.cq_off.head);
+    this->cq_tail = reinterpret_cast<ring_index *>(cq + params.cq_off.tail);
+    this->cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    this->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<file_io> file_io::create(uint32_t depth) {
+  auto flag = getenv("TASK_ASYNC_FILE_PREAD");
+  if (flag == nullptr || *flag == '\0' || strcmp(flag, "0") == 0) {
+    if (auto io = uring_file_io::create(depth)) {
+      return io;
+    }
+  }
+  return std::unique_ptr<file_io>(new threaded_file_io(depth));
+}
+
+int get_numa_node_count() {
+  static const int count = [] {
+    // e.g., "0-3" or "0"
+    std::ifstream online("/sys/devices/system/node/online");
+    string nodes;
+    if (!(online >> nodes)) {
+      return 1;
+    }
+    const auto pos = nodes.find_last_of("-,");
+    return atoi(nodes.c_str() + (pos == string::npos ? 0 : pos + 1)) + 1;
+  }();
+  return count;
+}
+
+namespace {
+
+constexpr uint64_t kHugePageSize = 2 << 20;
+
+uint64_t round_up_to_huge_pages(uint64_t bytes) {
+  return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+} // namespace
+
+void *allocate_buffer(uint64_t bytes, int node) {
+  if (bytes == 0) {
+    return nullptr;
+  }
+  const int64_t start = get_time_ns();
+
+  // over-allocates so that the buffer can be aligned to a huge page
+  const uint64_t size = round_up_to_huge_pages(bytes);
+  auto base = static_cast<char *>(
+      ::mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (base == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  const uint64_t head = (kHugePageSize - reinterpret_cast<uintptr_t>(base) %
+                                             kHugePageSize) %
+                        kHugePageSize;
+  if (head > 0) {
+    munmap(base, head);
+  }
+  munmap(base + head + size, kHugePageSize - head);
+  auto ptr = base + head;
+
+  // huge pages and placement are best-effort
+  if (madvise(ptr, size, MADV_HUGEPAGE) != 0) {
+    LOG_EVERY_N(WARNING, 64) << "cannot use huge pages: " << strerror(errno);
+  }
+  if (node >= 0) {
+    constexpr int kBits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / kBits + 1);
+    mask[node / kBits] = 1UL << (node % kBits);
+    // the kernel takes one bit less than maxnode
+    if (syscall(SYS_mbind, ptr, size, MPOL_BIND, mask.data(),
+                mask.size() * kBits + 1, 0) != 0) {
+      LOG_EVERY_N(WARNING, 64)
+          << "cannot bind memory to NUMA node " << node << ": "
+          << strerror(errno);
+    }
+  }
+  const int64_t allocated = get_time_ns();
+
+  // first touch
+  const long page_size = sysconf(_SC_PAGESIZE);
+  for (uint64_t offset = 0; offset < size; offset += page_size) {
+    ptr[offset] = 0;
+  }
+  const int64_t touched = get_time_ns();
+
+  LOG(INFO) << "allocated " << bytes << " bytes on NUMA node "
+            << (node < 0 ? string("any") : std::to_string(node)) << " in "
+            << (allocated - start) / 1e6 << " ms; first touch in "
+            << (touched - allocated) / 1e6 << " ms";
+  return ptr;
+}
+
+void free_buffer(void *ptr, uint64_t bytes) {
+  munmap(ptr, round_up_to_huge_pages(bytes));
+}
+
+task_info *create_task(const std::shared_ptr<region_info> &region,
+                       const void *func, mode m) {
+  last_created_region = region;
+  return topology->create_task(region, func, "", m);
+}
+
+task_info *create_task(const char *label, mode m) {
+  return topology->create_task(last_created_region.lock(), nullptr, label, m);
+}
+
+void bind_channel(task_info *task, const std::shared_ptr<base_queue> &queue,
+                  bool is_output) {
+  if (task != nullptr && queue != nullptr) {
+    topology->bind_channel(task, queue, is_output);
+  }
+}
+
+void schedule(task_info *task, const function<void()> &f) {
+  pool->add_task(task, f);
+}
+
+bool is_tracing() { return tracer != nullptr; }
+
+void trace_access(const void *base, uint64_t offset, uint64_t size,
+                  trace::access_kind kind) {
+  if (tracer != nullptr && current_task != nullptr) {
+    tracer->record(*current_task, base, offset, size, kind);
+  }
+}
 
 } // namespace internal
 
 parallel::parallel() {
   unique_lock lock(internal::mtx);
   if (internal::pool == nullptr) {
+    auto perf = getenv("TASK_PERF");
+    if (perf != nullptr && *perf != '\0' && strcmp(perf, "0") != 0) {
+      internal::perf_events = internal::perf_group::detect();
+    }
+    auto trace = getenv("TASK_TRACE");
+    if (trace != nullptr && *trace != '\0') {
+      internal::tracer = new internal::trace_recorder(trace);
+    }
     internal::pool = new internal::thread_pool;
     internal::top_task = this;
+    auto flag = getenv("TASK_METRICS");
+    const bool is_publishing =
+        flag != nullptr && *flag != '\0' && strcmp(flag, "0") != 0;
+    // exporters that report on all tasks and channels of the run; metrics
+    // only need the live ones
+    internal::topology->set_recording(
+        getenv("TASK_TOPOLOGY") != nullptr ||
+        internal::perf_events != internal::perf_source::none ||
+        internal::tracer != nullptr);
+    if (is_publishing) {
+      auto interval = getenv("TASK_METRICS_INTERVAL_MS");
+      internal::publisher = new internal::metrics_publisher(
+          interval == nullptr ? 100 : std::max(1, atoi(interval)));
+    }
   }
+  this->region_ = internal::topology->create_region(internal::current_task);
 }
 
 parallel::~parallel() {
   if (this == internal::top_task) {
     internal::pool->wait();
+    if (auto filename = getenv("TASK_TOPOLOGY")) {
+      internal::topology->write_topology(filename);
+    }
+    if (internal::perf_events != internal::perf_source::none) {
+      internal::topology->log_perf_counts();
+    }
     unique_lock lock(internal::mtx);
+    delete internal::publisher;
+    internal::publisher = nullptr;
     delete internal::pool;
     internal::pool = nullptr;
+    if (internal::tracer != nullptr) {
+      internal::tracer->finish(getenv("TASK_TRACE"));
+      delete internal::tracer;
+      internal::tracer = nullptr;
+    }
+    internal::perf_events = internal::perf_source::none;
+    internal::topology->clear();
   }
 }
 
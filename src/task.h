@@ -1,11 +1,15 @@
 #ifndef LIBTASK_H_
 #define LIBTASK_H_
 
+#include "task/async_file.h"
+#include "task/buffer.h"
+#include "task/mapped_file.h"
 #include "task/mmap.h"
 #include "task/parallel.h"
 #include "task/stream.h"
 #include "task/traits.h"
 #include "task/util.h"
 #include "task/vec.h"
+#include "task/write_combiner.h"
 
 #endif // LIBTASK_H_
@@ -0,0 +1,471 @@
+#ifndef TASK_ASYNC_FILE_H_
+#define TASK_ASYNC_FILE_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include <glog/logging.h>
+
+#include "task/mmap.h"
+#include "task/stream.h"
+
+namespace task {
+
+namespace internal {
+
+// Opened file accessed by an async_file. Reads bypass the page cache via
+// O_DIRECT if the file system supports it; writes always go through the page
+// cache, which the kernel flushes before a direct read of the same range.
+class file_handle {
+public:
+  file_handle(const std::string &path, bool is_writable);
+  file_handle(const file_handle &) = delete;
+  file_handle &operator=(const file_handle &) = delete;
+  ~file_handle();
+
+  const std::string &get_path() const { return this->path; }
+  int get_fd() const { return this->fd; }
+  int get_read_fd() const { return this->direct_fd < 0 ? fd : direct_fd; }
+  uint64_t get_size() const { return this->size; } // in bytes
+
+  // Alignment of the offset, size, and buffer of each read.
+  uint64_t get_alignment() const { return this->direct_fd < 0 ? 1 : 4096; }
+
+private:
+  const std::string path;
+  int fd = -1;
+  int direct_fd = -1; // -1 if O_DIRECT is unsupported
+  uint64_t size = 0;
+};
+
+// I/O request of a file; `result` is valid once `is_done`.
+struct file_request {
+  int fd;
+  bool is_write;
+  uint64_t offset;
+  uint64_t size;
+  void *buffer;
+  int64_t result; // bytes transferred, or -errno
+  std::atomic<bool> is_done;
+};
+
+// Performs file I/O requests asynchronously, via io_uring if available, or a
+// pool of threads calling pread/pwrite otherwise or if environment variable
+// TASK_ASYNC_FILE_PREAD is set.
+class file_io {
+public:
+  static std::unique_ptr<file_io> create(uint32_t depth);
+  virtual ~file_io() = default;
+
+  // Submits `request`, which must outlive its completion. At most `depth`
+  // requests may be in flight.
+  virtual void submit(file_request *request) = 0;
+
+  // Marks completed requests as done; returns whether any is.
+  virtual bool poll() = 0;
+};
+
+} // namespace internal
+
+template <typename T> class async_file;
+
+/// Defines a file of consecutive elements, which tasks access asynchronously as
+/// a @c task::async_file.
+///
+/// This should be used on the host only. Unlike @c task::mmap, the file is
+/// never mapped into memory, so it may be larger than the host memory.
+template <typename T> class file {
+public:
+  /// Opens the file at @c path.
+  ///
+  /// The file size must be a multiple of @c sizeof(T).
+  ///
+  /// @param path        Path to the file.
+  /// @param is_writable Whether the file is opened for writes as well.
+  explicit file(const std::string &path, bool is_writable = false)
+      : handle_(std::make_shared<internal::file_handle>(path, is_writable)) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    CHECK_EQ(handle_->get_size() % sizeof(T), 0)
+        << "size of '" << path << "' must be a multiple of " << sizeof(T);
+  }
+
+  /// Retrieves the size of the file.
+  ///
+  /// @return The size of the file (in unit of element count).
+  uint64_t size() const { return handle_->get_size() / sizeof(T); }
+
+protected:
+  std::shared_ptr<internal::file_handle> handle_;
+};
+
+/// Defines a view of a file with asynchronous random accesses.
+///
+/// @c task::async_file has the same channels as @c task::async_mmap, so a task
+/// written for one works with the other. Requests are served by a detached task
+/// that keeps up to 64 I/O requests in flight and finishes once the task using
+/// the @c task::async_file finishes. Runs of consecutive addresses are read or
+/// written as one I/O request of at most 256 KiB.
+template <typename T> class async_file : public file<T> {
+public:
+  /// Type of the addresses.
+  using addr_t = int64_t;
+
+  /// Type of the write responses.
+  using resp_t = uint8_t;
+
+private:
+  using super = file<T>;
+
+  internal::dynamic_stream<addr_t> read_addr_q_{get_depth(), "read_addr"};
+  internal::dynamic_stream<T> read_data_q_{get_depth(), "read_data"};
+  internal::dynamic_stream<addr_t> write_addr_q_{get_depth(), "write_addr"};
+  internal::dynamic_stream<T> write_data_q_{get_depth(), "write_data"};
+  internal::dynamic_stream<resp_t> write_resp_q_{get_depth(), "write_resp"};
+
+  // shared by copies of the same async_file held by the user but not the
+  // service; destructed before the channels
+  std::shared_ptr<char> owner_;
+
+  // Only convert when scheduled.
+  async_file(const super &f)
+      : super(f), owner_(std::make_shared<char>()), read_addr(read_addr_q_),
+        read_data(read_data_q_), write_addr(write_addr_q_),
+        write_data(write_data_q_), write_resp(write_resp_q_) {}
+
+public:
+  /// Provides access to the read address channel.
+  ///
+  /// Each value written to this channel triggers an asynchronous file read
+  /// request. Consecutive requests may be coalesced into a long I/O request.
+  task::ostream<addr_t> read_addr;
+
+  /// Provides access to the read data channel.
+  ///
+  /// Each value read from this channel represents the data retrieved from the
+  /// file, in the order of the read addresses.
+  task::istream<T> read_data;
+
+  /// Provides access to the write address channel.
+  ///
+  /// Each value written to this channel triggers an asynchronous file write
+  /// request. Consecutive requests may be coalesced into a long I/O request.
+  task::ostream<addr_t> write_addr;
+
+  /// Provides access to the write data channel.
+  ///
+  /// Each value written to this channel supplies data to the file write
+  /// request.
+  task::ostream<T> write_data;
+
+  /// Provides access to the write response channel.
+  ///
+  /// Each value read from this channel represents the data count acknowledged
+  /// by the file system minus 1, as in @c task::async_mmap.
+  task::istream<resp_t> write_resp;
+
+  static async_file schedule(super f) {
+    // a copy of async_f is stored in std::function<void()>; the service
+    // finishes once all copies held by the user are destructed
+    async_file async_f(f);
+    auto task = internal::create_task("async_file", detach);
+    async_f.bind(task, /*is_service=*/true);
+    async_file service_f = async_f;
+    service_f.owner_ = nullptr;
+    const std::weak_ptr<char> owner = async_f.owner_;
+    internal::schedule(task, [service_f, owner] {
+      service server(service_f);
+      while (!owner.expired()) {
+        if (!server.step()) {
+          server.yield();
+        }
+      }
+      server.drain();
+    });
+    return async_f;
+  }
+
+private:
+  template <typename Param> friend struct internal::observer;
+
+  // Serves requests of an async_file in a detached task.
+  class service {
+  public:
+    explicit service(const async_file &f)
+        : handle(f.handle_), io(internal::file_io::create(kMaxInFlight)),
+          read_addr_q(internal::get_typed_queue(f.read_addr_q_)),
+          read_data_q(internal::get_typed_queue(f.read_data_q_)),
+          write_addr_q(internal::get_typed_queue(f.write_addr_q_)),
+          write_data_q(internal::get_typed_queue(f.write_data_q_)),
+          write_resp_q(internal::get_typed_queue(f.write_resp_q_)) {}
+
+    // Submits I/O requests for the requests available and responds to the
+    // completed ones, in order.
+    //
+    // Returns whether any progress is made.
+    bool step() {
+      bool is_active = io->poll();
+
+      // read requests
+      while (reads.size() + writes.size() < kMaxInFlight) {
+        const uint64_t n = peek_burst(read_addr_q, read_addr_q.get_size());
+        if (n == 0) {
+          break;
+        }
+        reads.emplace_back(new burst(addr, n));
+        read_addr_q.pop_n(n, [](uint64_t, const internal::elem_t<addr_t> &) {});
+        submit_read(*reads.back());
+        is_active = true;
+      }
+
+      // read responses, in order
+      while (!reads.empty() && reads.front()->request.is_done) {
+        auto &front = *reads.front();
+        const uint64_t begin = front.addr * sizeof(T);
+        const uint64_t skip = begin - front.request.offset;
+        CHECK_GE(front.request.result, int64_t(skip + front.n * sizeof(T)))
+            << "cannot read '" << handle->get_path() << "' at " << begin
+            << ": " << strerror(-std::min<int64_t>(front.request.result, 0));
+        const char *src = static_cast<const char *>(front.buffer) + skip;
+        const uint64_t sent = front.sent;
+        front.sent += read_data_q.push_n(front.n - sent, [&](uint64_t i) {
+          internal::elem_t<T> elem{T(), false};
+          memcpy(&elem.val, src + (sent + i) * sizeof(T), sizeof(T));
+          return elem;
+        });
+        is_active |= front.sent > sent;
+        if (front.sent < front.n) {
+          break;
+        }
+        reads.pop_front();
+      }
+
+      // write requests, for which both the addresses and the data are
+      // available
+      while (reads.size() + writes.size() < kMaxInFlight) {
+        const uint64_t n = peek_burst(
+            write_addr_q,
+            std::min(write_addr_q.get_size(), write_data_q.get_size()));
+        if (n == 0) {
+          break;
+        }
+        writes.emplace_back(new burst(addr, n));
+        write_addr_q.pop_n(n,
+                           [](uint64_t, const internal::elem_t<addr_t> &) {});
+        submit_write(*writes.back());
+        is_active = true;
+      }
+
+      // write responses, in order; each acknowledges at most 256 writes
+      while (!writes.empty() && writes.front()->request.is_done) {
+        auto &front = *writes.front();
+        CHECK_EQ(front.request.result, int64_t(front.request.size))
+            << "cannot write '" << handle->get_path() << "' at "
+            << front.request.offset << ": "
+            << strerror(-std::min<int64_t>(front.request.result, 0));
+        const uint64_t n = std::min<uint64_t>(front.n - front.sent, 256);
+        if (write_resp_q.push_n(1, [n](uint64_t) {
+              return internal::elem_t<resp_t>{resp_t(n - 1), false};
+            }) == 0) {
+          break;
+        }
+        front.sent += n;
+        is_active = true;
+        if (front.sent == front.n) {
+          writes.pop_front();
+        }
+      }
+
+      // submits the new requests and looks for completions early
+      return io->poll() || is_active;
+    }
+
+    // Writes all pending writes without acknowledging them and waits for all
+    // I/O requests in flight, yielding to other tasks meanwhile.
+    void drain() {
+      for (;;) {
+        bool is_active = false;
+        while (reads.size() + writes.size() < kMaxInFlight) {
+          const uint64_t n = peek_burst(
+              write_addr_q,
+              std::min(write_addr_q.get_size(), write_data_q.get_size()));
+          if (n == 0) {
+            break;
+          }
+          writes.emplace_back(new burst(addr, n));
+          write_addr_q.pop_n(
+              n, [](uint64_t, const internal::elem_t<addr_t> &) {});
+          submit_write(*writes.back());
+          is_active = true;
+        }
+        is_active |= io->poll();
+        while (!reads.empty() && reads.front()->request.is_done) {
+          reads.pop_front();
+        }
+        while (!writes.empty() && writes.front()->request.is_done) {
+          writes.pop_front();
+        }
+        if (reads.empty() && writes.empty() &&
+            (write_addr_q.empty() || write_data_q.empty())) {
+          return;
+        }
+        if (!is_active) {
+          internal::yield(write_addr_q, /*is_full=*/false);
+        }
+      }
+    }
+
+    // Suspends the service until it may make progress.
+    void yield() const {
+      if (read_addr_q.empty()) {
+        internal::yield(read_addr_q, /*is_full=*/false);
+      } else {
+        internal::yield(read_data_q, /*is_full=*/true);
+      }
+    }
+
+  private:
+    static constexpr uint64_t kMaxInFlight = 64;
+    static constexpr uint64_t kMaxBurstBytes = 256 * 1024;
+
+    // run of consecutive addresses accessed by one I/O request
+    struct burst {
+      burst(addr_t addr, uint64_t n) : addr(addr), n(n) {}
+      burst(const burst &) = delete;
+      burst &operator=(const burst &) = delete;
+      ~burst() { free(buffer); }
+
+      const addr_t addr;
+      const uint64_t n;
+      uint64_t sent = 0; // elements responded
+      void *buffer = nullptr;
+      internal::file_request request;
+    };
+
+    const std::shared_ptr<internal::file_handle> handle;
+    const std::unique_ptr<internal::file_io> io;
+
+    internal::queue<internal::elem_t<addr_t>> &read_addr_q;
+    internal::queue<internal::elem_t<T>> &read_data_q;
+    internal::queue<internal::elem_t<addr_t>> &write_addr_q;
+    internal::queue<internal::elem_t<T>> &write_data_q;
+    internal::queue<internal::elem_t<resp_t>> &write_resp_q;
+
+    std::deque<std::unique_ptr<burst>> reads;  // in the order of requests
+    std::deque<std::unique_ptr<burst>> writes; // in the order of requests
+    addr_t addr = 0; // start of the burst last peeked
+
+    // Returns the length of the run of consecutive addresses at the front of
+    // the first `count` addresses of `q`, and sets `addr` to its start.
+    uint64_t peek_burst(const internal::queue<internal::elem_t<addr_t>> &q,
+                        uint64_t count) {
+      const uint64_t max_n = std::max<uint64_t>(kMaxBurstBytes / sizeof(T), 1);
+      uint64_t n = 0;
+      q.peek_n(std::min(count, max_n),
+               [&](uint64_t i, const internal::elem_t<addr_t> &elem) {
+                 if (elem.eot) {
+                   LOG(FATAL) << "channel '" << q.get_name()
+                              << "' read when closed";
+                 }
+                 if (i == 0) {
+                   addr = elem.val;
+                 }
+                 if (n == i && elem.val == addr + addr_t(i)) {
+                   n = i + 1;
+                 }
+               });
+      if (n > 0) {
+        const uint64_t size = handle->get_size() / sizeof(T);
+        CHECK_GE(addr, 0);
+        CHECK_LE(addr + n, size);
+      }
+      return n;
+    }
+
+    void submit_read(burst &b) {
+      const uint64_t alignment = handle->get_alignment();
+      const uint64_t begin = b.addr * sizeof(T) / alignment * alignment;
+      const uint64_t end =
+          ((b.addr + b.n) * sizeof(T) + alignment - 1) / alignment * alignment;
+      prepare(b, handle->get_read_fd(), /*is_write=*/false, begin,
+              end - begin);
+      io->submit(&b.request);
+    }
+
+    void submit_write(burst &b) {
+      prepare(b, handle->get_fd(), /*is_write=*/true, b.addr * sizeof(T),
+              b.n * sizeof(T));
+      char *dst = static_cast<char *>(b.buffer);
+      write_data_q.pop_n(b.n, [&](uint64_t i, const internal::elem_t<T> &e) {
+        if (e.eot) {
+          LOG(FATAL) << "channel '" << write_data_q.get_name()
+                     << "' read when closed";
+        }
+        memcpy(dst + i * sizeof(T), &e.val, sizeof(T));
+      });
+      io->submit(&b.request);
+    }
+
+    // Allocates the buffer of `b` and fills in its request.
+    void prepare(burst &b, int fd, bool is_write, uint64_t offset,
+                 uint64_t size) {
+      const uint64_t alignment = handle->get_alignment();
+      if (posix_memalign(&b.buffer, std::max<uint64_t>(alignment, 64),
+                         std::max<uint64_t>(size, 1)) != 0) {
+        LOG(FATAL) << "cannot allocate " << size << " bytes";
+      }
+      b.request.fd = fd;
+      b.request.is_write = is_write;
+      b.request.offset = offset;
+      b.request.size = size;
+      b.request.buffer = b.buffer;
+      b.request.result = 0;
+      b.request.is_done = false;
+    }
+  };
+
+  static uint64_t get_depth() { return internal::get_async_mmap_depth(); }
+
+  // Records channel endpoints of either the service or the user task.
+  void bind(internal::task_info *task, bool is_service) const {
+    internal::bind_channel(task, internal::get_queue(read_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(read_data_q_),
+                           is_service);
+    internal::bind_channel(task, internal::get_queue(write_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_data_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_resp_q_),
+                           is_service);
+  }
+};
+
+namespace internal {
+
+template <typename T> struct accessor<async_file<T>, file<T> &> {
+  static async_file<T> access(file<T> &arg) {
+    return async_file<T>::schedule(arg);
+  }
+};
+
+template <typename T> struct observer<async_file<T>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    arg.bind(task, /*is_service=*/false);
+    return std::forward<Arg>(arg);
+  }
+};
+
+} // namespace internal
+
+} // namespace task
+
+#endif // TASK_ASYNC_FILE_H_
@@ -0,0 +1,116 @@
+#ifndef TASK_BUFFER_H_
+#define TASK_BUFFER_H_
+
+#include <cstdint>
+
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace task {
+
+namespace internal {
+
+// Allocates `bytes` of zeroed memory aligned to and backed by 2 MiB huge pages
+// if possible, bound to NUMA `node` unless negative, and touched by the calling
+// thread so that it is placed before use. Logs the time taken.
+void *allocate_buffer(uint64_t bytes, int node);
+
+void free_buffer(void *ptr, uint64_t bytes);
+
+// Number of NUMA nodes of the host.
+int get_numa_node_count();
+
+} // namespace internal
+
+/// Defines host memory for a @c task::mmap, allocated in 2 MiB huge pages on a
+/// given NUMA node.
+///
+/// This should be used on the host only. The elements are zero-initialized.
+/// A @c task::buffer can be used wherever a container is accepted, e.g., to
+/// construct a @c task::mmap.
+template <typename T> class buffer {
+public:
+  /// Allocates a @c task::buffer of @c size elements.
+  ///
+  /// @param size Number of elements.
+  /// @param node NUMA node to place the memory on; any node if negative.
+  explicit buffer(uint64_t size, int node = -1)
+      : ptr_(static_cast<T *>(
+            internal::allocate_buffer(size * sizeof(T), node))),
+        size_(size) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+  }
+
+  buffer(const buffer &) = delete;
+  buffer &operator=(const buffer &) = delete;
+
+  buffer(buffer &&other) noexcept : ptr_(other.ptr_), size_(other.size_) {
+    other.ptr_ = nullptr;
+    other.size_ = 0;
+  }
+
+  ~buffer() {
+    if (ptr_ != nullptr) {
+      internal::free_buffer(ptr_, size_ * sizeof(T));
+    }
+  }
+
+  T *data() { return ptr_; }
+  const T *data() const { return ptr_; }
+  uint64_t size() const { return size_; }
+
+  T &operator[](uint64_t idx) { return ptr_[idx]; }
+  const T &operator[](uint64_t idx) const { return ptr_[idx]; }
+
+  T *begin() { return ptr_; }
+  T *end() { return ptr_ + size_; }
+  const T *begin() const { return ptr_; }
+  const T *end() const { return ptr_ + size_; }
+
+private:
+  T *ptr_;
+  uint64_t size_;
+};
+
+/// Defines an array of @c task::buffer, one for each memory bank of a
+/// @c task::mmaps.
+///
+/// This should be used on the host only.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  task::buffers<float, 4> banks(n);
+///  Kernel(task::mmaps<float, 4>(banks).vectorized<16>(), ...);
+/// @endcode
+template <typename T, uint64_t S> class buffers {
+public:
+  /// Allocates @c S buffers of @c size elements each.
+  ///
+  /// Bank @c i is placed on NUMA node <tt>nodes[i % nodes.size()]</tt>, or
+  /// node <tt>i % node_count</tt> if @c nodes is empty, so that the banks are
+  /// spread across the sockets by default.
+  ///
+  /// @param size  Number of elements of each bank.
+  /// @param nodes NUMA node of each bank.
+  explicit buffers(uint64_t size, const std::vector<int> &nodes = {}) {
+    const int node_count = internal::get_numa_node_count();
+    for (uint64_t i = 0; i < S; ++i) {
+      buffers_.emplace_back(size, nodes.empty() ? int(i % node_count)
+                                                : nodes[i % nodes.size()]);
+    }
+  }
+
+  /// References a @c task::buffer in the array.
+  buffer<T> &operator[](int idx) { return buffers_[idx]; }
+  const buffer<T> &operator[](int idx) const { return buffers_[idx]; }
+
+private:
+  std::vector<buffer<T>> buffers_;
+};
+
+} // namespace task
+
+#endif // TASK_BUFFER_H_
@@ -0,0 +1,156 @@
+#ifndef TASK_MAPPED_FILE_H_
+#define TASK_MAPPED_FILE_H_
+
+#include <cstdint>
+
+#include <array>
+#include <string>
+#include <type_traits>
+
+#include <glog/logging.h>
+
+#include "task/mmap.h"
+
+namespace task {
+
+/// Flags of how a @c task::mapped_file is mapped; may be combined with @c |.
+enum class map_flag : uint32_t {
+  /// Maps the file read-only; the element type must be @c const.
+  read_only = 0,
+
+  /// Maps the file copy-on-write; writes are private and never reach the file.
+  copy_on_write = 1 << 0,
+
+  /// Reads the whole file ahead (@c MAP_POPULATE) instead of on page faults.
+  populate = 1 << 1,
+
+  /// Hints that the file is accessed sequentially (@c MADV_SEQUENTIAL).
+  sequential = 1 << 2,
+
+  /// Hints that the file is accessed randomly (@c MADV_RANDOM).
+  random = 1 << 3,
+
+  /// Backs the mapping with transparent huge pages if the file system supports
+  /// them (@c MADV_HUGEPAGE).
+  huge_page = 1 << 4,
+};
+
+/// Combines @c task::map_flag values.
+constexpr map_flag operator|(map_flag lhs, map_flag rhs) {
+  return static_cast<map_flag>(static_cast<uint32_t>(lhs) |
+                               static_cast<uint32_t>(rhs));
+}
+
+/// Retrieves the @c task::map_flag values set in both @c lhs and @c rhs.
+constexpr map_flag operator&(map_flag lhs, map_flag rhs) {
+  return static_cast<map_flag>(static_cast<uint32_t>(lhs) &
+                               static_cast<uint32_t>(rhs));
+}
+
+namespace internal {
+
+// Returns whether `flag` is set in `flags`.
+constexpr bool has_flag(map_flag flags, map_flag flag) {
+  return static_cast<uint32_t>(flags & flag) != 0;
+}
+
+// Maps the file at `path` privately with `flags` and returns the start of the
+// mapping, or nullptr if the file is empty; sets `bytes` to the file size.
+void *map_file(const std::string &path, map_flag flags, uint64_t &bytes);
+
+void unmap_file(void *ptr, uint64_t bytes);
+
+} // namespace internal
+
+/// Defines the owner of a file mapped into memory, so that the file can be
+/// accessed as a @c task::mmap without being copied.
+///
+/// This should be used on the host only. The mapping is removed when the
+/// @c task::mapped_file is destructed, which must not happen before the tasks
+/// using it finish.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  task::mapped_file<const float> input("input.bin",
+///                                      task::map_flag::sequential);
+///  Kernel(input.get_mmap(), ...);
+/// @endcode
+template <typename T> class mapped_file {
+public:
+  /// Maps the file at @c path.
+  ///
+  /// The file size must be a multiple of @c sizeof(T).
+  ///
+  /// @param path  Path to the file.
+  /// @param flags @c task::map_flag values combined with @c |.
+  explicit mapped_file(const std::string &path,
+                       map_flag flags = map_flag::read_only) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    CHECK(std::is_const<T>::value ||
+          internal::has_flag(flags, map_flag::copy_on_write))
+        << "'" << path << "' must be mapped copy_on_write unless T is const";
+
+    ptr_ = static_cast<T *>(internal::map_file(path, flags, bytes_));
+    CHECK_EQ(bytes_ % sizeof(T), 0)
+        << "size of '" << path << "' must be a multiple of " << sizeof(T);
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  mapped_file(mapped_file &&other) noexcept
+      : ptr_(other.ptr_), bytes_(other.bytes_) {
+    other.ptr_ = nullptr;
+    other.bytes_ = 0;
+  }
+
+  ~mapped_file() {
+    if (ptr_ != nullptr) {
+      internal::unmap_file(
+          const_cast<typename std::remove_const<T>::type *>(ptr_), bytes_);
+    }
+  }
+
+  /// Retrieves the start of the mapped file.
+  ///
+  /// @return The start of the mapped file, or @c nullptr if it is empty.
+  T *get() const { return ptr_; }
+
+  /// Retrieves the size of the mapped file.
+  ///
+  /// @return The size of the mapped file (in unit of element count).
+  uint64_t size() const { return bytes_ / sizeof(T); }
+
+  /// Views the whole mapped file as a @c task::mmap.
+  ///
+  /// @return @c task::mmap of the mapped file.
+  mmap<T> get_mmap() const { return mmap<T>(ptr_, size()); }
+
+  /// Splits the mapped file into @c S banks of consecutive elements.
+  ///
+  /// Each bank has <tt>size() / S</tt> elements, except that the last one also
+  /// gets the remainder.
+  ///
+  /// @tparam S  Number of banks.
+  /// @return    @c task::mmaps of the banks.
+  template <uint64_t S> mmaps<T, S> split() const {
+    static_assert(S > 0, "S must be positive");
+    std::array<T *, S> ptrs;
+    std::array<uint64_t, S> sizes;
+    const uint64_t bank_size = size() / S;
+    for (uint64_t i = 0; i < S; ++i) {
+      ptrs[i] = ptr_ + i * bank_size;
+      sizes[i] = i + 1 < S ? bank_size : size() - i * bank_size;
+    }
+    return mmaps<T, S>(ptrs, sizes);
+  }
+
+private:
+  T *ptr_ = nullptr;
+  uint64_t bytes_ = 0;
+};
+
+} // namespace task
+
+#endif // TASK_MAPPED_FILE_H_
@@ -0,0 +1,160 @@
+#ifndef TASK_MEMORY_MODEL_H_
+#define TASK_MEMORY_MODEL_H_
+
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+
+namespace task {
+
+/// Defines the timing of a memory channel accessed via @c task::async_mmap.
+///
+/// Without a model, @c task::async_mmap responds as fast as the host can copy
+/// the data. With a model, each response is delayed until the modeled memory
+/// would have completed the request, so that the throughput measured in
+/// software simulation approximates the hardware.
+struct memory_model {
+  /// Latency from issuing a request to receiving its response (in ns).
+  double latency_ns = 0.;
+
+  /// Peak bandwidth of the channel (in GB/s, i.e., bytes per ns). Unlimited if
+  /// not positive.
+  double bandwidth_gbps = 0.;
+
+  /// Maximum number of requests in flight; each element is a request.
+  uint64_t max_outstanding = 64;
+
+  /// Size of each burst transfer (in bytes); requests of consecutive addresses
+  /// within the same burst share the transfer.
+  uint64_t burst_size = 64;
+
+  /// Size of each row buffer (in bytes).
+  uint64_t row_size = 2048;
+
+  /// Extra latency of accessing the open row (in ns).
+  double row_hit_ns = 0.;
+
+  /// Extra latency of opening a different row (in ns).
+  double row_miss_ns = 0.;
+
+  /// Approximates a DDR4-2400 channel with 8 KiB rows.
+  static memory_model ddr4() {
+    memory_model model;
+    model.latency_ns = 100.;
+    model.bandwidth_gbps = 19.2;
+    model.max_outstanding = 64;
+    model.burst_size = 64;
+    model.row_size = 8192;
+    model.row_hit_ns = 14.;
+    model.row_miss_ns = 28.;
+    return model;
+  }
+
+  /// Approximates an HBM2 pseudo-channel with 1 KiB rows.
+  static memory_model hbm2() {
+    memory_model model;
+    model.latency_ns = 110.;
+    model.bandwidth_gbps = 14.4;
+    model.max_outstanding = 64;
+    model.burst_size = 32;
+    model.row_size = 1024;
+    model.row_hit_ns = 14.;
+    model.row_miss_ns = 28.;
+    return model;
+  }
+};
+
+namespace internal {
+
+// Tracks the modeled state of a memory channel and reports the achieved and
+// modeled bandwidth when destructed. Achieved bandwidth falls short of the
+// modeled one if the host cannot keep up with the model.
+class memory_timing {
+public:
+  memory_timing(const memory_model &model, const void *base)
+      : model(model), base(base) {
+    CHECK_GT(model.max_outstanding, 0);
+    CHECK_GT(model.burst_size, 0);
+    CHECK_GT(model.row_size, 0);
+  }
+  memory_timing(const memory_timing &) = delete;
+  memory_timing &operator=(const memory_timing &) = delete;
+
+  ~memory_timing() {
+    if (this->byte_count == 0) {
+      return;
+    }
+    const double achieved_ns = this->last_completion - this->first_request;
+    const double modeled_ns = this->last_ready - this->first_request;
+    LOG(INFO) << "memory at " << this->base << ": " << this->byte_count
+              << " bytes in " << achieved_ns / 1000 << " us, achieved "
+              << this->byte_count / std::max(achieved_ns, 1.)
+              << " GB/s, modeled "
+              << this->byte_count / std::max(modeled_ns, 1.)
+              << " GB/s, channel busy "
+              << 100. * this->busy_ns / std::max(modeled_ns, 1.) << "%";
+  }
+
+  uint64_t get_max_outstanding() const { return this->model.max_outstanding; }
+
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Returns the time at which a burst of `size` bytes from `offset`, requested
+  // at `now`, completes.
+  int64_t request(int64_t now, uint64_t offset, uint64_t size) {
+    if (this->first_request < 0) {
+      this->first_request = now;
+    }
+    double cost = 0.;
+    const uint64_t last = offset + size - 1;
+    for (uint64_t row = offset / this->model.row_size;
+         row <= last / this->model.row_size; ++row) {
+      cost += row == this->open_row ? this->model.row_hit_ns
+                                    : this->model.row_miss_ns;
+      this->open_row = row;
+    }
+    if (this->model.bandwidth_gbps > 0.) {
+      const uint64_t burst_count = last / this->model.burst_size -
+                                   offset / this->model.burst_size + 1;
+      cost += burst_count * this->model.burst_size / this->model.bandwidth_gbps;
+    }
+    this->busy_until = std::max<double>(this->busy_until, now) + cost;
+    this->busy_ns += cost;
+    const int64_t ready = this->busy_until + this->model.latency_ns;
+    this->last_ready = std::max(this->last_ready, ready);
+    return ready;
+  }
+
+  // Records that `size` bytes are delivered to the user at `now`.
+  void complete(int64_t now, uint64_t size) {
+    this->byte_count += size;
+    this->last_completion = now;
+  }
+
+private:
+  const memory_model model;
+  const void *const base;
+
+  uint64_t open_row = UINT64_MAX;
+  double busy_until = 0.; // when the channel finishes the accepted requests
+
+  // statistics
+  int64_t first_request = -1;
+  int64_t last_ready = 0;
+  int64_t last_completion = 0;
+  uint64_t byte_count = 0;
+  double busy_ns = 0.;
+};
+
+} // namespace internal
+
+} // namespace task
+
+#endif // TASK_MEMORY_MODEL_H_
@@ -0,0 +1,128 @@
+#ifndef TASK_METRICS_H_
+#define TASK_METRICS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace task {
+
+/// Layout of the shared-memory segment where the runtime publishes live
+/// per-task and per-channel counters.
+///
+/// The segment is created as <tt>/dev/shm/task.<pid></tt> if environment
+/// variable @c TASK_METRICS is set, and is refreshed every
+/// @c TASK_METRICS_INTERVAL_MS milliseconds (100 by default). Readers such as
+/// @c tasktop must map it read-only and use @c metrics::read to obtain a
+/// consistent copy.
+///
+/// Only unfinished tasks and channels still alive are published, each sorted
+/// by id; slots move between refreshes, so readers must match them by id.
+/// Finished tasks follow the unfinished ones only if the whole run is recorded
+/// for another exporter, e.g., @c TASK_TOPOLOGY, and there is room left.
+namespace metrics {
+
+constexpr uint64_t kMagic = 0x7274656d6b736174ULL; // "taskmetr" in memory
+constexpr uint32_t kVersion = 2;
+constexpr int kNameLength = 64;
+constexpr uint32_t kTaskCapacity = 16384;
+constexpr uint32_t kChannelCapacity = 65536;
+
+enum task_state : uint8_t {
+  kRunning = 0,      // running or ready to run
+  kBlockedEmpty = 1, // waiting for a token of an empty channel
+  kBlockedFull = 2,  // waiting for space of a full channel
+  kFinished = 3,
+};
+
+struct task_slot {
+  uint64_t id;            // unique among the tasks of the run
+  char name[kNameLength]; // function name and instance index
+  int32_t region;         // id of the parallel region
+  int32_t blocked_channel; // index into channels; -1 if unknown or none
+  uint8_t detached;
+  uint8_t state; // task_state
+  uint8_t reserved[6];
+  uint64_t resume_count;
+};
+
+struct channel_slot {
+  uint64_t id; // unique among the channels of the run
+  char name[kNameLength];
+  uint64_t depth;
+  uint64_t size; // occupancy
+  uint64_t token_count;
+};
+
+struct header {
+  uint64_t magic;
+  uint32_t version;
+  int32_t pid;
+  // seqlock; odd while the publisher is updating the segment
+  std::atomic<uint64_t> sequence;
+  uint64_t timestamp_ns; // CLOCK_MONOTONIC
+  uint32_t task_count;
+  uint32_t channel_count;
+};
+
+inline std::string segment_name(int pid) {
+  return "/task." + std::to_string(pid);
+}
+
+inline size_t segment_size() {
+  return sizeof(header) + sizeof(task_slot) * kTaskCapacity +
+         sizeof(channel_slot) * kChannelCapacity;
+}
+
+inline task_slot *tasks(header *segment) {
+  return reinterpret_cast<task_slot *>(segment + 1);
+}
+
+inline channel_slot *channels(header *segment) {
+  return reinterpret_cast<channel_slot *>(tasks(segment) + kTaskCapacity);
+}
+
+inline const task_slot *tasks(const header *segment) {
+  return reinterpret_cast<const task_slot *>(segment + 1);
+}
+
+inline const channel_slot *channels(const header *segment) {
+  return reinterpret_cast<const channel_slot *>(tasks(segment) +
+                                                kTaskCapacity);
+}
+
+/// Copies a consistent snapshot of @c segment into @c snapshot, which must
+/// have room for @c segment_size() bytes.
+///
+/// @return Whether the copy is consistent; retry if not.
+inline bool read(const header *segment, header *snapshot) {
+  const uint64_t sequence = segment->sequence.load(std::memory_order_acquire);
+  if (sequence % 2 != 0) {
+    return false;
+  }
+  snapshot->magic = segment->magic;
+  snapshot->version = segment->version;
+  snapshot->pid = segment->pid;
+  snapshot->timestamp_ns = segment->timestamp_ns;
+  snapshot->task_count = segment->task_count;
+  snapshot->channel_count = segment->channel_count;
+  if (snapshot->task_count > kTaskCapacity ||
+      snapshot->channel_count > kChannelCapacity) {
+    return false;
+  }
+  std::copy(tasks(segment), tasks(segment) + snapshot->task_count,
+            tasks(snapshot));
+  std::copy(channels(segment), channels(segment) + snapshot->channel_count,
+            channels(snapshot));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return segment->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+} // namespace metrics
+
+} // namespace task
+
+#endif // TASK_METRICS_H_
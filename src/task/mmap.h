@@ -2,11 +2,22 @@
 #define TASK_MMAP_H_
 
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include <type_traits>
 #include <vector>
 
+#include "task/memory_model.h"
 #include "task/stream.h"
+#include "task/trace.h"
 #include "task/vec.h"
 
 namespace task {
@@ -15,9 +26,72 @@ namespace internal {
 
 template <typename Param, typename Arg> struct accessor;
 
+// Depth of each request channel of an async_mmap; set by environment variable
+// TASK_ASYNC_MMAP_DEPTH (64 by default).
+inline uint64_t get_async_mmap_depth() {
+  static const uint64_t depth = [] {
+    auto depth = getenv("TASK_ASYNC_MMAP_DEPTH");
+    return depth == nullptr ? 64 : std::max(1LL, atoll(depth));
+  }();
+  return depth;
+}
+
+// Chooses how many read addresses an async_mmap prefetches ahead of the one it
+// serves. The distance is fixed by environment variable
+// TASK_ASYNC_MMAP_PREFETCH (0 disables prefetching), or tuned by hill climbing
+// on the observed time between reads otherwise. Tuning never stops so that it
+// follows changes of the access pattern.
+class prefetch_tuner {
+public:
+  uint64_t get_distance() const { return this->distance; }
+
+  bool is_tuning() const { return get_fixed_distance() < 0; }
+
+  // Records that `n` reads are served by `now` (in ns).
+  void record(uint64_t n, int64_t now) {
+    constexpr uint64_t kEpochSize = 4096; // reads per measurement
+    constexpr uint64_t kMaxDistance = 64;
+    if (this->epoch_start < 0) {
+      this->epoch_start = now;
+      return;
+    }
+    this->read_count += n;
+    if (this->read_count < kEpochSize) {
+      return;
+    }
+    const double cost = double(now - this->epoch_start) / this->read_count;
+    if (cost > this->last_cost) {
+      this->is_growing = !this->is_growing; // worse than before; turn around
+    }
+    this->last_cost = cost;
+    this->distance = this->is_growing
+                         ? std::min(this->distance * 2, kMaxDistance)
+                         : std::max<uint64_t>(this->distance / 2, 1);
+    this->read_count = 0;
+    this->epoch_start = now;
+  }
+
+private:
+  uint64_t distance = get_fixed_distance() < 0 ? 8 : get_fixed_distance();
+  bool is_growing = true;
+  double last_cost = 1e300;
+  uint64_t read_count = 0;
+  int64_t epoch_start = -1;
+
+  static int64_t get_fixed_distance() {
+    static const int64_t distance = [] {
+      auto distance = getenv("TASK_ASYNC_MMAP_PREFETCH");
+      return distance == nullptr ? -1LL : std::max(0LL, atoll(distance));
+    }();
+    return distance;
+  }
+};
+
 } // namespace internal
 
 template <typename T> class async_mmap;
+template <typename T> class tagged_async_mmap;
+template <typename T, uint64_t N> class mmap_view;
 
 /// Defines a view of a piece of consecutive memory with synchronous random
 /// accesses.
@@ -47,6 +121,17 @@ public:
   /// @c task::mmap should be used just like a pointer in the kernel.
   operator T *() { return ptr_; }
 
+#ifdef TASK_TRACE_MMAP
+  /// Accesses an element and records it in the memory access trace.
+  ///
+  /// Only defined if compiled with @c TASK_TRACE_MMAP; the access is recorded
+  /// if environment variable @c TASK_TRACE is set.
+  T &operator[](std::ptrdiff_t idx) const {
+    internal::trace_access(ptr_, idx * sizeof(T), sizeof(T), trace::kAccess);
+    return ptr_[idx];
+  }
+#endif // TASK_TRACE_MMAP
+
   /// Increments the start of the mapped memory.
   ///
   /// @return The incremented @c task::mmap.
@@ -87,6 +172,22 @@ public:
   /// @return The size of the mapped memory (in unit of element count).
   uint64_t size() const { return size_; }
 
+  /// Sets the timing model of the mapped memory when accessed asynchronously.
+  ///
+  /// This should be used on the host only.
+  ///
+  /// @param model Timing model of the underlying memory channel.
+  /// @return      This @c task::mmap.
+  mmap &set_memory_model(const memory_model &model) {
+    model_ = std::make_shared<memory_model>(model);
+    return *this;
+  }
+
+  /// Retrieves the timing model of the mapped memory.
+  ///
+  /// @return The timing model, or @c nullptr if none is set.
+  const memory_model *get_memory_model() const { return model_.get(); }
+
   /// Reinterprets the element type of the mapped memory as
   /// <tt>task::vec_t<T, N></tt>.
   ///
@@ -97,8 +198,12 @@ public:
   /// @return @c task::mmap of the same piece of memory but of type
   ///         <tt>task::vec_t<T, N></tt>.
   template <uint64_t N> mmap<vec_t<T, N>> vectorized() const {
+    static_assert(sizeof(vec_t<T, N>) == sizeof(T) * N,
+                  "vec_t<T, N> is packed and cannot alias T");
     CHECK_EQ(size_ % N, 0) << "size must be a multiple of N";
-    return mmap<vec_t<T, N>>(reinterpret_cast<vec_t<T, N> *>(ptr_), size_ / N);
+    mmap<vec_t<T, N>> result(reinterpret_cast<vec_t<T, N> *>(ptr_), size_ / N);
+    result.model_ = model_;
+    return result;
   }
 
   /// Reinterprets the element type of the mapped memory as @c U.
@@ -122,17 +227,302 @@ public:
     }
     CHECK_EQ(reinterpret_cast<size_t>(get()) % alignof(U), 0)
         << "pointer must be " << alignof(U) << "-byte aligned";
-    return mmap<U>(reinterpret_cast<U *>(get()),
+    mmap<U> result(reinterpret_cast<U *>(get()),
                    size() * sizeof(T) / sizeof(U));
+    result.model_ = model_;
+    return result;
   }
 
+  /// Views the mapped memory as a row-major multi-dimensional array.
+  ///
+  /// The product of @c dims must not exceed the size of the mapped memory,
+  /// unless the size is unknown.
+  ///
+  /// @param dims Size of each dimension, from the outermost to the innermost.
+  /// @return     @c task::mmap_view of the same piece of memory.
+  template <typename... Dims>
+  mmap_view<T, sizeof...(Dims)> reshape(Dims... dims) const;
+
+  /// Views a tile of the mapped memory as a row-major matrix.
+  ///
+  /// Equivalent to <tt>reshape(size() / cols, cols).tile<Rows, Cols>(i, j)
+  /// </tt>; the size of the mapped memory must be a multiple of @c cols.
+  ///
+  /// @tparam Rows Number of rows of the tile.
+  /// @tparam Cols Number of columns of the tile.
+  /// @param i     Row index of the tile (in unit of tiles).
+  /// @param j     Column index of the tile (in unit of tiles).
+  /// @param cols  Number of columns of the whole matrix.
+  /// @return      @c task::mmap_view of the tile.
+  template <uint64_t Rows, uint64_t Cols>
+  mmap_view<T, 2> tile(uint64_t i, uint64_t j, uint64_t cols) const;
+
 protected:
+  template <typename U> friend class mmap;
+
   T *ptr_;
   uint64_t size_;
+  std::shared_ptr<const memory_model> model_; // nullptr if not modeled
 };
 
+/// Defines a multi-dimensional view of a piece of memory with a shape and
+/// strides, e.g., a matrix or a tile of it.
+///
+/// A @c task::mmap_view is obtained via @c task::mmap::reshape and can be
+/// passed to tasks like a @c task::mmap. Elements are accessed in place, so
+/// a tile of a row-major matrix need not be reshaped on the host; each row of
+/// the innermost dimension is consecutive if its stride is 1, and can be
+/// transferred in bulk.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  void Kernel(task::mmap_view<const float, 2> matrix, ...) {
+///    auto tile = matrix.tile<32, 32>(i, j);
+///    for (uint64_t row = 0; row < tile.shape(0); ++row) {
+///      task::mmap<const float> elems = tile.row(row);
+///      ...
+///    }
+///  }
+///  Kernel(task::mmap<const float>(vec).reshape(n, n), ...);
+/// @endcode
+///
+/// @tparam T Type of each element.
+/// @tparam N Number of dimensions.
+template <typename T, uint64_t N> class mmap_view {
+  static_assert(N > 0, "N must be positive");
+
+public:
+  /// Constructs a @c task::mmap_view with the given @c shape and @c strides.
+  ///
+  /// @param ptr     Pointer to the first element.
+  /// @param shape   Size of each dimension, from the outermost to the
+  ///                innermost.
+  /// @param strides Distance between consecutive indices of each dimension
+  ///                (in unit of element count).
+  mmap_view(T *ptr, const std::array<uint64_t, N> &shape,
+            const std::array<uint64_t, N> &strides)
+      : ptr_(ptr), shape_(shape), strides_(strides) {}
+
+  /// Retrieves the first element.
+  T *get() const { return ptr_; }
+
+  /// Retrieves the size of dimension @c dim.
+  uint64_t shape(uint64_t dim) const { return shape_[dim]; }
+
+  /// Retrieves the stride of dimension @c dim (in unit of element count).
+  uint64_t stride(uint64_t dim) const { return strides_[dim]; }
+
+  /// Retrieves the number of elements in the view.
+  uint64_t size() const {
+    uint64_t result = 1;
+    for (auto dim : shape_) {
+      result *= dim;
+    }
+    return result;
+  }
+
+  /// Whether the elements are consecutive in row-major order.
+  bool is_contiguous() const {
+    uint64_t stride = 1;
+    for (uint64_t dim = N; dim-- > 0;) {
+      if (shape_[dim] > 1 && strides_[dim] != stride) {
+        return false;
+      }
+      stride *= shape_[dim];
+    }
+    return true;
+  }
+
+  /// References the element at the given indices.
+  ///
+  /// @param idx Index of each dimension, from the outermost to the innermost.
+  template <typename... Indices> T &operator()(Indices... idx) const {
+    static_assert(sizeof...(Indices) == N, "an index is needed per dimension");
+    return ptr_[get_offset({uint64_t(idx)...})];
+  }
+
+  /// Views one row of the innermost dimension as a @c task::mmap.
+  ///
+  /// The stride of the innermost dimension must be 1.
+  ///
+  /// @param idx Index of each dimension except the innermost one.
+  /// @return    @c task::mmap of the consecutive elements of the row.
+  template <typename... Indices> mmap<T> row(Indices... idx) const {
+    static_assert(sizeof...(Indices) + 1 == N,
+                  "an index is needed per dimension except the innermost one");
+    CHECK_EQ(strides_[N - 1], 1) << "row must be consecutive";
+    return mmap<T>(ptr_ + get_offset({uint64_t(idx)..., 0}), shape_[N - 1]);
+  }
+
+  /// Views a tile of the given shape.
+  ///
+  /// The tiles partition the view; tile @c idx starts at element
+  /// <tt>idx * Shape</tt> of each dimension and must be within the view.
+  ///
+  /// @tparam Shape Size of each dimension of the tile.
+  /// @param  idx   Index of the tile of each dimension (in unit of tiles).
+  /// @return       @c task::mmap_view of the tile, with the same strides.
+  template <uint64_t... Shape, typename... Indices>
+  mmap_view tile(Indices... idx) const {
+    static_assert(sizeof...(Shape) == N, "a size is needed per dimension");
+    static_assert(sizeof...(Indices) == N, "an index is needed per dimension");
+    const std::array<uint64_t, N> shape = {Shape...};
+    const std::array<uint64_t, N> indices = {uint64_t(idx)...};
+    std::array<uint64_t, N> first;
+    for (uint64_t dim = 0; dim < N; ++dim) {
+      first[dim] = indices[dim] * shape[dim];
+      CHECK_LE(first[dim] + shape[dim], shape_[dim])
+          << "tile is out of bound in dimension " << dim;
+    }
+    return mmap_view(ptr_ + get_offset(first), shape, strides_);
+  }
+
+  /// Copies all elements to @c dst in row-major order, one row at a time.
+  ///
+  /// @param dst Destination of <tt>size()</tt> elements.
+  void copy_to(typename std::remove_const<T>::type *dst) const {
+    for_each_row([&dst](const T *row, uint64_t n) {
+      std::copy(row, row + n, dst);
+      dst += n;
+    });
+  }
+
+  /// Copies all elements from @c src in row-major order, one row at a time.
+  ///
+  /// @param src Source of <tt>size()</tt> elements.
+  void copy_from(const T *src) const {
+    static_assert(!std::is_const<T>::value, "T must not be const");
+    for_each_row([&src](T *row, uint64_t n) {
+      std::copy(src, src + n, row);
+      src += n;
+    });
+  }
+
+private:
+  T *ptr_;
+  std::array<uint64_t, N> shape_;
+  std::array<uint64_t, N> strides_;
+
+  uint64_t get_offset(const std::array<uint64_t, N> &idx) const {
+    uint64_t offset = 0;
+    for (uint64_t dim = 0; dim < N; ++dim) {
+      offset += idx[dim] * strides_[dim];
+    }
+    return offset;
+  }
+
+  // Calls func(row, n) for each row of the innermost dimension in row-major
+  // order, where n is the row length and row is its first element. Rows are
+  // split into elements unless the innermost stride is 1.
+  template <typename Func> void for_each_row(Func &&func) const {
+    if (size() == 0) {
+      return;
+    }
+    const bool is_consecutive = strides_[N - 1] == 1;
+    std::array<uint64_t, N> idx = {};
+    for (;;) {
+      T *row = ptr_ + get_offset(idx);
+      if (is_consecutive) {
+        func(row, shape_[N - 1]);
+      } else {
+        for (uint64_t i = 0; i < shape_[N - 1]; ++i) {
+          func(row + i * strides_[N - 1], 1);
+        }
+      }
+      // increments the indices of the outer dimensions
+      uint64_t dim = N - 1;
+      while (dim > 0 && ++idx[dim - 1] == shape_[dim - 1]) {
+        idx[dim - 1] = 0;
+        --dim;
+      }
+      if (dim == 0) {
+        return;
+      }
+    }
+  }
+};
+
+template <typename T>
+template <typename... Dims>
+mmap_view<T, sizeof...(Dims)> mmap<T>::reshape(Dims... dims) const {
+  constexpr uint64_t N = sizeof...(Dims);
+  const std::array<uint64_t, N> shape = {uint64_t(dims)...};
+  std::array<uint64_t, N> strides;
+  uint64_t stride = 1;
+  for (uint64_t dim = N; dim-- > 0;) {
+    strides[dim] = stride;
+    stride *= shape[dim];
+  }
+  CHECK(size_ == 0 || stride <= size_)
+      << "shape has " << stride << " elements but the mapped memory has only "
+      << size_;
+  return mmap_view<T, N>(ptr_, shape, strides);
+}
+
+template <typename T>
+template <uint64_t Rows, uint64_t Cols>
+mmap_view<T, 2> mmap<T>::tile(uint64_t i, uint64_t j, uint64_t cols) const {
+  CHECK_EQ(size_ % cols, 0) << "size must be a multiple of cols";
+  return reshape(size_ / cols, cols).template tile<Rows, Cols>(i, j);
+}
+
+/// Reads elements of a @c task::mmap at the given indices.
+///
+/// @param mem Memory to read from.
+/// @param idx Index of each lane (in unit of element count).
+/// @return    <tt>{mem[idx[0]], mem[idx[1]], ...}</tt>.
+template <typename T, typename I, int N>
+inline vec_t<typename std::remove_const<T>::type, N>
+gather(mmap<T> mem, const vec_t<I, N> &idx) {
+  vec_t<typename std::remove_const<T>::type, N> result;
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    result.set(i, mem[idx[i]]);
+  }
+  return result;
+}
+
+/// Writes elements of a @c task::mmap at the given indices.
+///
+/// Lanes are written in order, so the last one wins if indices repeat.
+///
+/// @param mem Memory to write to.
+/// @param idx Index of each lane (in unit of element count).
+/// @param vec Value of each lane.
+template <typename T, typename I, int N>
+inline void scatter(mmap<T> mem, const vec_t<I, N> &idx,
+                    const vec_t<T, N> &vec) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    mem[idx[i]] = vec[i];
+  }
+}
+
+/// Writes elements of a @c task::mmap at the given indices for lanes whose
+/// @c mask is true.
+template <typename T, typename I, int N>
+inline void scatter(mmap<T> mem, const vec_t<I, N> &idx, const vec_t<T, N> &vec,
+                    const vec_t<bool, N> &mask) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    if (mask[i]) {
+      mem[idx[i]] = vec[i];
+    }
+  }
+}
+
 /// Defines a view of a piece of consecutive memory with asynchronous random
 /// accesses.
+///
+/// Requests are served by a detached task that finishes once the task using the
+/// @c task::async_mmap finishes. If environment variable
+/// @c TASK_ASYNC_MMAP_INLINE is set, requests are instead served in the task
+/// using the @c task::async_mmap whenever it finds one of the channels empty or
+/// full, which saves scheduling the service and crossing threads.
+///
+/// The service prefetches the data of read addresses ahead of the one it
+/// serves. The distance is tuned at runtime unless fixed by environment
+/// variable @c TASK_ASYNC_MMAP_PREFETCH; 0 disables prefetching.
 template <typename T> class async_mmap : public mmap<T> {
 public:
   /// Type of the addresses.
@@ -144,17 +534,29 @@ public:
 private:
   using super = mmap<T>;
 
-  task::stream<addr_t, 64> read_addr_q_{"read_addr"};
-  task::stream<T, 64> read_data_q_{"read_data"};
-  task::stream<addr_t, 64> write_addr_q_{"write_addr"};
-  task::stream<T, 64> write_data_q_{"write_data"};
-  task::stream<resp_t, 64> write_resp_q_{"write_resp"};
+  internal::dynamic_stream<addr_t> read_addr_q_{get_depth(), "read_addr"};
+  internal::dynamic_stream<T> read_data_q_{get_depth(), "read_data"};
+  internal::dynamic_stream<addr_t> write_addr_q_{get_depth(), "write_addr"};
+  internal::dynamic_stream<T> write_data_q_{get_depth(), "write_data"};
+  internal::dynamic_stream<resp_t> write_resp_q_{get_depth(), "write_resp"};
+
+  // shared by copies of the same async_mmap; nullptr if not modeled
+  std::shared_ptr<internal::memory_timing> timing_;
+
+  // shared by copies of the same async_mmap held by the user but not the
+  // service; destructed before the channels
+  std::shared_ptr<char> owner_;
 
   // Only convert when scheduled.
   async_mmap(const super &mem)
-      : super(mem), read_addr(read_addr_q_), read_data(read_data_q_),
-        write_addr(write_addr_q_), write_data(write_data_q_),
-        write_resp(write_resp_q_) {}
+      : super(mem),
+        timing_(mem.get_memory_model() == nullptr
+                    ? nullptr
+                    : std::make_shared<internal::memory_timing>(
+                          *mem.get_memory_model(), mem.get())),
+        owner_(std::make_shared<char>()), read_addr(read_addr_q_),
+        read_data(read_data_q_), write_addr(write_addr_q_),
+        write_data(write_data_q_), write_resp(write_resp_q_) {}
 
   // Must be operated via the read/write addr/data stream APIs.
   operator T *() { return super::ptr_; }
@@ -207,42 +609,700 @@ public:
   /// by the underlying memory system.
   task::istream<resp_t> write_resp;
 
-  void operator()() {
-    int16_t write_count = 0;
-    for (;;) {
-      if (!read_addr_q_.empty() && !read_data_q_.full()) {
-        const auto addr = read_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
+  static async_mmap schedule(super mem) {
+    async_mmap async_mem(mem);
+    if (is_inline()) {
+      // serve in the user task whenever it finds a channel empty or full
+      auto server = std::make_shared<service>(async_mem);
+      const std::function<bool()> pump = [server] { return server->step(); };
+      for (auto queue : {internal::get_queue(async_mem.read_addr_q_),
+                         internal::get_queue(async_mem.read_data_q_),
+                         internal::get_queue(async_mem.write_addr_q_),
+                         internal::get_queue(async_mem.write_data_q_),
+                         internal::get_queue(async_mem.write_resp_q_)}) {
+        queue->set_pump(pump);
+      }
+      async_mem.owner_.reset(new char, [server](char *token) {
+        server->drain_writes();
+        delete token;
+      });
+      return async_mem;
+    }
+
+    // a copy of async_mem is stored in std::function<void()>; the service
+    // finishes once all copies held by the user are destructed
+    auto task = internal::create_task("async_mmap", detach);
+    async_mem.bind(task, /*is_service=*/true);
+    async_mmap service_mem = async_mem;
+    service_mem.owner_ = nullptr;
+    const std::weak_ptr<char> owner = async_mem.owner_;
+    internal::schedule(task, [service_mem, owner] {
+      service server(service_mem);
+      while (!owner.expired()) {
+        if (!server.step()) {
+          server.yield();
+        }
+      }
+      server.drain_writes();
+    });
+    return async_mem;
+  }
+
+private:
+  template <typename Param> friend struct internal::observer;
+
+  // Serves requests of an async_mmap, either in a detached task or inline.
+  class service {
+  public:
+    explicit service(const async_mmap &mem)
+        : ptr(mem.ptr_), size(mem.size_), timing(mem.timing_),
+          read_addr_q(internal::get_typed_queue(mem.read_addr_q_)),
+          read_data_q(internal::get_typed_queue(mem.read_data_q_)),
+          write_addr_q(internal::get_typed_queue(mem.write_addr_q_)),
+          write_data_q(internal::get_typed_queue(mem.write_data_q_)),
+          write_resp_q(internal::get_typed_queue(mem.write_resp_q_)),
+          addrs(std::max(read_addr_q.get_depth(), write_addr_q.get_depth())),
+          is_traced(internal::is_tracing()) {}
+
+    // Serves all requests available, where runs of consecutive addresses are
+    // served as bursts. Responses are delayed until the bursts complete if the
+    // memory is modeled.
+    //
+    // Returns whether any progress is made.
+    bool step() {
+      const int64_t now =
+          timing == nullptr ? 0 : internal::memory_timing::now();
+
+      // read requests
+      uint64_t read_limit =
+          timing == nullptr ? read_data_q.get_depth() - read_data_q.get_size()
+                            : timing->get_max_outstanding();
+      read_limit -= std::min(read_limit, read_count);
+      const uint64_t read_req_count =
+          pop_addrs(read_addr_q, std::min(read_addr_q.get_size(), read_limit));
+      const uint64_t distance = prefetcher.get_distance();
+      uint64_t pos = 0; // index of the burst in addrs
+      for_each_burst(read_req_count, [&](addr_t addr, uint64_t n) {
+        prefetch(pos + distance, std::min(pos + n + distance, read_req_count));
+        pos += n;
+        if (timing == nullptr && reads.empty()) {
+          read(addr, n); // fast path; there is room for all requests
+        } else {
+          reads.push_back({request(now, addr, n), addr, n});
+          read_count += n;
+        }
+      });
+      // requests left in the channel are likely served in the next step; as
+      // above, only burst starts are prefetched
+      bool has_prev = read_req_count > 0;
+      addr_t prev_addr = has_prev ? addrs[read_req_count - 1] : 0;
+      read_addr_q.peek_n(
+          distance, [&](uint64_t, const internal::elem_t<addr_t> &e) {
+            if (!e.eot && !(has_prev && e.val == prev_addr + 1)) {
+              prefetch(e.val);
+            }
+            has_prev = !e.eot;
+            prev_addr = e.val;
+          });
+      if (timing == nullptr && prefetcher.is_tuning() && read_req_count > 0) {
+        prefetcher.record(read_req_count, internal::memory_timing::now());
+      }
+
+      // read responses, in order
+      uint64_t read_resp_count = 0;
+      while (!reads.empty() && reads.front().ready <= now) {
+        auto &front = reads.front();
+        const uint64_t n = read(front.addr, front.n);
+        read_resp_count += n;
+        if (n < front.n) {
+          front.addr += n;
+          front.n -= n;
+          break;
+        }
+        reads.pop_front();
+      }
+      read_count -= read_resp_count;
+      if (timing != nullptr && read_resp_count > 0) {
+        timing->complete(now, read_resp_count * sizeof(T));
+      }
+
+      // write requests; data are written immediately
+      uint64_t write_limit =
+          timing == nullptr ? 256 : timing->get_max_outstanding();
+      write_limit -= std::min(write_limit, write_count + ack_count);
+      const uint64_t write_req_count =
+          write(std::min(write_limit, write_addr_q.get_size()),
+                [&](addr_t addr, uint64_t n) {
+                  if (timing == nullptr && writes.empty()) {
+                    ack_count += n; // fast path; completed immediately
+                  } else {
+                    writes.push_back({request(now, addr, n), addr, n});
+                    write_count += n;
+                  }
+                });
+
+      // write responses; each acknowledges at most 256 writes
+      while (!writes.empty() && writes.front().ready <= now &&
+             ack_count < 256) {
+        auto &front = writes.front();
+        const uint64_t n = std::min(front.n, 256 - ack_count);
+        ack_count += n;
+        write_count -= n;
+        front.n -= n;
+        if (front.n == 0) {
+          writes.pop_front();
+        }
+      }
+      bool is_responded = false;
+      // respond once no more writes can be acknowledged together
+      if (ack_count > 0 && (ack_count == 256 || write_addr_q.empty() ||
+                            write_data_q.empty())) {
+        const uint64_t n = ack_count;
+        is_responded = write_resp_q.push_n(1, [n](uint64_t) {
+          return internal::elem_t<resp_t>{resp_t(n - 1), false};
+        });
+        if (is_responded) {
+          if (timing != nullptr) {
+            timing->complete(now, ack_count * sizeof(T));
+          }
+          ack_count = 0;
+        }
+      }
+
+      return read_req_count > 0 || read_resp_count > 0 ||
+             write_req_count > 0 || is_responded;
+    }
+
+    // Performs all pending writes without acknowledging them.
+    void drain_writes() {
+      while (write(write_addr_q.get_size(), [](addr_t, uint64_t) {}) > 0) {
+      }
+    }
+
+    // Suspends the detached service until it may make progress.
+    void yield() const {
+      if (read_addr_q.empty()) {
+        internal::yield(read_addr_q, /*is_full=*/false);
+      } else {
+        internal::yield(read_data_q, /*is_full=*/true);
+      }
+    }
+
+  private:
+    // burst accepted but not yet responded
+    struct burst {
+      int64_t ready; // time when the burst completes
+      addr_t addr;
+      uint64_t n;
+    };
+
+    T *const ptr;
+    const uint64_t size;
+    const std::shared_ptr<internal::memory_timing> timing;
+
+    internal::queue<internal::elem_t<addr_t>> &read_addr_q;
+    internal::queue<internal::elem_t<T>> &read_data_q;
+    internal::queue<internal::elem_t<addr_t>> &write_addr_q;
+    internal::queue<internal::elem_t<T>> &write_data_q;
+    internal::queue<internal::elem_t<resp_t>> &write_resp_q;
+
+    internal::prefetch_tuner prefetcher;
+    std::vector<addr_t> addrs; // addresses popped in the current step
+    std::deque<burst> reads;   // in the order of requests
+    std::deque<burst> writes;  // in the order of requests
+    uint64_t read_count = 0;   // elements in reads
+    uint64_t write_count = 0;  // elements in writes
+    uint64_t ack_count = 0;    // writes completed but not yet responded
+    const bool is_traced;      // whether bursts are recorded
+
+    uint64_t pop_addrs(internal::queue<internal::elem_t<addr_t>> &q,
+                       uint64_t n) {
+      return q.pop_n(n, [&](uint64_t i, const internal::elem_t<addr_t> &e) {
+        if (e.eot) {
+          LOG(FATAL) << "channel '" << q.get_name() << "' read when closed";
+        }
+        addrs[i] = e.val;
+      });
+    }
+
+    // Prefetches addrs[i] for i in [begin, end) that start a burst; the rest
+    // of a burst is left to the hardware prefetcher.
+    void prefetch(uint64_t begin, uint64_t end) const {
+      for (uint64_t i = begin; i < end; ++i) {
+        if (i == 0 || addrs[i] != addrs[i - 1] + 1) {
+          prefetch(addrs[i]);
+        }
+      }
+    }
+
+    void prefetch(addr_t addr) const {
+      if (addr >= 0 && uint64_t(addr) < size) {
+        const char *src = reinterpret_cast<const char *>(ptr + addr);
+        for (uint64_t offset = 0; offset < sizeof(T); offset += 64) {
+          __builtin_prefetch(src + offset);
+        }
+      }
+    }
+
+    // Copies up to n elements from addr to the read data channel.
+    uint64_t read(addr_t addr, uint64_t n) {
+      const T *src = ptr + addr;
+      n = read_data_q.push_n(n, [src](uint64_t i) {
+        return internal::elem_t<T>{src[i], false};
+      });
+      record(addr, n, trace::kRead);
+      return n;
+    }
+
+    // Writes up to n elements for which both the address and the data are
+    // available, and calls func(addr, n) for each burst.
+    template <typename Func> uint64_t write(uint64_t n, Func &&func) {
+      const uint64_t count =
+          pop_addrs(write_addr_q, std::min(n, write_data_q.get_size()));
+      for_each_burst(count, [&](addr_t addr, uint64_t n) {
+        T *dst = ptr + addr;
+        write_data_q.pop_n(n, [&](uint64_t i, const internal::elem_t<T> &e) {
+          if (e.eot) {
+            LOG(FATAL) << "channel '" << write_data_q.get_name()
+                       << "' read when closed";
+          }
+          dst[i] = e.val;
+        });
+        record(addr, n, trace::kWrite);
+        func(addr, n);
+      });
+      return count;
+    }
+
+    void record(addr_t addr, uint64_t n, trace::access_kind kind) const {
+      if (is_traced && n > 0) {
+        internal::trace_access(ptr, addr * sizeof(T), n * sizeof(T), kind);
+      }
+    }
+
+    // Returns when the burst completes; bursts are never delayed if unmodeled.
+    int64_t request(int64_t now, addr_t addr, uint64_t n) {
+      return timing == nullptr
+                 ? 0
+                 : timing->request(now, addr * sizeof(T), n * sizeof(T));
+    }
+
+    // Calls func(addr, n) for each run of n consecutive addresses from addr in
+    // the first count addresses popped.
+    template <typename Func> void for_each_burst(uint64_t count, Func &&func) {
+      for (uint64_t i = 0; i < count;) {
+        uint64_t j = i + 1;
+        while (j < count && addrs[j] == addrs[j - 1] + 1) {
+          ++j;
         }
-        read_data_q_.write(this->ptr_[addr]);
-      }
-      if (write_count != 256 && !write_addr_q_.empty() &&
-          !write_data_q_.empty()) {
-        const auto addr = write_addr_q_.read();
-        CHECK_GE(addr, 0);
-        if (addr != 0) {
-          CHECK_LT(addr, this->size_);
+        for (auto addr : {addrs[i], addrs[j - 1]}) {
+          CHECK_GE(addr, 0);
+          if (addr != 0) {
+            CHECK_LT(addr, size);
+          }
         }
-        this->ptr_[addr] = write_data_q_.read();
-        ++write_count;
-      } else if (write_count > 0 &&
-                 this->write_resp_q_.try_write(resp_t(write_count - 1))) {
-        CHECK_LE(write_count, 256);
-        write_count = 0;
+        func(addrs[i], j - i);
+        i = j;
       }
     }
+  };
+
+  static uint64_t get_depth() { return internal::get_async_mmap_depth(); }
+
+  // Whether requests are served inline in the user task instead of a detached
+  // service task; set by environment variable TASK_ASYNC_MMAP_INLINE.
+  static bool is_inline() {
+    static const bool is_inline = [] {
+      auto flag = getenv("TASK_ASYNC_MMAP_INLINE");
+      return flag != nullptr && *flag != '\0' && strcmp(flag, "0") != 0;
+    }();
+    return is_inline;
   }
 
-  static async_mmap schedule(super mem) {
-    // a copy of async_mem is stored in std::function<void()>
-    async_mmap async_mem(mem);
-    internal::schedule(detach, async_mem);
+  // Records channel endpoints of either the service or the user task.
+  void bind(internal::task_info *task, bool is_service) const {
+    internal::bind_channel(task, internal::get_queue(read_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(read_data_q_),
+                           is_service);
+    internal::bind_channel(task, internal::get_queue(write_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_data_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_resp_q_),
+                           is_service);
+  }
+};
+
+/// Defines a value tagged with the request it belongs to.
+template <typename T> struct tagged {
+  uint64_t tag;
+  T val;
+};
+
+/// Defines a view of a piece of consecutive memory with asynchronous random
+/// accesses that may complete out of order.
+///
+/// Each request carries a tag, which comes back with its response. Requests
+/// are distributed by address among @c TASK_ASYNC_MMAP_LANES (4 by default)
+/// detached service tasks, so that requests of a lane whose responses are not
+/// consumed do not hold back the other lanes, unless a full channel of requests
+/// is waiting for that lane. Reads to the same address are served in the order
+/// they are issued, and so are writes, but a read and a write to the same
+/// address may be served in either order; wait for the write response before
+/// reading the address written. Use @c task::reorder if the responses must be
+/// in order.
+///
+/// The lanes are coroutines on the worker threads shared by all tasks. A
+/// blocking access (e.g., a page fault) blocks its worker thread, and with it
+/// the other lanes and tasks scheduled on that thread; with
+/// @c TASK_CONCURRENCY=1 it holds back every lane.
+template <typename T> class tagged_async_mmap : public mmap<T> {
+public:
+  /// Type of the addresses.
+  using addr_t = int64_t;
+
+  /// Type of the tags.
+  using tag_t = uint64_t;
+
+private:
+  using super = mmap<T>;
+
+  // request sent to a lane
+  struct request {
+    tag_t tag;
+    addr_t addr;
+    bool is_write;
+    T data;
+  };
+
+  // response sent from a lane
+  struct response {
+    tag_t tag;
+    bool is_write;
+    T data;
+  };
+
+  internal::dynamic_stream<tagged<addr_t>> read_addr_q_{get_depth(),
+                                                        "read_addr"};
+  internal::dynamic_stream<tagged<T>> read_data_q_{get_depth(), "read_data"};
+  internal::dynamic_stream<tagged<addr_t>> write_addr_q_{get_depth(),
+                                                         "write_addr"};
+  internal::dynamic_stream<T> write_data_q_{get_depth(), "write_data"};
+  internal::dynamic_stream<tag_t> write_resp_q_{get_depth(), "write_resp"};
+  std::vector<internal::basic_stream<request>> lane_req_qs_;
+  std::vector<internal::basic_stream<response>> lane_resp_qs_;
+
+  // set by the dispatcher once it forwards the last request to the lanes
+  std::shared_ptr<std::atomic<bool>> is_closed_;
+
+  // shared by copies of the same tagged_async_mmap held by the user but not
+  // the services; destructed before the channels
+  std::shared_ptr<char> owner_;
+
+  // Only convert when scheduled.
+  tagged_async_mmap(const super &mem)
+      : super(mem), is_closed_(std::make_shared<std::atomic<bool>>(false)),
+        owner_(std::make_shared<char>()), read_addr(read_addr_q_),
+        read_data(read_data_q_), write_addr(write_addr_q_),
+        write_data(write_data_q_), write_resp(write_resp_q_) {
+    for (uint64_t i = 0; i < get_lane_count(); ++i) {
+      const std::string suffix = "[" + std::to_string(i) + "]";
+      lane_req_qs_.emplace_back(
+          std::make_shared<internal::queue<internal::elem_t<request>>>(
+              get_depth(), "lane_req" + suffix));
+      lane_resp_qs_.emplace_back(
+          std::make_shared<internal::queue<internal::elem_t<response>>>(
+              get_depth(), "lane_resp" + suffix));
+    }
+  }
+
+  // Must be operated via the read/write addr/data stream APIs.
+  operator T *() { return super::ptr_; }
+
+  // Dereference not permitted.
+  T &operator[](std::size_t idx) { return super::ptr_[idx]; }
+  const T &operator[](std::size_t idx) const { return super::ptr_[idx]; }
+  T &operator*() { return *super::ptr_; }
+  const T &operator*() const { return *super::ptr_; }
+
+public:
+  /// Provides access to the read address channel.
+  ///
+  /// Each value written to this channel triggers an asynchronous memory read
+  /// request of @c val tagged with @c tag.
+  task::ostream<tagged<addr_t>> read_addr;
+
+  /// Provides access to the read data channel.
+  ///
+  /// Each value read from this channel carries the data retrieved from the
+  /// underlying memory system and the tag of its request, in any order.
+  task::istream<tagged<T>> read_data;
+
+  /// Provides access to the write address channel.
+  ///
+  /// Each value written to this channel triggers an asynchronous memory write
+  /// request of @c val tagged with @c tag.
+  task::ostream<tagged<addr_t>> write_addr;
+
+  /// Provides access to the write data channel.
+  ///
+  /// Each value written to this channel supplies data to the memory write
+  /// request, in the order of the write addresses.
+  task::ostream<T> write_data;
+
+  /// Provides access to the write response channel.
+  ///
+  /// Each value read from this channel is the tag of a memory write request
+  /// acknowledged by the underlying memory system, in any order.
+  task::istream<tag_t> write_resp;
+
+  static tagged_async_mmap schedule(super mem) {
+    tagged_async_mmap async_mem(mem);
+
+    // copies of async_mem are stored in std::function<void()>; the services
+    // finish once all copies held by the user are destructed
+    auto dispatcher = internal::create_task("tagged_async_mmap", detach);
+    async_mem.bind(dispatcher, /*is_service=*/true);
+    tagged_async_mmap service_mem = async_mem;
+    service_mem.owner_ = nullptr;
+    const std::weak_ptr<char> owner = async_mem.owner_;
+    for (uint64_t i = 0; i < get_lane_count(); ++i) {
+      auto lane = internal::create_task("tagged_async_mmap_lane", detach);
+      internal::bind_channel(
+          lane, internal::get_queue(async_mem.lane_req_qs_[i]),
+          /*is_output=*/false);
+      internal::bind_channel(
+          lane, internal::get_queue(async_mem.lane_resp_qs_[i]),
+          /*is_output=*/true);
+      internal::schedule(
+          lane, [service_mem, owner, i] { service_mem.serve(i, owner); });
+    }
+    internal::schedule(dispatcher,
+                       [service_mem, owner] { service_mem.dispatch(owner); });
     return async_mem;
   }
+
+private:
+  template <typename Param> friend struct internal::observer;
+
+  // Forwards requests to the lanes and responses from the lanes until the user
+  // finishes, then closes the lanes once they serve all writes forwarded.
+  void dispatch(const std::weak_ptr<char> &owner) const {
+    auto &read_addr_q = internal::get_typed_queue(read_addr_q_);
+    auto &read_data_q = internal::get_typed_queue(read_data_q_);
+    auto &write_addr_q = internal::get_typed_queue(write_addr_q_);
+    auto &write_data_q = internal::get_typed_queue(write_data_q_);
+    auto &write_resp_q = internal::get_typed_queue(write_resp_q_);
+
+    // requests wait here while their lane is full, so that a busy lane does
+    // not hold back requests to the other lanes
+    std::vector<std::deque<request>> pending(lane_req_qs_.size());
+    const uint64_t pending_capacity = get_depth();
+    auto forward = [this, &pending](uint64_t i) {
+      auto &lane_q = internal::get_typed_queue(lane_req_qs_[i]);
+      bool is_forwarded = false;
+      while (!pending[i].empty() && !lane_q.full()) {
+        lane_q.push({pending[i].front(), false});
+        pending[i].pop_front();
+        is_forwarded = true;
+      }
+      return is_forwarded;
+    };
+
+    for (;;) {
+      // the user may issue no more requests once expired
+      const bool is_done = owner.expired();
+      bool is_active = false;
+
+      // read requests; no longer useful once the user finishes
+      while (!is_done && !read_addr_q.empty()) {
+        const tagged<addr_t> &req = front(read_addr_q);
+        auto &lane = pending[get_lane(req.val)];
+        if (lane.size() >= pending_capacity) {
+          break;
+        }
+        lane.push_back({req.tag, req.val, /*is_write=*/false, T()});
+        read_addr_q.pop();
+        is_active = true;
+      }
+
+      // write requests; forwarded even if the user finishes
+      while (!write_addr_q.empty() && !write_data_q.empty()) {
+        const tagged<addr_t> &req = front(write_addr_q);
+        auto &lane = pending[get_lane(req.val)];
+        if (lane.size() >= pending_capacity) {
+          break;
+        }
+        lane.push_back(
+            {req.tag, req.val, /*is_write=*/true, front(write_data_q)});
+        write_addr_q.pop();
+        write_data_q.pop();
+        is_active = true;
+      }
+
+      for (uint64_t i = 0; i < pending.size(); ++i) {
+        is_active |= forward(i);
+      }
+
+      // responses, in the order they leave each lane
+      for (uint64_t i = 0; !is_done && i < lane_resp_qs_.size(); ++i) {
+        auto &lane_q = internal::get_typed_queue(lane_resp_qs_[i]);
+        while (!lane_q.empty()) {
+          const response &resp = lane_q.front().val;
+          if (resp.is_write ? write_resp_q.full() : read_data_q.full()) {
+            break;
+          }
+          if (resp.is_write) {
+            write_resp_q.push({resp.tag, false});
+          } else {
+            read_data_q.push({{resp.tag, resp.data}, false});
+          }
+          lane_q.pop();
+          is_active = true;
+        }
+      }
+
+      if (is_done && (write_addr_q.empty() || write_data_q.empty())) {
+        for (uint64_t i = 0; i < pending.size(); ++i) {
+          auto &lane_q = internal::get_typed_queue(lane_req_qs_[i]);
+          while (!pending[i].empty() || !lane_q.empty()) {
+            if (!forward(i)) {
+              internal::yield(lane_q, /*is_full=*/true);
+            }
+          }
+        }
+        *is_closed_ = true;
+        return;
+      }
+      if (!is_active) {
+        internal::yield(read_addr_q, /*is_full=*/false);
+      }
+    }
+  }
+
+  // Serves requests of lane i until the lanes are closed. Responses are dropped
+  // once the user finishes.
+  void serve(uint64_t i, const std::weak_ptr<char> &owner) const {
+    auto &req_q = internal::get_typed_queue(lane_req_qs_[i]);
+    auto &resp_q = internal::get_typed_queue(lane_resp_qs_[i]);
+    const bool is_traced = internal::is_tracing();
+    for (;;) {
+      if (req_q.empty()) {
+        if (*is_closed_) {
+          return;
+        }
+        internal::yield(req_q, /*is_full=*/false);
+        continue;
+      }
+      if (resp_q.full() && !owner.expired()) {
+        internal::yield(resp_q, /*is_full=*/true);
+        continue;
+      }
+      const request req = req_q.pop().val;
+      CHECK_GE(req.addr, 0);
+      CHECK_LT(req.addr, super::size_);
+      response resp{req.tag, req.is_write, T()};
+      if (is_traced) {
+        internal::trace_access(super::ptr_, req.addr * sizeof(T), sizeof(T),
+                               req.is_write ? trace::kWrite : trace::kRead);
+      }
+      if (req.is_write) {
+        super::ptr_[req.addr] = req.data;
+      } else {
+        resp.data = super::ptr_[req.addr];
+      }
+      if (!resp_q.full()) {
+        resp_q.push({resp, false});
+      }
+    }
+  }
+
+  // Returns the index of the lane serving addr.
+  uint64_t get_lane(addr_t addr) const {
+    return static_cast<uint64_t>(addr) % lane_req_qs_.size();
+  }
+
+  template <typename U>
+  static const U &front(const internal::queue<internal::elem_t<U>> &q) {
+    const auto &elem = q.front();
+    if (elem.eot) {
+      LOG(FATAL) << "channel '" << q.get_name() << "' read when closed";
+    }
+    return elem.val;
+  }
+
+  static uint64_t get_depth() { return internal::get_async_mmap_depth(); }
+
+  // Number of service tasks; set by environment variable
+  // TASK_ASYNC_MMAP_LANES (4 by default).
+  static uint64_t get_lane_count() {
+    static const uint64_t count = [] {
+      auto count = getenv("TASK_ASYNC_MMAP_LANES");
+      return count == nullptr ? 4 : std::max(1LL, atoll(count));
+    }();
+    return count;
+  }
+
+  // Records channel endpoints of either the dispatcher or the user task.
+  void bind(internal::task_info *task, bool is_service) const {
+    internal::bind_channel(task, internal::get_queue(read_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(read_data_q_),
+                           is_service);
+    internal::bind_channel(task, internal::get_queue(write_addr_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_data_q_),
+                           !is_service);
+    internal::bind_channel(task, internal::get_queue(write_resp_q_),
+                           is_service);
+    if (is_service) {
+      for (const auto &stream : lane_req_qs_) {
+        internal::bind_channel(task, internal::get_queue(stream),
+                               /*is_output=*/true);
+      }
+      for (const auto &stream : lane_resp_qs_) {
+        internal::bind_channel(task, internal::get_queue(stream),
+                               /*is_output=*/false);
+      }
+    }
+  }
 };
 
+/// Restores the order of tagged values, as a task.
+///
+/// Values must be tagged 0, 1, 2, ... in the order to restore, e.g., the
+/// responses of a @c task::tagged_async_mmap whose requests are tagged so, and
+/// at most @c N of them may be ahead of the next one in order. The output is
+/// closed when the input is.
+///
+/// @tparam N    Capacity of the reorder buffer.
+/// @param in    Values in any order.
+/// @param out   Values in the order of their tags.
+template <typename T, uint64_t N>
+void reorder(istream<tagged<T>> &in, ostream<T> &out) {
+  std::vector<T> buffer(N);
+  std::vector<bool> is_valid(N);
+  for (uint64_t next = 0;;) {
+    if (is_valid[next % N]) {
+      out.write(buffer[next % N]);
+      is_valid[next % N] = false;
+      ++next;
+      continue;
+    }
+    if (in.eot()) {
+      break;
+    }
+    const tagged<T> value = in.read();
+    CHECK_GE(value.tag, next) << "tag " << value.tag << " repeated";
+    CHECK_LT(value.tag - next, N) << "reorder buffer overflow";
+    buffer[value.tag % N] = value.val;
+    is_valid[value.tag % N] = true;
+  }
+  in.open();
+  out.close();
+}
+
 /// Defines an array of @c task::mmap.
 template <typename T, uint64_t S> class mmaps {
 protected:
@@ -283,6 +1343,20 @@ public:
   /// References a @c task::mmap in the array.
   mmap<T> &operator[](int idx) { return mmaps_[idx]; };
 
+  /// Sets the timing model of each mapped memory when accessed asynchronously.
+  ///
+  /// This should be used on the host only. Use @c operator[] to set the model
+  /// of each mapped memory individually.
+  ///
+  /// @param model Timing model of each underlying memory channel.
+  /// @return      This @c task::mmaps.
+  mmaps &set_memory_model(const memory_model &model) {
+    for (auto &mem : mmaps_) {
+      mem.set_memory_model(model);
+    }
+    return *this;
+  }
+
   template <uint64_t offset, uint64_t length> mmaps<T, length> slice() {
     static_assert(offset + length < S, "invalid slice");
     mmaps<T, length> result;
@@ -302,6 +1376,8 @@ public:
   /// @return @c task::mmap of the same pieces of memory but of type
   ///         <tt>task::vec_t<T, N></tt>.
   template <uint64_t N> mmaps<vec_t<T, N>, S> vectorized() const {
+    static_assert(sizeof(vec_t<T, N>) == sizeof(T) * N,
+                  "vec_t<T, N> is packed and cannot alias T");
     std::array<vec_t<T, N> *, S> ptrs;
     std::array<uint64_t, S> sizes;
     for (uint64_t i = 0; i < S; ++i) {
@@ -310,7 +1386,9 @@ public:
       ptrs[i] = reinterpret_cast<vec_t<T, N> *>(mmaps_[i].get());
       sizes[i] = mmaps_[i].size() / N;
     }
-    return mmaps<vec_t<T, N>, S>(ptrs, sizes);
+    mmaps<vec_t<T, N>, S> result(ptrs, sizes);
+    copy_memory_models(result);
+    return result;
   }
 
   /// Reinterprets the element type of each mapped memory as @c U.
@@ -342,10 +1420,20 @@ public:
       ptrs[i] = reinterpret_cast<U *>(mmaps_[i].get());
       sizes[i] = mmaps_[i].size() * sizeof(T) / sizeof(U);
     }
-    return mmaps<U, S>(ptrs, sizes);
+    mmaps<U, S> result(ptrs, sizes);
+    copy_memory_models(result);
+    return result;
   }
 
 private:
+  template <typename U> void copy_memory_models(mmaps<U, S> &result) const {
+    for (uint64_t i = 0; i < S; ++i) {
+      if (auto model = mmaps_[i].get_memory_model()) {
+        result[i].set_memory_model(*model);
+      }
+    }
+  }
+
   template <typename Param, typename Arg> friend struct internal::accessor;
 
   int access_pos_ = 0;
@@ -377,6 +1465,33 @@ struct accessor<async_mmap<T>, mmaps<T, S> &> {
   }
 };
 
+template <typename T> struct accessor<tagged_async_mmap<T>, mmap<T> &> {
+  static tagged_async_mmap<T> access(mmap<T> &arg) {
+    return tagged_async_mmap<T>::schedule(arg);
+  }
+};
+
+template <typename T, uint64_t S>
+struct accessor<tagged_async_mmap<T>, mmaps<T, S> &> {
+  static tagged_async_mmap<T> access(mmaps<T, S> &arg) {
+    return tagged_async_mmap<T>::schedule(arg.access());
+  }
+};
+
+template <typename T> struct observer<async_mmap<T>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    arg.bind(task, /*is_service=*/false);
+    return std::forward<Arg>(arg);
+  }
+};
+
+template <typename T> struct observer<tagged_async_mmap<T>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    arg.bind(task, /*is_service=*/false);
+    return std::forward<Arg>(arg);
+  }
+};
+
 } // namespace internal
 
 } // namespace task
@@ -0,0 +1,592 @@
+#ifndef TASK_NUMERIC_H_
+#define TASK_NUMERIC_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <ostream>
+#include <type_traits>
+
+#ifndef __SYNTHESIS__
+#if defined(__AVX512F__) || defined(__F16C__)
+#include <immintrin.h>
+#endif // __AVX512F__ || __F16C__
+#endif // __SYNTHESIS__
+
+#include "task/packed.h"
+#include "task/util.h"
+#include "task/vec.h"
+
+namespace task {
+
+namespace internal {
+
+// Conversions between the bits of IEEE 754 binary32 and binary16 or bfloat16
+// numbers. U and F are either uint32_t and float or SIMD registers of uint32_t
+// and float lanes, so that scalars and registers are converted identically.
+// Narrowing rounds to nearest even, and NaNs are quieted, keeping their highest
+// payload bits like F16C instructions do.
+
+template <typename F, typename U> inline F half_to_float(U h) {
+  const U bits = h & 0x7fff;
+  // the exponent is rebiased from 15 to 127
+  const U normal = (bits << 13) + 0x38000000;
+  const U special = (bits << 13 | 0x7f800000) |
+                    (bits > 0x7c00 ? U{} + 0x400000 : U{});
+  // subnormals are exact in float: 2^23 + bits, minus 2^23, times 2^-24
+  const U subnormal = bit_cast<U>(
+      (bit_cast<F>(bits | 0x4b000000) - 8388608.f) * 5.9604644775390625e-8f);
+  return bit_cast<F>((h & 0x8000) << 16 |
+                     (bits >= 0x7c00  ? special
+                      : bits >= 0x400 ? normal
+                                      : subnormal));
+}
+
+template <typename U, typename F> inline U float_to_half(F f) {
+  const U x = bit_cast<U>(f);
+  const U abs = x & 0x7fffffff;
+  const U rebiased = abs - 0x38000000;
+  const U normal = (rebiased + 0xfff + (rebiased >> 13 & 1)) >> 13;
+  // 0.5 has an ULP of 2^-24, the ULP of subnormals, so the addition rounds
+  const U subnormal = bit_cast<U>(bit_cast<F>(abs) + .5f) - 0x3f000000;
+  const U nan = (abs >> 13 & 0x3ff) | 0x7e00;
+  return (x >> 16 & 0x8000) | (abs > 0x7f800000    ? nan
+                               : abs >= 0x477ff000 ? U{} + 0x7c00
+                               : abs >= 0x38800000 ? normal
+                                                   : subnormal);
+}
+
+template <typename F, typename U> inline F bfloat16_to_float(U h) {
+  return bit_cast<F>(h << 16);
+}
+
+template <typename U, typename F> inline U float_to_bfloat16(F f) {
+  const U x = bit_cast<U>(f);
+  return (x & 0x7fffffff) > 0x7f800000 ? (x >> 16 | 0x40)
+                                       : (x + 0x7fff + (x >> 16 & 1)) >> 16;
+}
+
+enum float16_format { kBinary16, kBfloat16 };
+
+// 16-bit floating-point number; see task::half and task::bfloat16.
+template <float16_format Format> class float16 {
+public:
+  static constexpr int width = 16;
+
+  float16() = default;
+
+  // rounds to nearest even
+  float16(float val)
+      : bits_(uint16_t(Format == kBinary16
+                           ? float_to_half<uint32_t>(val)
+                           : float_to_bfloat16<uint32_t>(val))) {}
+
+  operator float() const {
+    return Format == kBinary16 ? half_to_float<float>(uint32_t(bits_))
+                               : bfloat16_to_float<float>(uint32_t(bits_));
+  }
+
+  // raw bits
+  static float16 from_bits(uint16_t bits) {
+    float16 result;
+    result.bits_ = bits;
+    return result;
+  }
+  uint16_t to_bits() const { return bits_; }
+
+  // assignment operators, computed in float
+#define DEFINE_OP(op)                                                          \
+  float16 &operator op##=(float rhs) { return *this = float(*this) op rhs; }
+  DEFINE_OP(+)
+  DEFINE_OP(-)
+  DEFINE_OP(*)
+  DEFINE_OP(/)
+#undef DEFINE_OP
+
+private:
+  uint16_t bits_;
+};
+
+} // namespace internal
+
+/// IEEE 754 half-precision (binary16) floating-point number.
+///
+/// A @c task::half converts implicitly to and from @c float, in which
+/// arithmetic is carried out, so expressions of @c task::half are evaluated in
+/// @c float and rounded to nearest even only when assigned to a
+/// @c task::half. @c task::widthof reports 16. Conversions between
+/// <tt>task::vec_t<task::half, N></tt> and <tt>task::vec_t<float, N></tt> are
+/// vectorized, with F16C or AVX-512 instructions if available, and
+/// @c task::sum and @c task::dot of @c task::half lanes accumulate in @c float.
+using half = internal::float16<internal::kBinary16>;
+
+/// Brain floating-point number, i.e., the highest 16 bits of a @c float.
+///
+/// Same as @c task::half, but with the 8-bit exponent of @c float and a 7-bit
+/// mantissa.
+using bfloat16 = internal::float16<internal::kBfloat16>;
+
+namespace internal {
+
+// Returns the largest W-bit two's complement integer.
+template <int W> constexpr int64_t max_int() {
+  return int64_t(low_bits<W - 1>(~uint64_t(0)));
+}
+
+// Returns val * 2^shift without undefined behavior for negative val.
+inline int64_t shift_left(int64_t val, int shift) {
+  return int64_t(uint64_t(val) << shift);
+}
+
+// Converts val with F2 fraction bits to W bits with F fraction bits, rounded
+// to nearest with ties toward positive infinity and saturated.
+template <int W, int F, int F2> inline int64_t rescale(int64_t val) {
+  const int64_t max = max_int<W>();
+  if (F >= F2) {
+    const int shift = (F - F2 + 64) % 64;
+    return val > (max >> shift)    ? max
+           : val < ~(max >> shift) ? ~max
+                                   : shift_left(val, shift);
+  }
+  const int shift = (F2 - F + 64) % 64;
+  val = (val >> shift) + (val >> ((shift + 63) % 64) & 1);
+  return val > max ? max : val < ~max ? ~max : val;
+}
+
+// Number of bits by which a sum of n values grows.
+constexpr int ceil_log2(int n) {
+  return n <= 1 ? 0 : 1 + ceil_log2((n + 1) / 2);
+}
+
+} // namespace internal
+
+/// Signed fixed-point number of @c W bits, @c I of which are integer bits,
+/// like @c ap_fixed<W, I> of Vitis HLS.
+///
+/// A @c task::fixed is stored as a @c W-bit two's complement integer, scaled
+/// by 2^-(W - I). Floating-point numbers and other @c task::fixed types convert
+/// implicitly to @c task::fixed, rounded to nearest with ties toward positive
+/// infinity and saturated; conversions to floating-point numbers are explicit.
+/// Results of <tt>+</tt>, <tt>-</tt>, and <tt>*</tt> are exact and as wide as
+/// needed, e.g., <tt>task::fixed<8, 2></tt> times itself is a
+/// <tt>task::fixed<16, 4></tt>, so they are accumulated without loss until
+/// assigned to a narrower type. @c task::widthof reports @c W.
+///
+/// @tparam W Number of bits, in <tt>[1, 64]</tt>.
+/// @tparam I Number of integer bits including the sign bit, in
+///           <tt>[max(1, W - 63), W]</tt>.
+template <int W, int I> class fixed {
+  static_assert(W >= 1 && W <= 64, "width must be in [1, 64]");
+  static_assert(I >= 1 && I <= W && W - I <= 63,
+                "integer bits must be in [max(1, W - 63), W]");
+
+public:
+  static constexpr int width = W;
+  static constexpr int int_bits = I;
+  static constexpr int frac_bits = W - I;
+
+  using storage_type = internal::narrow_storage<W, true>;
+
+  fixed() = default;
+
+  fixed(double val) {
+    // the fraction is exact, unlike the sum of 0.5 and the value
+    const double unrounded = std::ldexp(val, frac_bits);
+    const double floored = std::floor(unrounded);
+    const double scaled = floored + (unrounded - floored >= .5 ? 1 : 0);
+    const double bound = std::ldexp(1., W - 1);
+    const int64_t max = internal::max_int<W>();
+    value_ = storage_type(scaled != scaled  ? 0
+                          : scaled >= bound ? max
+                          : scaled < -bound ? ~max
+                                            : int64_t(scaled));
+  }
+
+  template <int W2, int I2>
+  fixed(const fixed<W2, I2> &other)
+      : value_(storage_type(
+            internal::rescale<W, W - I, W2 - I2>(other.to_bits()))) {}
+
+  explicit operator double() const {
+    return std::ldexp(double(value_), -frac_bits);
+  }
+  explicit operator float() const { return float(double(*this)); }
+
+  // raw bits, i.e., the value times 2^frac_bits
+  static fixed from_bits(storage_type bits) {
+    fixed result;
+    result.value_ = bits;
+    return result;
+  }
+  storage_type to_bits() const { return value_; }
+
+  // assignment operators, computed exactly and then rounded
+#define DEFINE_OP(op)                                                          \
+  template <int W2, int I2> fixed &operator op##=(const fixed<W2, I2> &rhs) {  \
+    return *this = *this op rhs;                                               \
+  }                                                                            \
+  fixed &operator op##=(double rhs) { return *this op##= fixed(rhs); }
+  DEFINE_OP(+)
+  DEFINE_OP(-)
+  DEFINE_OP(*)
+#undef DEFINE_OP
+
+  fixed<W + 1, I + 1> operator-() const {
+    return fixed<W + 1, I + 1>::from_bits(-int64_t(value_));
+  }
+
+private:
+  storage_type value_;
+};
+
+// exact binary arithmetic operators
+template <int W1, int I1, int W2, int I2>
+inline fixed<(I1 > I2 ? I1 : I2) + 1 + (W1 - I1 > W2 - I2 ? W1 - I1 : W2 - I2),
+             (I1 > I2 ? I1 : I2) + 1>
+operator+(const fixed<W1, I1> &lhs, const fixed<W2, I2> &rhs) {
+  using R = decltype(lhs + rhs);
+  return R::from_bits(typename R::storage_type(
+      internal::shift_left(lhs.to_bits(), R::frac_bits - (W1 - I1)) +
+      internal::shift_left(rhs.to_bits(), R::frac_bits - (W2 - I2))));
+}
+template <int W1, int I1, int W2, int I2>
+inline auto operator-(const fixed<W1, I1> &lhs, const fixed<W2, I2> &rhs)
+    -> decltype(lhs + rhs) {
+  using R = decltype(lhs + rhs);
+  return R::from_bits(typename R::storage_type(
+      internal::shift_left(lhs.to_bits(), R::frac_bits - (W1 - I1)) -
+      internal::shift_left(rhs.to_bits(), R::frac_bits - (W2 - I2))));
+}
+template <int W1, int I1, int W2, int I2>
+inline fixed<W1 + W2, I1 + I2> operator*(const fixed<W1, I1> &lhs,
+                                         const fixed<W2, I2> &rhs) {
+  return fixed<W1 + W2, I1 + I2>::from_bits(
+      typename fixed<W1 + W2, I1 + I2>::storage_type(int64_t(lhs.to_bits()) *
+                                                     rhs.to_bits()));
+}
+
+// comparison operators, computed on the exact difference
+#define DEFINE_OP(op)                                                          \
+  template <int W1, int I1, int W2, int I2>                                    \
+  inline bool operator op(const fixed<W1, I1> &lhs,                            \
+                          const fixed<W2, I2> &rhs) {                          \
+    return (lhs - rhs).to_bits() op 0;                                         \
+  }
+DEFINE_OP(==)
+DEFINE_OP(!=)
+DEFINE_OP(<)
+DEFINE_OP(<=)
+DEFINE_OP(>)
+DEFINE_OP(>=)
+#undef DEFINE_OP
+
+// operators with a floating-point or integer operand, which is converted to
+// the type of the other operand first
+#define DEFINE_OP(op)                                                          \
+  template <int W, int I, typename T,                                          \
+            typename = typename std::enable_if<                                \
+                std::is_arithmetic<T>::value>::type>                           \
+  inline auto operator op(const fixed<W, I> &lhs, const T &rhs)                \
+      -> decltype(lhs op lhs) {                                                \
+    return lhs op fixed<W, I>(rhs);                                            \
+  }                                                                            \
+  template <int W, int I, typename T,                                          \
+            typename = typename std::enable_if<                                \
+                std::is_arithmetic<T>::value>::type>                           \
+  inline auto operator op(const T &lhs, const fixed<W, I> &rhs)                \
+      -> decltype(rhs op rhs) {                                                \
+    return fixed<W, I>(lhs) op rhs;                                            \
+  }
+DEFINE_OP(+)
+DEFINE_OP(-)
+DEFINE_OP(*)
+DEFINE_OP(==)
+DEFINE_OP(!=)
+DEFINE_OP(<)
+DEFINE_OP(<=)
+DEFINE_OP(>)
+DEFINE_OP(>=)
+#undef DEFINE_OP
+
+template <int W, int I>
+inline std::ostream &operator<<(std::ostream &os, const fixed<W, I> &obj) {
+  return os << double(obj);
+}
+
+namespace internal {
+
+#ifndef __SYNTHESIS__
+// Conversions of registers of L lanes between float and the bits of Format.
+template <float16_format Format> struct float16_reg {
+  template <int L>
+  static math::reg_t<float, L> widen(math::reg_t<uint16_t, L> h) {
+    using U = math::reg_t<uint32_t, L>;
+    return Format == kBinary16
+               ? half_to_float<math::reg_t<float, L>>(
+                     __builtin_convertvector(h, U))
+               : bfloat16_to_float<math::reg_t<float, L>>(
+                     __builtin_convertvector(h, U));
+  }
+  template <int L>
+  static math::reg_t<uint16_t, L> narrow(math::reg_t<float, L> f) {
+    using U = math::reg_t<uint32_t, L>;
+    return __builtin_convertvector(Format == kBinary16
+                                       ? float_to_half<U>(f)
+                                       : float_to_bfloat16<U>(f),
+                                   math::reg_t<uint16_t, L>);
+  }
+};
+#define DEFINE_CONVERSION(lanes, widen_func, narrow_func, half_type,          \
+                          float_type)                                          \
+  template <>                                                                  \
+  template <>                                                                  \
+  inline math::reg_t<float, lanes> float16_reg<kBinary16>::widen<lanes>(       \
+      math::reg_t<uint16_t, lanes> h) {                                        \
+    return bit_cast<math::reg_t<float, lanes>>(                                \
+        widen_func(bit_cast<half_type>(h)));                                   \
+  }                                                                            \
+  template <>                                                                  \
+  template <>                                                                  \
+  inline math::reg_t<uint16_t, lanes> float16_reg<kBinary16>::narrow<lanes>(   \
+      math::reg_t<float, lanes> f) {                                           \
+    return bit_cast<math::reg_t<uint16_t, lanes>>(                             \
+        narrow_func(bit_cast<float_type>(f)));                                 \
+  }
+#ifdef __AVX512F__
+// _mm512_cvtph_ps and _mm512_cvtps_ph trigger spurious -Wuninitialized
+// warnings on GCC 12, which the zero-masking versions do not
+inline __m512 cvtph_ps512(__m256i h) {
+  return _mm512_maskz_cvtph_ps(__mmask16(-1), h);
+}
+inline __m256i cvtps_ph512(__m512 f) {
+  return _mm512_maskz_cvtps_ph(__mmask16(-1), f, _MM_FROUND_TO_NEAREST_INT);
+}
+DEFINE_CONVERSION(16, cvtph_ps512, cvtps_ph512, __m256i, __m512)
+#endif // __AVX512F__
+#ifdef __F16C__
+inline __m128i cvtps_ph256(__m256 f) {
+  return _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+}
+DEFINE_CONVERSION(8, _mm256_cvtph_ps, cvtps_ph256, __m128i, __m256)
+#endif // __F16C__
+#undef DEFINE_CONVERSION
+#endif // __SYNTHESIS__
+
+template <float16_format Format, int N>
+inline void widen_lanes(const float16<Format> *in, float *out,
+                        std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = in[i];
+  }
+}
+
+template <float16_format Format, int N>
+inline void narrow_lanes(const float *in, float16<Format> *out,
+                         std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = in[i];
+  }
+}
+
+#ifndef __SYNTHESIS__
+// Processes simd_lanes<float, N>() lanes per register, then the rest one by
+// one.
+template <float16_format Format, int N>
+inline void widen_lanes(const float16<Format> *in, float *out,
+                        std::true_type) {
+  constexpr int L = simd_lanes<float, N>();
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    math::reg_t<uint16_t, L> h;
+    memcpy(&h, static_cast<const void *>(in + i), sizeof(h));
+    const math::reg_t<float, L> f =
+        float16_reg<Format>::template widen<L>(h);
+    memcpy(out + i, &f, sizeof(f));
+  }
+  for (; i < N; ++i) {
+    out[i] = in[i];
+  }
+}
+
+template <float16_format Format, int N>
+inline void narrow_lanes(const float *in, float16<Format> *out,
+                         std::true_type) {
+  constexpr int L = simd_lanes<float, N>();
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    math::reg_t<float, L> f;
+    memcpy(&f, in + i, sizeof(f));
+    const math::reg_t<uint16_t, L> h =
+        float16_reg<Format>::template narrow<L>(f);
+    memcpy(static_cast<void *>(out + i), &h, sizeof(h));
+  }
+  for (; i < N; ++i) {
+    out[i] = in[i];
+  }
+}
+#endif // __SYNTHESIS__
+
+template <float16_format Format> struct lane_converter<float16<Format>, float> {
+  template <int N, typename In, typename Out>
+  static void convert(const In &in, Out &out) {
+    _Pragma("HLS inline");
+    widen_lanes<Format, N>(
+        &in[0], &out[0],
+        std::integral_constant<bool, (simd_lanes<float, N>() > 0)>());
+  }
+};
+
+template <float16_format Format> struct lane_converter<float, float16<Format>> {
+  template <int N, typename In, typename Out>
+  static void convert(const In &in, Out &out) {
+    _Pragma("HLS inline");
+    narrow_lanes<Format, N>(
+        &in[0], &out[0],
+        std::integral_constant<bool, (simd_lanes<float, N>() > 0)>());
+  }
+};
+
+// Whether conversions between vec_t<fixed<W, I>, N> and vec_t<float, N> are
+// vectorized; lanes of at most 16 bits are exact in float.
+template <int W, int N>
+struct is_simd_fixed
+    : std::integral_constant<bool, (simd_lanes<float, N>() > 0 && W <= 16)> {
+};
+
+template <int W, int I, int N>
+inline void widen_lanes(const fixed<W, I> *in, float *out, std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = float(in[i]);
+  }
+}
+
+template <int W, int I, int N>
+inline void narrow_lanes(const float *in, fixed<W, I> *out, std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = in[i];
+  }
+}
+
+#ifndef __SYNTHESIS__
+template <int W, int I, int N>
+inline void widen_lanes(const fixed<W, I> *in, float *out, std::true_type) {
+  constexpr int L = simd_lanes<float, N>();
+  using S = typename fixed<W, I>::storage_type;
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    math::reg_t<S, L> raw;
+    memcpy(&raw, static_cast<const void *>(in + i), sizeof(raw));
+    const math::reg_t<float, L> f =
+        __builtin_convertvector(raw, math::reg_t<float, L>) *
+        std::ldexp(1.f, -fixed<W, I>::frac_bits);
+    memcpy(out + i, &f, sizeof(f));
+  }
+  for (; i < N; ++i) {
+    out[i] = float(in[i]);
+  }
+}
+
+// Rounds like the scalar conversion, with the value scaled exactly in float.
+template <int W, int I, int N>
+inline void narrow_lanes(const float *in, fixed<W, I> *out, std::true_type) {
+  constexpr int L = simd_lanes<float, N>();
+  using S = typename fixed<W, I>::storage_type;
+  using R = math::reg_t<float, L>;
+  using IR = math::reg_t<int32_t, L>;
+  const float max = float(max_int<W>());
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    R y;
+    memcpy(&y, in + i, sizeof(y));
+    y *= std::ldexp(1.f, fixed<W, I>::frac_bits);
+    // saturated first, so that conversions to integers are in range; NaNs
+    // fail both comparisons and are replaced by zero
+    y = y > max ? R{} + max : y < -max - 1 ? R{} - max - 1 : y;
+    y = y == y ? y : R{};
+    // truncated toward zero, then floored; comparisons are -1 if true
+    IR n = __builtin_convertvector(y, IR);
+    R floored = __builtin_convertvector(n, R);
+    const IR is_below = floored > y;
+    n += is_below;
+    floored = is_below ? floored - 1 : floored;
+    n -= y - floored >= .5f;
+    const math::reg_t<S, L> raw =
+        __builtin_convertvector(n, math::reg_t<S, L>);
+    memcpy(static_cast<void *>(out + i), &raw, sizeof(raw));
+  }
+  for (; i < N; ++i) {
+    out[i] = in[i];
+  }
+}
+#endif // __SYNTHESIS__
+
+template <int W, int I> struct lane_converter<fixed<W, I>, float> {
+  template <int N, typename In, typename Out>
+  static void convert(const In &in, Out &out) {
+    _Pragma("HLS inline");
+    widen_lanes<W, I, N>(&in[0], &out[0], is_simd_fixed<W, N>());
+  }
+};
+
+template <int W, int I> struct lane_converter<float, fixed<W, I>> {
+  template <int N, typename In, typename Out>
+  static void convert(const In &in, Out &out) {
+    _Pragma("HLS inline");
+    narrow_lanes<W, I, N>(&in[0], &out[0], is_simd_fixed<W, N>());
+  }
+};
+
+// Returns the raw bits of each lane as 64-bit integers.
+template <int W, int I, int N>
+inline vec_t<int64_t, N> to_raw(const vec_t<fixed<W, I>, N> &vec) {
+  vec_t<int64_t, N> result;
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    result.set(i, vec[i].to_bits());
+  }
+  return result;
+}
+
+} // namespace internal
+
+// return the sum or dot product of lanes, accumulated in float
+template <internal::float16_format Format, int N>
+inline float sum(const vec_t<internal::float16<Format>, N> &vec) {
+  _Pragma("HLS inline");
+  return sum(static_cast<vec_t<float, N>>(vec));
+}
+template <internal::float16_format Format, int N>
+inline float dot(const vec_t<internal::float16<Format>, N> &lhs,
+                 const vec_t<internal::float16<Format>, N> &rhs) {
+  _Pragma("HLS inline");
+  return dot(static_cast<vec_t<float, N>>(lhs),
+             static_cast<vec_t<float, N>>(rhs));
+}
+
+// return the exact sum or dot product of lanes, with enough integer bits
+template <int W, int I, int N>
+inline fixed<W + internal::ceil_log2(N), I + internal::ceil_log2(N)>
+sum(const vec_t<fixed<W, I>, N> &vec) {
+  _Pragma("HLS inline");
+  using R = fixed<W + internal::ceil_log2(N), I + internal::ceil_log2(N)>;
+  return R::from_bits(
+      typename R::storage_type(sum(internal::to_raw(vec))));
+}
+template <int W, int I, int N>
+inline fixed<2 * W + internal::ceil_log2(N), 2 * I + internal::ceil_log2(N)>
+dot(const vec_t<fixed<W, I>, N> &lhs, const vec_t<fixed<W, I>, N> &rhs) {
+  _Pragma("HLS inline");
+  using R =
+      fixed<2 * W + internal::ceil_log2(N), 2 * I + internal::ceil_log2(N)>;
+  return R::from_bits(typename R::storage_type(
+      dot(internal::to_raw(lhs), internal::to_raw(rhs))));
+}
+
+} // namespace task
+
+#endif // TASK_NUMERIC_H_
@@ -0,0 +1,480 @@
+#ifndef TASK_PACKED_H_
+#define TASK_PACKED_H_
+
+#include <climits>
+#include <cstdint>
+
+#include <ostream>
+#include <type_traits>
+
+#include "task/vec.h"
+
+namespace task {
+
+namespace internal {
+
+// Smallest integer type of at least W bits.
+template <int W, bool IsSigned>
+using narrow_storage = typename std::conditional<
+    W <= 8, typename std::conditional<IsSigned, int8_t, uint8_t>::type,
+    typename std::conditional<
+        W <= 16, typename std::conditional<IsSigned, int16_t, uint16_t>::type,
+        typename std::conditional<
+            W <= 32,
+            typename std::conditional<IsSigned, int32_t, uint32_t>::type,
+            typename std::conditional<IsSigned, int64_t,
+                                      uint64_t>::type>::type>::type>::type;
+
+// Returns the lowest W bits of val, with all other bits set to 0.
+template <int W> constexpr uint64_t low_bits(uint64_t val) {
+  return W >= 64 ? val : val & ((uint64_t(1) << (W % 64)) - 1);
+}
+
+// Returns the lowest W bits of val, with all other bits set to bit W - 1.
+template <int W> constexpr int64_t sign_extend(uint64_t val) {
+  return W >= 64 ? int64_t(val)
+                 : int64_t(val << (64 - W) % 64) >> (64 - W) % 64;
+}
+
+// Integer of W bits, stored in the smallest integer type that fits; see
+// task::uint_t and task::int_t.
+template <int W, bool IsSigned> class narrow_int {
+  static_assert(W >= 1 && W <= 64, "width must be in [1, 64]");
+
+public:
+  static constexpr int width = W;
+
+  using storage_type = narrow_storage<W, IsSigned>;
+  using wide_type =
+      typename std::conditional<IsSigned, int64_t, uint64_t>::type;
+
+  narrow_int() = default;
+
+  // wraps around modulo 2^W
+  constexpr narrow_int(wide_type val)
+      : value_(IsSigned ? storage_type(sign_extend<W>(val))
+                        : storage_type(low_bits<W>(val))) {}
+
+  constexpr operator storage_type() const { return value_; }
+
+  // assignment operators
+#define DEFINE_OP(op)                                                          \
+  narrow_int &operator op##=(wide_type rhs) {                                  \
+    return *this = narrow_int(wide_type(value_) op rhs);                       \
+  }
+  DEFINE_OP(+)
+  DEFINE_OP(-)
+  DEFINE_OP(*)
+  DEFINE_OP(/)
+  DEFINE_OP(%)
+  DEFINE_OP(&)
+  DEFINE_OP(|)
+  DEFINE_OP(^)
+  DEFINE_OP(<<)
+  DEFINE_OP(>>)
+#undef DEFINE_OP
+
+  // increment and decrement operators
+  narrow_int &operator++() { return *this += 1; }
+  narrow_int &operator--() { return *this -= 1; }
+  narrow_int operator++(int) {
+    narrow_int old = *this;
+    ++*this;
+    return old;
+  }
+  narrow_int operator--(int) {
+    narrow_int old = *this;
+    --*this;
+    return old;
+  }
+
+private:
+  storage_type value_;
+};
+
+// Prints the value as a number, even if it is stored in a char type.
+template <int W, bool IsSigned>
+inline std::ostream &operator<<(std::ostream &os,
+                                const narrow_int<W, IsSigned> &obj) {
+  return os << typename narrow_int<W, IsSigned>::wide_type(obj);
+}
+
+// Whether T can be broadcast to the lanes of a packed vec_t.
+template <typename T> struct is_narrow_scalar : std::is_arithmetic<T> {};
+template <int W, bool IsSigned>
+struct is_narrow_scalar<narrow_int<W, IsSigned>> : std::true_type {};
+
+// Smallest unsigned integer type that holds all bits of a packed vec_t, or
+// uint64_t if the bits are spread across multiple words.
+template <int Bits>
+using packed_word = typename std::conditional<
+    Bits <= 8, uint8_t,
+    typename std::conditional<
+        Bits <= 16, uint16_t,
+        typename std::conditional<Bits <= 32, uint32_t,
+                                  uint64_t>::type>::type>::type;
+
+// Returns a word in which the lowest W bits of pattern are repeated n times.
+template <int W> constexpr uint64_t repeat_bits(uint64_t pattern, int n) {
+  return n == 0 ? 0 : pattern | repeat_bits<W>(pattern, n - 1) << W % 64;
+}
+
+} // namespace internal
+
+/// Unsigned integer of @c W bits, with @c W in <tt>[1, 64]</tt>.
+///
+/// A @c task::uint_t converts to and from the smallest built-in unsigned
+/// integer type that holds @c W bits, in which arithmetic is carried out, and
+/// wraps around modulo 2^W when assigned. @c task::widthof reports @c W, and
+/// <tt>task::vec_t<task::uint_t<W>, N></tt> packs its lanes at @c W bits each,
+/// e.g., 21 3-bit lanes in 8 bytes.
+template <int W> using uint_t = internal::narrow_int<W, false>;
+
+/// Signed integer of @c W bits in two's complement, with @c W in
+/// <tt>[1, 64]</tt>.
+///
+/// Same as @c task::uint_t, except that values are sign-extended from bit
+/// <tt>W - 1</tt>.
+template <int W> using int_t = internal::narrow_int<W, true>;
+
+/// Vector of @c N integers of @c W bits each, packed into machine words.
+///
+/// Each word holds as many whole lanes as fit, so that lanes never straddle
+/// words; lanes of a vector of at most 64 bits share a single word of the
+/// smallest fitting size. Addition, subtraction, bitwise operators, and
+/// equality operate on whole words, computing all lanes of a word at once
+/// (SIMD within a register); other operators are computed lane by lane.
+///
+/// Lanes are accessed by value or via a proxy @c reference, so functions that
+/// take the address of a lane, e.g., @c task::sum, are not available; convert
+/// to an unpacked @c task::vec_t first, e.g.,
+/// <tt>static_cast<task::vec_t<uint16_t, N>>(vec)</tt>.
+template <int W, bool IsSigned, int N>
+struct vec_t<internal::narrow_int<W, IsSigned>, N> {
+private:
+  using word_t = internal::packed_word<W * N>;
+  static constexpr int kWordBits = sizeof(word_t) * CHAR_BIT;
+  static constexpr int kLanesPerWord = kWordBits / W;
+  static constexpr int kWordCount = (N - 1) / kLanesPerWord + 1;
+
+  // lowest W bits
+  static constexpr uint64_t kLaneMask = internal::low_bits<W>(~uint64_t(0));
+  // lowest and highest bit of each lane of a word
+  static constexpr uint64_t kLow =
+      internal::repeat_bits<W>(uint64_t(1), kLanesPerWord);
+  static constexpr uint64_t kHigh = kLow << (W - 1);
+
+public:
+  using value_type = internal::narrow_int<W, IsSigned>;
+  using size_type = int;
+
+  // static constexpr metadata
+  static constexpr int length = N;
+  static constexpr int width = W * N;
+
+  /// Proxy of a lane returned by the non-const <tt>operator[]</tt>.
+  class reference {
+  public:
+    operator value_type() const { return vec_->get(pos_); }
+    operator typename value_type::storage_type() const {
+      return vec_->get(pos_);
+    }
+    reference &operator=(const value_type &val) {
+      vec_->set(pos_, val);
+      return *this;
+    }
+    reference &operator=(const reference &other) {
+      return *this = other.vec_->get(other.pos_);
+    }
+
+  private:
+    friend struct vec_t;
+    reference(vec_t *vec, size_type pos) : vec_(vec), pos_(pos) {}
+    vec_t *vec_;
+    size_type pos_;
+  };
+
+  // single-element getter and setter
+  constexpr value_type operator[](size_type pos) const { return get(pos); }
+  reference operator[](size_type pos) { return reference(this, pos); }
+  constexpr value_type get(size_type pos) const {
+    return value_type(typename value_type::wide_type(
+        uint64_t(words_[pos / kLanesPerWord]) >> get_shift(pos) & kLaneMask));
+  }
+  void set(size_type pos, const value_type &value) {
+    _Pragma("HLS inline");
+    word_t &word = words_[pos / kLanesPerWord];
+    const int shift = get_shift(pos);
+    word = word_t((word & ~(kLaneMask << shift)) |
+                  (uint64_t(value) & kLaneMask) << shift);
+  }
+
+  // all-element setter
+  void set(value_type val) { *this = val; }
+
+  // all-element assignment operator
+  vec_t &operator=(value_type val) {
+    _Pragma("HLS inline");
+    const word_t word = word_t(kLow * (uint64_t(val) & kLaneMask));
+    for (int i = 0; i < kWordCount; ++i) {
+      _Pragma("HLS unroll");
+      words_[i] = word;
+    }
+    return *this;
+  }
+
+  // static cast to vec_t of another type
+  template <typename U> explicit operator vec_t<U, N>() const {
+    vec_t<U, N> result;
+    for (size_type i = 0; i < N; ++i) {
+      result.set(i, static_cast<U>(get(i)));
+    }
+    return result;
+  }
+
+// binary arithmetic operators computed on whole words
+#define DEFINE_OP(op, expr)                                                    \
+  vec_t operator op(const vec_t &rhs) const {                                  \
+    _Pragma("HLS inline");                                                     \
+    vec_t result;                                                              \
+    for (int i = 0; i < kWordCount; ++i) {                                     \
+      _Pragma("HLS unroll");                                                   \
+      const uint64_t a = words_[i];                                            \
+      const uint64_t b = rhs.words_[i];                                        \
+      result.words_[i] = word_t(expr);                                         \
+    }                                                                          \
+    return result;                                                             \
+  }
+  // lanes are added without their highest bits, so no carry crosses lanes,
+  // and the highest bits are added back without carry
+  DEFINE_OP(+, ((a & ~kHigh) + (b & ~kHigh)) ^ ((a ^ b) & kHigh))
+  DEFINE_OP(-, ((a | kHigh) - (b & ~kHigh)) ^ ((a ^ ~b) & kHigh))
+  DEFINE_OP(&, a & b)
+  DEFINE_OP(|, a | b)
+  DEFINE_OP(^, a ^ b)
+#undef DEFINE_OP
+
+// binary arithmetic operators computed lane by lane
+#define DEFINE_OP(op, name)                                                    \
+  vec_t operator op(const vec_t &rhs) const {                                  \
+    _Pragma("HLS inline");                                                     \
+    return apply(rhs, internal::name());                                       \
+  }
+  DEFINE_OP(*, multiplies_op)
+  DEFINE_OP(/, divides_op)
+  DEFINE_OP(%, modulus_op)
+  DEFINE_OP(<<, shift_left_op)
+  DEFINE_OP(>>, shift_right_op)
+#undef DEFINE_OP
+
+// binary arithmetic operators with a scalar, which is broadcast to all lanes
+#define DEFINE_OP(op)                                                          \
+  template <typename T2>                                                       \
+  typename std::enable_if<internal::is_narrow_scalar<T2>::value, vec_t>::type  \
+  operator op(const T2 &rhs) const {                                           \
+    _Pragma("HLS inline");                                                     \
+    return *this op broadcast(rhs);                                            \
+  }
+  DEFINE_OP(+)
+  DEFINE_OP(-)
+  DEFINE_OP(*)
+  DEFINE_OP(/)
+  DEFINE_OP(%)
+  DEFINE_OP(&)
+  DEFINE_OP(|)
+  DEFINE_OP(^)
+#undef DEFINE_OP
+
+  // shifts all lanes by the same amount, which must be in [0, W); unsigned
+  // lanes are shifted as whole words
+#define DEFINE_OP(op, expr)                                                    \
+  vec_t operator op(int rhs) const {                                           \
+    _Pragma("HLS inline");                                                     \
+    if (IsSigned) {                                                            \
+      return *this op broadcast(rhs);                                          \
+    }                                                                          \
+    vec_t result;                                                              \
+    for (int i = 0; i < kWordCount; ++i) {                                     \
+      _Pragma("HLS unroll");                                                   \
+      const uint64_t a = words_[i];                                            \
+      result.words_[i] = word_t(expr);                                         \
+    }                                                                          \
+    return result;                                                             \
+  }
+  DEFINE_OP(<<, (a << rhs) & kLow * (kLaneMask << rhs & kLaneMask))
+  DEFINE_OP(>>, (a >> rhs) & kLow * (kLaneMask >> rhs))
+#undef DEFINE_OP
+
+  // assignment operators
+#define DEFINE_OP(op)                                                          \
+  template <typename T2> vec_t &operator op##=(const T2 &rhs) {                \
+    _Pragma("HLS inline");                                                     \
+    return *this = *this op rhs;                                               \
+  }
+  DEFINE_OP(+)
+  DEFINE_OP(-)
+  DEFINE_OP(*)
+  DEFINE_OP(/)
+  DEFINE_OP(%)
+  DEFINE_OP(&)
+  DEFINE_OP(|)
+  DEFINE_OP(^)
+  DEFINE_OP(<<)
+  DEFINE_OP(>>)
+#undef DEFINE_OP
+
+  // unary arithmetic operators
+  vec_t operator+() const { return *this; }
+  vec_t operator-() const { return broadcast(0) - *this; }
+  vec_t operator~() const { return *this ^ value_type(~uint64_t(0)); }
+
+  // lane-wise comparison operators; equality is computed on whole words
+  vec_t<bool, N> operator==(const vec_t &rhs) const {
+    _Pragma("HLS inline");
+    return is_equal(rhs, true);
+  }
+  vec_t<bool, N> operator!=(const vec_t &rhs) const {
+    _Pragma("HLS inline");
+    return is_equal(rhs, false);
+  }
+#define DEFINE_OP(op, name)                                                    \
+  vec_t<bool, N> operator op(const vec_t &rhs) const {                         \
+    _Pragma("HLS inline");                                                     \
+    return compare(rhs, internal::name());                                     \
+  }
+  DEFINE_OP(<, less_op)
+  DEFINE_OP(<=, less_equal_op)
+  DEFINE_OP(>, greater_op)
+  DEFINE_OP(>=, greater_equal_op)
+#undef DEFINE_OP
+
+  // shift all elements by 1, put val at [N-1], and through away [0]
+  void shift(const value_type &val) {
+    for (size_type i = 1; i < N; ++i) {
+      set(i - 1, get(i));
+    }
+    set(N - 1, val);
+  }
+
+  // return true if and only if val exists
+  bool has(const value_type &val) const { return any(*this == val); }
+
+  // returns a vec_t with all lanes set to val, converted to value_type first
+  template <typename T2> static vec_t broadcast(const T2 &val) {
+    vec_t result;
+    result = value_type(typename value_type::wide_type(val));
+    return result;
+  }
+
+private:
+  word_t words_[kWordCount] = {};
+
+  static constexpr int get_shift(size_type pos) {
+    return pos % kLanesPerWord * W;
+  }
+
+  // lane j of word, in the wide type so that arithmetic does not overflow
+  static typename value_type::wide_type get_lane(uint64_t word, int j) {
+    return value_type(
+        typename value_type::wide_type(word >> (j * W) & kLaneMask));
+  }
+
+  // returns op(lhs, rhs) of each lane, iterating the lanes of each word
+  template <typename Op> vec_t apply(const vec_t &rhs, Op op) const {
+    _Pragma("HLS inline");
+    vec_t result;
+    for (int i = 0; i < kWordCount; ++i) {
+      _Pragma("HLS unroll");
+      uint64_t word = 0;
+      for (int j = 0; j < kLanesPerWord && i * kLanesPerWord + j < N; ++j) {
+        _Pragma("HLS unroll");
+        const value_type lane =
+            op(get_lane(words_[i], j), get_lane(rhs.words_[i], j));
+        word |= (uint64_t(lane) & kLaneMask) << (j * W);
+      }
+      result.words_[i] = word_t(word);
+    }
+    return result;
+  }
+
+  template <typename Op> vec_t<bool, N> compare(const vec_t &rhs, Op op) const {
+    _Pragma("HLS inline");
+    vec_t<bool, N> result;
+    for (int i = 0; i < kWordCount; ++i) {
+      _Pragma("HLS unroll");
+      for (int j = 0; j < kLanesPerWord && i * kLanesPerWord + j < N; ++j) {
+        _Pragma("HLS unroll");
+        result.set(i * kLanesPerWord + j,
+                   op(get_lane(words_[i], j), get_lane(rhs.words_[i], j)));
+      }
+    }
+    return result;
+  }
+
+  vec_t<bool, N> is_equal(const vec_t &rhs, bool val) const {
+    _Pragma("HLS inline");
+    vec_t<bool, N> result;
+    for (int i = 0; i < kWordCount; ++i) {
+      _Pragma("HLS unroll");
+      // the highest bit of each lane is set if the lanes differ
+      const uint64_t diff = words_[i] ^ rhs.words_[i];
+      const uint64_t ne = (((diff & ~kHigh) + ~kHigh) | diff) & kHigh;
+      for (int j = 0; j < kLanesPerWord && i * kLanesPerWord + j < N; ++j) {
+        _Pragma("HLS unroll");
+        result.set(i * kLanesPerWord + j, (ne >> (j * W + W - 1) & 1) != val);
+      }
+    }
+    return result;
+  }
+};
+
+// binary arithmetic operators, packed vector on the right-hand side
+#define DEFINE_OP(op)                                                          \
+  template <int W, bool IsSigned, int N, typename T2>                          \
+  typename std::enable_if<internal::is_narrow_scalar<T2>::value,               \
+                          vec_t<internal::narrow_int<W, IsSigned>, N>>::type   \
+  operator op(const T2 &lhs,                                                   \
+              const vec_t<internal::narrow_int<W, IsSigned>, N> &rhs) {        \
+    _Pragma("HLS inline");                                                     \
+    return vec_t<internal::narrow_int<W, IsSigned>, N>::broadcast(lhs) op rhs; \
+  }
+DEFINE_OP(+)
+DEFINE_OP(-)
+DEFINE_OP(*)
+DEFINE_OP(/)
+DEFINE_OP(%)
+DEFINE_OP(&)
+DEFINE_OP(|)
+DEFINE_OP(^)
+#undef DEFINE_OP
+
+// lane-wise comparison operators with a scalar, which is broadcast to all
+// lanes
+#define DEFINE_OP(op)                                                          \
+  template <int W, bool IsSigned, int N, typename T2>                          \
+  typename std::enable_if<internal::is_narrow_scalar<T2>::value,               \
+                          vec_t<bool, N>>::type                                \
+  operator op(const vec_t<internal::narrow_int<W, IsSigned>, N> &lhs,          \
+              const T2 &rhs) {                                                 \
+    _Pragma("HLS inline");                                                     \
+    return lhs op vec_t<internal::narrow_int<W, IsSigned>, N>::broadcast(rhs); \
+  }                                                                            \
+  template <int W, bool IsSigned, int N, typename T2>                          \
+  typename std::enable_if<internal::is_narrow_scalar<T2>::value,               \
+                          vec_t<bool, N>>::type                                \
+  operator op(const T2 &lhs,                                                   \
+              const vec_t<internal::narrow_int<W, IsSigned>, N> &rhs) {        \
+    _Pragma("HLS inline");                                                     \
+    return vec_t<internal::narrow_int<W, IsSigned>, N>::broadcast(lhs) op rhs; \
+  }
+DEFINE_OP(==)
+DEFINE_OP(!=)
+DEFINE_OP(<)
+DEFINE_OP(<=)
+DEFINE_OP(>)
+DEFINE_OP(>=)
+#undef DEFINE_OP
+
+} // namespace task
+
+#endif // TASK_PACKED_H_
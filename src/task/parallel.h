@@ -2,7 +2,9 @@
 #define TASK_PARALLEL_H_
 
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 
 namespace task {
 
@@ -10,8 +12,29 @@ enum mode { join, detach };
 
 namespace internal {
 
-void schedule(mode m, const std::function<void()> &);
-void yield(const std::string &msg);
+class base_queue;
+class task_info;
+struct region_info;
+
+// Registers a task instance invoked in `region` before its arguments are
+// resolved. `func` is only used to look up the function name in reports, and
+// instances of the same function are numbered in the order they are created
+// in the region.
+task_info *create_task(const std::shared_ptr<region_info> &region,
+                       const void *func, mode m);
+
+// Registers a runtime-internal task (e.g., the service of an async_mmap) in
+// the region of the task instance most recently created on this thread.
+task_info *create_task(const char *label, mode m);
+
+// Records that `task` produces (`is_output`) or consumes tokens of `queue`.
+void bind_channel(task_info *task, const std::shared_ptr<base_queue> &queue,
+                  bool is_output);
+
+void schedule(task_info *task, const std::function<void()> &);
+
+// Suspends the current task because `queue` is full or empty.
+void yield(const base_queue &queue, bool is_full);
 
 struct seq {
   int pos = 0;
@@ -25,6 +48,14 @@ template <typename T> struct accessor<T, seq> {
   static T access(seq &&arg) { return arg.pos++; }
 };
 
+// Records the channels carried by a resolved task argument; specialized for
+// stream and mmap parameters.
+template <typename Param> struct observer {
+  template <typename Arg> static Arg &&observe(task_info *, Arg &&arg) {
+    return std::forward<Arg>(arg);
+  }
+};
+
 } // namespace internal
 
 /// Defines a parallel task instantiating children task instances.
@@ -47,6 +78,18 @@ template <typename T> struct accessor<T, seq> {
 struct parallel {
 
   /// Constructs a @c task::parallel.
+  ///
+  /// If environment variable @c TASK_TOPOLOGY is set, the top-level
+  /// @c task::parallel writes the topology of all parallel regions to the file
+  /// it names when it finishes: task instances as nodes and channels as edges
+  /// with their measured throughput. The file is in JSON if the name ends with
+  /// <tt>.json</tt>, or in DOT otherwise.
+  ///
+  /// If environment variable @c TASK_PERF is set, each task instance is also
+  /// charged with the performance counters accumulated while it runs. Hardware
+  /// events are used if available, software events or the thread CPU clock
+  /// otherwise. The counts are logged when the top-level @c task::parallel
+  /// finishes and are included in the topology.
   parallel();
   parallel(parallel &&) = delete;
   parallel(const parallel &) = delete;
@@ -66,12 +109,20 @@ struct parallel {
   template <int n = 1, mode m = join, typename... Params, typename... Args>
   parallel &invoke(void (&func)(Params...), Args &&...args) {
     for (int i = 0; i < n; ++i) {
+      auto task = internal::create_task(
+          region_, reinterpret_cast<const void *>(&func), m);
       internal::schedule(
-          m, std::bind(func, internal::accessor<Params, Args>::access(
-                                 std::forward<Args>(args))...));
+          task,
+          std::bind(func,
+                    internal::observer<typename std::decay<Params>::type>::
+                        observe(task, internal::accessor<Params, Args>::access(
+                                          std::forward<Args>(args)))...));
     }
     return *this;
   }
+
+private:
+  std::shared_ptr<internal::region_info> region_;
 };
 
 } // namespace task
@@ -5,9 +5,11 @@
 #include <cstdint>
 #include <cstring>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -43,8 +45,19 @@ public:
   const std::string &get_name() const { return this->name; }
   void set_name(const std::string &name) { this->name = name; }
 
+  // statistics helpers; may be called from any thread
+  virtual uint64_t get_depth() const = 0;
+  virtual uint64_t get_size() const = 0;
+  virtual uint64_t get_token_count() const = 0;
+
+  // runtime hook to serve the channel inline when it is found empty or full;
+  // returns whether any progress is made
+  void set_pump(const std::function<bool()> &pump) { this->pump_func = pump; }
+  bool pump() const { return this->pump_func != nullptr && this->pump_func(); }
+
 protected:
   std::string name;
+  std::function<bool()> pump_func;
 
   base_queue(const std::string &name) : name(name) {}
 
@@ -74,7 +87,13 @@ public:
   }
 
   // debug helpers
-  uint64_t get_depth() const { return this->buffer.size(); }
+  uint64_t get_depth() const override { return this->buffer.size(); }
+  uint64_t get_size() const override {
+    // tail first so that the difference never underflows
+    const uint64_t tail = this->tail;
+    return this->head - tail;
+  }
+  uint64_t get_token_count() const override { return this->head; }
 
   // basic queue operations
   bool empty() const override { return this->head - this->tail <= 0; }
@@ -90,11 +109,60 @@ public:
     ++this->head;
   }
 
+  // batched queue operations; each publishes its elements at once and returns
+  // the number of elements processed, which is at most n
+
+  // pushes func(i) for i in [0, n) as long as the queue is not full
+  template <typename Func> uint64_t push_n(uint64_t n, Func &&func) {
+    const uint64_t head = this->head;
+    const uint64_t depth = this->buffer.size();
+    n = std::min(n, depth - (head - this->tail));
+    const uint64_t begin = head % depth;
+    const uint64_t first = std::min(n, depth - begin); // before wrapping around
+    for (uint64_t i = 0; i < first; ++i) {
+      this->buffer[begin + i] = func(i);
+    }
+    for (uint64_t i = first; i < n; ++i) {
+      this->buffer[i - first] = func(i);
+    }
+    this->head = head + n;
+    return n;
+  }
+
+  // pops elements as func(i, elem) for i in [0, n) as long as not empty
+  template <typename Func> uint64_t pop_n(uint64_t n, Func &&func) {
+    const uint64_t tail = this->tail;
+    const uint64_t depth = this->buffer.size();
+    n = std::min(n, this->head - tail);
+    const uint64_t begin = tail % depth;
+    const uint64_t first = std::min(n, depth - begin); // before wrapping around
+    for (uint64_t i = 0; i < first; ++i) {
+      func(i, this->buffer[begin + i]);
+    }
+    for (uint64_t i = first; i < n; ++i) {
+      func(i, this->buffer[i - first]);
+    }
+    this->tail = tail + n;
+    return n;
+  }
+
+  // visits elements as func(i, elem) for i in [0, n) without popping them
+  template <typename Func> uint64_t peek_n(uint64_t n, Func &&func) const {
+    const uint64_t tail = this->tail;
+    const uint64_t depth = this->buffer.size();
+    n = std::min(n, this->head - tail);
+    for (uint64_t i = 0; i < n; ++i) {
+      func(i, this->buffer[(tail + i) % depth]);
+    }
+    return n;
+  }
+
   ~lock_free_queue() { this->check_leftover(); }
 };
 
 template <typename T> class locked_queue : public base_queue {
   size_t depth;
+  uint64_t token_count = 0;
   mutable std::mutex mtx;
   std::deque<T> buffer;
 
@@ -104,7 +172,15 @@ public:
       : base_queue(name), depth(depth) {}
 
   // debug helpers
-  uint64_t get_depth() const { return this->depth; }
+  uint64_t get_depth() const override { return this->depth; }
+  uint64_t get_size() const override {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    return this->buffer.size();
+  }
+  uint64_t get_token_count() const override {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    return this->token_count;
+  }
 
   // basic queue operations
   bool empty() const override {
@@ -128,6 +204,35 @@ public:
   void push(const T &val) {
     std::unique_lock<std::mutex> lock(this->mtx);
     this->buffer.push_back(val);
+    ++this->token_count;
+  }
+
+  // batched queue operations; see lock_free_queue
+  template <typename Func> uint64_t push_n(uint64_t n, Func &&func) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    n = std::min<uint64_t>(n, this->depth - this->buffer.size());
+    for (uint64_t i = 0; i < n; ++i) {
+      this->buffer.push_back(func(i));
+    }
+    this->token_count += n;
+    return n;
+  }
+  template <typename Func> uint64_t pop_n(uint64_t n, Func &&func) {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    n = std::min<uint64_t>(n, this->buffer.size());
+    for (uint64_t i = 0; i < n; ++i) {
+      func(i, this->buffer.front());
+      this->buffer.pop_front();
+    }
+    return n;
+  }
+  template <typename Func> uint64_t peek_n(uint64_t n, Func &&func) const {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    n = std::min<uint64_t>(n, this->buffer.size());
+    for (uint64_t i = 0; i < n; ++i) {
+      func(i, this->buffer[i]);
+    }
+    return n;
   }
 
   ~locked_queue() { this->check_leftover(); }
@@ -156,12 +261,33 @@ public:
   basic_stream &operator=(basic_stream &&) = delete;
 
 protected:
+  template <typename U>
+  friend std::shared_ptr<base_queue> get_queue(const basic_stream<U> &stream);
+  template <typename U>
+  friend queue<elem_t<U>> &get_typed_queue(const basic_stream<U> &stream);
+
   std::shared_ptr<queue<elem_t<T>>> ptr;
 };
 
+// returns the type-erased queue of a stream for runtime bookkeeping
+template <typename T>
+inline std::shared_ptr<base_queue> get_queue(const basic_stream<T> &stream) {
+  return stream.ptr;
+}
+
+// returns the queue of a stream for batched operations in the runtime
+template <typename T>
+inline queue<elem_t<T>> &get_typed_queue(const basic_stream<T> &stream) {
+  return *stream.ptr;
+}
+
 // shared pointer of multiple queues
 template <typename T> class basic_streams {
 protected:
+  template <typename U>
+  friend std::vector<std::shared_ptr<base_queue>>
+  get_queues(const basic_streams<U> &streams);
+
   basic_streams(const std::shared_ptr<std::vector<basic_stream<T>>> &ptr)
       : ptr(ptr) {}
   basic_streams(const basic_streams &) = default;
@@ -172,6 +298,19 @@ protected:
   std::shared_ptr<std::vector<basic_stream<T>>> ptr;
 };
 
+// returns the type-erased queues of a stream array for runtime bookkeeping
+template <typename T>
+inline std::vector<std::shared_ptr<base_queue>>
+get_queues(const basic_streams<T> &streams) {
+  std::vector<std::shared_ptr<base_queue>> queues;
+  if (streams.ptr != nullptr) {
+    for (const auto &stream : *streams.ptr) {
+      queues.push_back(get_queue(stream));
+    }
+  }
+  return queues;
+}
+
 // stream without a bound depth; can be default-constructed by a derived class
 template <typename T>
 class unbound_stream : public istream<T>, public ostream<T> {
@@ -179,6 +318,13 @@ protected:
   unbound_stream() : basic_stream<T>(nullptr) {}
 };
 
+// stream whose depth is only known at runtime
+template <typename T> class dynamic_stream : public unbound_stream<T> {
+public:
+  dynamic_stream(uint64_t depth, const std::string &name)
+      : basic_stream<T>(std::make_shared<queue<elem_t<T>>>(depth, name)) {}
+};
+
 // streams without a bound depth; can be default-constructed by a derived class
 template <typename T, int S>
 class unbound_streams : public istreams<T, S>, public ostreams<T, S> {
@@ -202,8 +348,11 @@ public:
   /// @return Whether the stream is empty.
   bool empty() const {
     bool is_empty = this->ptr->empty();
+    if (is_empty && this->ptr->pump()) {
+      is_empty = this->ptr->empty();
+    }
     if (is_empty) {
-      internal::yield("channel '" + this->get_name() + "' is empty");
+      internal::yield(*this->ptr, /*is_full=*/false);
     }
     return is_empty;
   }
@@ -470,8 +619,11 @@ public:
   /// @return Whether the stream is full.
   bool full() const {
     bool is_full = this->ptr->full();
+    if (is_full && this->ptr->pump()) {
+      is_full = this->ptr->full();
+    }
     if (is_full) {
-      internal::yield("channel '" + this->get_name() + "' is full");
+      internal::yield(*this->ptr, /*is_full=*/true);
     }
     return is_full;
   }
@@ -824,6 +976,38 @@ TASK_DEFINE_ACCESSER(o, &&)
 
 #undef TASK_DEFINE_ACCESSER
 
+template <typename T> struct observer<istream<T>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    bind_channel(task, get_queue(arg), /*is_output=*/false);
+    return std::forward<Arg>(arg);
+  }
+};
+
+template <typename T> struct observer<ostream<T>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    bind_channel(task, get_queue(arg), /*is_output=*/true);
+    return std::forward<Arg>(arg);
+  }
+};
+
+template <typename T, uint64_t S> struct observer<istreams<T, S>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    for (const auto &queue : get_queues(arg)) {
+      bind_channel(task, queue, /*is_output=*/false);
+    }
+    return std::forward<Arg>(arg);
+  }
+};
+
+template <typename T, uint64_t S> struct observer<ostreams<T, S>> {
+  template <typename Arg> static Arg &&observe(task_info *task, Arg &&arg) {
+    for (const auto &queue : get_queues(arg)) {
+      bind_channel(task, queue, /*is_output=*/true);
+    }
+    return std::forward<Arg>(arg);
+  }
+};
+
 } // namespace internal
 
 } // namespace task
@@ -0,0 +1,115 @@
+#ifndef TASK_TRACE_H_
+#define TASK_TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+namespace task {
+
+/// Format of the memory access trace.
+///
+/// The trace is written to the file named by environment variable
+/// @c TASK_TRACE when the top-level @c task::parallel finishes. It records
+/// every burst served by @c task::async_mmap and, if compiled with
+/// @c TASK_TRACE_MMAP defined, every element accessed via
+/// <tt>task::mmap::operator[]</tt>. Tools such as @c tracestat decode it.
+///
+/// The file starts with @c kMagic, followed by sections each starting with a
+/// tag byte:
+///   - @c kChunkTag, varint byte count, then records of one thread, each
+///     encoded by @c encode relative to the previous record of the chunk;
+///   - @c kTaskTag, varint count, then (varint id, varint length, name)s;
+///   - @c kBankTag, varint count, then (varint id, varint base address)s.
+namespace trace {
+
+constexpr char kMagic[8] = {'t', 'a', 's', 'k', 't', 'r', 'c', '1'};
+constexpr char kChunkTag = 'C';
+constexpr char kTaskTag = 'T';
+constexpr char kBankTag = 'B';
+
+enum access_kind : uint8_t {
+  kRead = 0,
+  kWrite = 1,
+  kAccess = 2, // either read or written, e.g., via task::mmap::operator[]
+};
+
+struct record {
+  uint64_t task = 0;         // id of the task instance in the task table
+  uint64_t bank = 0;         // id of the memory in the bank table
+  uint64_t offset = 0;       // in bytes from the start of the bank
+  uint64_t size = 0;         // in bytes
+  uint64_t timestamp_ns = 0; // CLOCK_MONOTONIC
+  access_kind kind = kRead;
+};
+
+inline void put_varint(std::string &buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(char(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(char(value));
+}
+
+/// @return Whether a complete varint is read.
+inline bool get_varint(const char *&ptr, const char *end, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; ptr < end && shift < 64; shift += 7) {
+    const uint8_t byte = *ptr++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Appends @c curr to @c buffer as deltas from @c prev, which is zero for the
+/// first record of a chunk; consecutive accesses thus take a few bytes each.
+inline void encode(const record &prev, const record &curr,
+                   std::string &buffer) {
+  const int64_t offset_delta = curr.offset - prev.offset;
+  put_varint(buffer, curr.timestamp_ns - prev.timestamp_ns);
+  put_varint(buffer, curr.task);
+  put_varint(buffer, curr.bank);
+  put_varint(buffer, (uint64_t(offset_delta) << 1) ^ (offset_delta >> 63));
+  put_varint(buffer, curr.size << 2 | curr.kind);
+}
+
+/// Decodes the record following @c prev and stores it in @c prev.
+///
+/// @return Whether a complete record is decoded.
+inline bool decode(const char *&ptr, const char *end, record &prev) {
+  uint64_t time_delta, task, bank, offset_delta, size_kind;
+  if (!get_varint(ptr, end, time_delta) || !get_varint(ptr, end, task) ||
+      !get_varint(ptr, end, bank) || !get_varint(ptr, end, offset_delta) ||
+      !get_varint(ptr, end, size_kind)) {
+    return false;
+  }
+  prev.timestamp_ns += time_delta;
+  prev.task = task;
+  prev.bank = bank;
+  prev.offset += (offset_delta >> 1) ^ -(offset_delta & 1);
+  prev.size = size_kind >> 2;
+  prev.kind = access_kind(size_kind & 3);
+  return true;
+}
+
+} // namespace trace
+
+namespace internal {
+
+// Whether memory accesses are being traced.
+bool is_tracing();
+
+// Records an access of the current task to `size` bytes at `offset` of the
+// memory starting at `base`; ignored outside tasks or if not tracing.
+void trace_access(const void *base, uint64_t offset, uint64_t size,
+                  trace::access_kind kind);
+
+} // namespace internal
+
+} // namespace task
+
+#endif // TASK_TRACE_H_
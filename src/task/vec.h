@@ -10,11 +10,469 @@
 #include <array>
 #include <functional>
 #include <ostream>
+#include <type_traits>
 
 #include "task/util.h"
 
 namespace task {
 
+namespace internal {
+
+// Width of the SIMD registers targeted by vec_t operators (in bytes), selected
+// by the ISA the host compiler is targeting, e.g., via -march. 0 disables SIMD,
+// which is always the case for HLS and if TASK_USE_SCALAR_VEC is defined.
+#if defined(__SYNTHESIS__) || defined(TASK_USE_SCALAR_VEC)
+constexpr int kSimdBytes = 0;
+#elif defined(__AVX512F__)
+constexpr int kSimdBytes = 64;
+#elif defined(__AVX__)
+constexpr int kSimdBytes = 32;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+constexpr int kSimdBytes = 16;
+#else
+constexpr int kSimdBytes = 0;
+#endif
+
+// Name of the ISA targeted by vec_t operators.
+inline const char *get_simd_isa() {
+  return kSimdBytes == 64   ? "avx512"
+         : kSimdBytes == 32 ? "avx"
+         : kSimdBytes == 16 ? "sse2/neon"
+                            : "scalar";
+}
+
+// Largest power of two not greater than n, or n if n < 2.
+constexpr int floor_pow2(int n) { return n < 2 ? n : 2 * floor_pow2(n / 2); }
+
+// Bytes of the SIMD register holding the lanes of vec_t<T, N>.
+template <typename T, int N> constexpr int simd_bytes() {
+  return kSimdBytes < floor_pow2(N * sizeof(T)) ? kSimdBytes
+                                                : floor_pow2(N * sizeof(T));
+}
+
+// Lanes of vec_t<T, N> processed per SIMD register; 0 if not vectorized.
+template <typename T, int N> constexpr int simd_lanes() {
+  return !std::is_arithmetic<T>::value || std::is_same<T, bool>::value ||
+                 sizeof(T) > 8 || simd_bytes<T, N>() < int(2 * sizeof(T))
+             ? 0
+             : simd_bytes<T, N>() / sizeof(T);
+}
+
+#ifndef __SYNTHESIS__
+// GCC/Clang vector extension type of L lanes of T.
+template <typename T, int L> struct simd_reg {
+  typedef T type __attribute__((vector_size(L * sizeof(T))));
+};
+
+// Signed integer lane of the given size, which is the lane type of comparison
+// results of SIMD registers.
+template <int Bytes> struct mask_lane;
+template <> struct mask_lane<1> { using type = int8_t; };
+template <> struct mask_lane<2> { using type = int16_t; };
+template <> struct mask_lane<4> { using type = int32_t; };
+template <> struct mask_lane<8> { using type = int64_t; };
+#endif // __SYNTHESIS__
+
+// Which lane types an operator is vectorized for.
+enum simd_kind { kSimdNone, kSimdAll, kSimdIntegral, kSimdFloating };
+
+// Whether `vec_t<T, N> op rhs` is vectorized, where Rhs is `const T2 *` for
+// a vector or T2 for a scalar. Vectors must have the same lane type, and
+// scalars must convert to T as the scalar operator would, so that the results
+// are identical to the scalar fallback.
+template <typename T, typename Rhs,
+          bool = std::is_arithmetic<T>::value && std::is_arithmetic<Rhs>::value>
+struct is_exact_rhs : std::is_same<Rhs, const T *> {};
+template <typename T, typename Rhs>
+struct is_exact_rhs<T, Rhs, true>
+    : std::is_same<typename std::common_type<T, Rhs>::type, T> {};
+
+template <simd_kind kind, typename T, int N, typename Rhs>
+struct simd_tag
+    : std::integral_constant<
+          bool,
+          (simd_lanes<T, N>() > 0 && is_exact_rhs<T, Rhs>::value &&
+           (kind == kSimdAll ||
+            (kind == kSimdIntegral && std::is_integral<T>::value) ||
+            (kind == kSimdFloating && std::is_floating_point<T>::value)))> {
+};
+
+// Function objects applicable to both scalars and SIMD registers.
+#define DEFINE_FUNCTOR(name, op)                                               \
+  struct name {                                                                \
+    template <typename A, typename B>                                          \
+    auto operator()(const A &a, const B &b) const -> decltype(a op b) {        \
+      return a op b;                                                           \
+    }                                                                          \
+  };
+DEFINE_FUNCTOR(plus_op, +)
+DEFINE_FUNCTOR(minus_op, -)
+DEFINE_FUNCTOR(multiplies_op, *)
+DEFINE_FUNCTOR(divides_op, /)
+DEFINE_FUNCTOR(modulus_op, %)
+DEFINE_FUNCTOR(bit_and_op, &)
+DEFINE_FUNCTOR(bit_or_op, |)
+DEFINE_FUNCTOR(bit_xor_op, ^)
+DEFINE_FUNCTOR(shift_left_op, <<)
+DEFINE_FUNCTOR(shift_right_op, >>)
+DEFINE_FUNCTOR(equal_to_op, ==)
+DEFINE_FUNCTOR(not_equal_to_op, !=)
+DEFINE_FUNCTOR(less_op, <)
+DEFINE_FUNCTOR(less_equal_op, <=)
+DEFINE_FUNCTOR(greater_op, >)
+DEFINE_FUNCTOR(greater_equal_op, >=)
+#undef DEFINE_FUNCTOR
+
+// Returns the lesser or greater of a and b like std::min and std::max, but
+// by value and lane-wise for SIMD registers.
+struct min_op {
+  template <typename A> A operator()(const A &a, const A &b) const {
+    return b < a ? b : a;
+  }
+};
+struct max_op {
+  template <typename A> A operator()(const A &a, const A &b) const {
+    return a < b ? b : a;
+  }
+};
+
+// Swaps the operands of Op.
+template <typename Op> struct reversed_op {
+  template <typename A, typename B>
+  auto operator()(const A &a, const B &b) const -> decltype(Op()(b, a)) {
+    return Op()(b, a);
+  }
+};
+
+template <typename T> inline const T &get_lane(const T *vec, int i) {
+  return vec[i];
+}
+template <typename T> inline const T &get_lane(const T &scalar, int) {
+  return scalar;
+}
+
+// Computes out[i] = op(lhs[i], rhs[i]) for i in [0, N), where rhs is either a
+// pointer to N elements or a scalar used for all lanes. out may alias lhs.
+template <typename T, int N, typename Rhs, typename Op>
+inline void simd_apply(const T *lhs, const Rhs &rhs, T *out, Op op,
+                       std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = op(lhs[i], get_lane(rhs, i));
+  }
+}
+
+#ifndef __SYNTHESIS__
+template <typename T, typename Reg>
+inline void load_lanes(const T *vec, int i, Reg &reg) {
+  memcpy(&reg, vec + i, sizeof(reg));
+}
+template <typename T, typename Scalar, typename Reg>
+inline void load_lanes(const Scalar &scalar, int, Reg &reg) {
+  reg = T(scalar) - Reg{}; // broadcast
+}
+
+// Processes simd_lanes<T, N>() lanes per register, then the rest one by one.
+template <typename T, int N, typename Rhs, typename Op>
+inline void simd_apply(const T *lhs, const Rhs &rhs, T *out, Op op,
+                       std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    reg a, b;
+    memcpy(&a, lhs + i, sizeof(reg));
+    load_lanes<T>(rhs, i, b);
+    const reg c = op(a, b);
+    memcpy(out + i, &c, sizeof(reg));
+  }
+  for (; i < N; ++i) {
+    out[i] = op(lhs[i], get_lane(rhs, i));
+  }
+}
+#endif // __SYNTHESIS__
+
+// Reduces buf[0, N) with op in a balanced tree of depth ceil(log2(N)), in
+// place; for odd n, the middle element is carried to the next level.
+template <int N, typename T, typename Op> inline T tree_reduce(T *buf, Op op) {
+  for (int n = N; n > 1; n = (n + 1) / 2) {
+    _Pragma("HLS unroll");
+    for (int i = 0; i < n / 2; ++i) {
+      _Pragma("HLS unroll");
+      buf[i] = op(buf[i], buf[i + (n + 1) / 2]);
+    }
+  }
+  return buf[0];
+}
+
+// Reduces vec[0, N) with op, which must be associative and commutative.
+template <typename T, int N, typename Op>
+inline T simd_reduce(const T *vec, Op op, std::false_type) {
+  T buf[N];
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    buf[i] = vec[i];
+  }
+  return tree_reduce<N>(buf, op);
+}
+
+// Returns sum(lhs[i] * rhs[i]) for i in [0, N).
+template <typename T, int N>
+inline T simd_dot(const T *lhs, const T *rhs, std::false_type) {
+  T buf[N];
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    buf[i] = lhs[i] * rhs[i];
+  }
+  return tree_reduce<N>(buf, plus_op());
+}
+
+// Computes out[i] = a[i] * b[i] + c[i] for i in [0, N).
+template <typename T, int N>
+inline void simd_fma(const T *a, const T *b, const T *c, T *out,
+                     std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = a[i] * b[i] + c[i];
+  }
+}
+
+// Computes out[i] = op(lhs[i], rhs[i]) for i in [0, N) like simd_apply, where
+// op is a comparison.
+template <typename T, int N, typename Rhs, typename Op>
+inline void simd_compare(const T *lhs, const Rhs &rhs, bool *out, Op op,
+                         std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = op(lhs[i], get_lane(rhs, i));
+  }
+}
+
+// Computes out[i] = mask[i] ? a[i] : b[i] for i in [0, N).
+template <typename T, int N>
+inline void simd_select(const bool *mask, const T *a, const T *b, T *out,
+                        std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = mask[i] ? a[i] : b[i];
+  }
+}
+
+// Computes out[i] = in[Idx[i]] for i in [0, sizeof...(Idx)).
+template <typename T, int N, int... Idx>
+inline void simd_shuffle(const T *in, T *out, std::false_type) {
+  constexpr int idx[] = {Idx...};
+  for (int i = 0; i < int(sizeof...(Idx)); ++i) {
+    _Pragma("HLS unroll");
+    out[i] = in[idx[i]];
+  }
+}
+
+// Computes out[i] = in[idx[i]] for i in [0, M).
+template <typename T, int M, typename I>
+inline void simd_permute(const T *in, const I *idx, T *out, std::false_type) {
+  for (int i = 0; i < M; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = in[idx[i]];
+  }
+}
+
+// Converts the N lanes of in to lane type U of out one by one; specialized for
+// lane types with vectorized conversions, e.g., task::half.
+template <typename T, typename U> struct lane_converter {
+  template <int N, typename In, typename Out>
+  static void convert(const In &in, Out &out) {
+    for (int i = 0; i < N; ++i) {
+      _Pragma("HLS unroll");
+      out.set(i, static_cast<U>(in[i]));
+    }
+  }
+};
+
+// Whether each index is in [0, n).
+constexpr bool is_in_range(int) { return true; }
+template <typename... Rest>
+constexpr bool is_in_range(int n, int first, Rest... rest) {
+  return 0 <= first && first < n && is_in_range(n, rest...);
+}
+
+#ifndef __SYNTHESIS__
+// Reduces the L lanes of a register with op by halving it until two are left.
+template <typename T, int L, typename Reg, typename Op>
+inline T reduce_lanes(const Reg &reg, Op op, std::false_type) {
+  return op(T(reg[0]), T(reg[1]));
+}
+template <typename T, int L, typename Reg, typename Op>
+inline T reduce_lanes(const Reg &reg, Op op, std::true_type) {
+  using half = typename simd_reg<T, L / 2>::type;
+  half lo, hi;
+  memcpy(&lo, &reg, sizeof(half));
+  memcpy(&hi, reinterpret_cast<const char *>(&reg) + sizeof(half),
+         sizeof(half));
+  return reduce_lanes<T, L / 2>(op(lo, hi), op,
+                                std::integral_constant<bool, (L > 4)>());
+}
+
+// Accumulates whole registers lane-wise, reduces the accumulator, then the
+// remaining elements one by one.
+template <typename T, int N, typename Op>
+inline T simd_reduce(const T *vec, Op op, std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  reg acc;
+  memcpy(&acc, vec, sizeof(reg));
+  int i = L;
+  for (; i + L <= N; i += L) {
+    reg a;
+    memcpy(&a, vec + i, sizeof(reg));
+    acc = op(acc, a);
+  }
+  T result =
+      reduce_lanes<T, L>(acc, op, std::integral_constant<bool, (L > 2)>());
+  for (; i < N; ++i) {
+    result = op(result, vec[i]);
+  }
+  return result;
+}
+
+template <typename T, int N>
+inline T simd_dot(const T *lhs, const T *rhs, std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  reg acc, a, b;
+  memcpy(&a, lhs, sizeof(reg));
+  memcpy(&b, rhs, sizeof(reg));
+  acc = a * b;
+  int i = L;
+  for (; i + L <= N; i += L) {
+    memcpy(&a, lhs + i, sizeof(reg));
+    memcpy(&b, rhs + i, sizeof(reg));
+    acc = a * b + acc; // contracted into FMA instructions if available
+  }
+  T result = reduce_lanes<T, L>(acc, plus_op(),
+                                std::integral_constant<bool, (L > 2)>());
+  for (; i < N; ++i) {
+    result += lhs[i] * rhs[i];
+  }
+  return result;
+}
+
+template <typename T, int N>
+inline void simd_fma(const T *a, const T *b, const T *c, T *out,
+                     std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    reg x, y, z;
+    memcpy(&x, a + i, sizeof(reg));
+    memcpy(&y, b + i, sizeof(reg));
+    memcpy(&z, c + i, sizeof(reg));
+    const reg result = x * y + z;
+    memcpy(out + i, &result, sizeof(reg));
+  }
+  for (; i < N; ++i) {
+    out[i] = a[i] * b[i] + c[i];
+  }
+}
+
+// Comparison results, which are 0 or -1 in each lane, are narrowed to bytes
+// and negated to bools.
+template <typename T, int N, typename Rhs, typename Op>
+inline void simd_compare(const T *lhs, const Rhs &rhs, bool *out, Op op,
+                         std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  using byte_reg = typename simd_reg<int8_t, L>::type;
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    reg a, b;
+    memcpy(&a, lhs + i, sizeof(reg));
+    load_lanes<T>(rhs, i, b);
+    const byte_reg mask = -__builtin_convertvector(op(a, b), byte_reg);
+    memcpy(out + i, &mask, sizeof(mask));
+  }
+  for (; i < N; ++i) {
+    out[i] = op(lhs[i], get_lane(rhs, i));
+  }
+}
+
+// Bools are widened to the lane size of T, which blends registers lane-wise.
+template <typename T, int N>
+inline void simd_select(const bool *mask, const T *a, const T *b, T *out,
+                        std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  using reg = typename simd_reg<T, L>::type;
+  using byte_reg = typename simd_reg<int8_t, L>::type;
+  using mask_reg =
+      typename simd_reg<typename mask_lane<sizeof(T)>::type, L>::type;
+  int i = 0;
+  for (; i + L <= N; i += L) {
+    byte_reg m;
+    reg x, y;
+    memcpy(&m, mask + i, sizeof(m));
+    memcpy(&x, a + i, sizeof(reg));
+    memcpy(&y, b + i, sizeof(reg));
+    const reg result = __builtin_convertvector(m, mask_reg) != 0 ? x : y;
+    memcpy(out + i, &result, sizeof(reg));
+  }
+  for (; i < N; ++i) {
+    out[i] = mask[i] ? a[i] : b[i];
+  }
+}
+
+// Shuffles a whole register; only used if N lanes fit in exactly one.
+template <typename T, int N, int... Idx>
+inline void simd_shuffle(const T *in, T *out, std::true_type) {
+  using reg = typename simd_reg<T, N>::type;
+  reg a;
+  memcpy(&a, in, sizeof(reg));
+#ifdef __clang__
+  const reg result = __builtin_shufflevector(a, a, Idx...);
+#else  // __clang__
+  using mask_reg =
+      typename simd_reg<typename mask_lane<sizeof(T)>::type, N>::type;
+  const reg result = __builtin_shuffle(a, mask_reg{Idx...});
+#endif // __clang__
+  memcpy(out, &result, sizeof(reg));
+}
+
+#ifndef __clang__
+// Permutes a whole register with variable indices of the same lane size as T;
+// Clang has no builtin for this.
+template <typename T, int M, typename I>
+inline void simd_permute(const T *in, const I *idx, T *out, std::true_type) {
+  using reg = typename simd_reg<T, M>::type;
+  using mask_reg =
+      typename simd_reg<typename mask_lane<sizeof(T)>::type, M>::type;
+  reg a;
+  mask_reg mask;
+  memcpy(&a, in, sizeof(reg));
+  memcpy(&mask, idx, sizeof(mask));
+  const reg result = __builtin_shuffle(a, mask);
+  memcpy(out, &result, sizeof(reg));
+}
+#endif // __clang__
+#endif // __SYNTHESIS__
+
+// Whether vec_t<T, N> fits in exactly one SIMD register, which can then be
+// shuffled as a whole.
+template <typename T, int N> constexpr bool is_simd_reg() {
+  return simd_lanes<T, N>() == N;
+}
+
+// Whether vec_t<T, N> can be permuted by indices of type I in registers.
+template <typename T, int N, typename I> constexpr bool is_simd_permutable() {
+#ifdef __clang__
+  return false;
+#else  // __clang__
+  return is_simd_reg<T, N>() && std::is_integral<I>::value &&
+         sizeof(I) == sizeof(T);
+#endif // __clang__
+}
+
+} // namespace internal
+
 template <typename T, int N> struct vec_t : protected std::array<T, N> {
 private:
   using base_type = std::array<T, N>;
@@ -55,10 +513,9 @@ public:
 
   // static cast to vec_t of another type
   template <typename U> explicit operator vec_t<U, N>() const {
+    _Pragma("HLS inline");
     vec_t<U, N> result;
-    for (size_type i = 0; i < N; ++i) {
-      result.set(i, static_cast<U>(get(i)));
-    }
+    internal::lane_converter<T, U>::template convert<N>(*this, result);
     return result;
   }
 
@@ -74,34 +531,32 @@ public:
   }
 
 // assignment operators
-#define DEFINE_OP(op)                                                          \
+#define DEFINE_OP(op, name, kind)                                              \
   template <typename T2>                                                       \
   vec_t<T, N> &operator op##=(const vec_t<T2, N> &rhs) {                       \
     _Pragma("HLS inline");                                                     \
-    for (size_type i = 0; i < N; ++i) {                                        \
-      _Pragma("HLS unroll");                                                   \
-      set(i, get(i) op rhs[i]);                                                \
-    }                                                                          \
+    internal::simd_apply<T, N>(                                                \
+        &get(0), &rhs[0], &(*this)[0], internal::name(),                       \
+        internal::simd_tag<internal::kind, T, N, const T2 *>());               \
     return *this;                                                              \
   }                                                                            \
   template <typename T2> vec_t<T, N> &operator op##=(const T2 &rhs) {          \
     _Pragma("HLS inline");                                                     \
-    for (size_type i = 0; i < N; ++i) {                                        \
-      _Pragma("HLS unroll");                                                   \
-      set(i, get(i) op rhs);                                                   \
-    }                                                                          \
+    internal::simd_apply<T, N>(                                                \
+        &get(0), rhs, &(*this)[0], internal::name(),                           \
+        internal::simd_tag<internal::kind, T, N, T2>());                       \
     return *this;                                                              \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, plus_op, kSimdAll)
+  DEFINE_OP(-, minus_op, kSimdAll)
+  DEFINE_OP(*, multiplies_op, kSimdAll)
+  DEFINE_OP(/, divides_op, kSimdFloating)
+  DEFINE_OP(%, modulus_op, kSimdNone)
+  DEFINE_OP(&, bit_and_op, kSimdIntegral)
+  DEFINE_OP(|, bit_or_op, kSimdIntegral)
+  DEFINE_OP(^, bit_xor_op, kSimdIntegral)
+  DEFINE_OP(<<, shift_left_op, kSimdNone)
+  DEFINE_OP(>>, shift_right_op, kSimdNone)
 #undef DEFINE_OP
 
 // unary arithemetic operators
@@ -120,35 +575,34 @@ public:
 #undef DEFINE_OP
 
 // binary arithemetic operators
-#define DEFINE_OP(op)                                                          \
-  template <typename T2> vec_t<T, N> operator op(const vec_t<T2, N> &rhs) {    \
+#define DEFINE_OP(op, name, kind)                                              \
+  template <typename T2>                                                       \
+  vec_t<T, N> operator op(const vec_t<T2, N> &rhs) const {                     \
     _Pragma("HLS inline");                                                     \
     vec_t<T, N> result;                                                        \
-    for (size_type i = 0; i < N; ++i) {                                        \
-      _Pragma("HLS unroll");                                                   \
-      result.set(i, get(i) op rhs[i]);                                         \
-    }                                                                          \
+    internal::simd_apply<T, N>(                                                \
+        &get(0), &rhs[0], &result[0], internal::name(),                        \
+        internal::simd_tag<internal::kind, T, N, const T2 *>());               \
     return result;                                                             \
   }                                                                            \
-  template <typename T2> vec_t<T, N> operator op(const T2 &rhs) {              \
+  template <typename T2> vec_t<T, N> operator op(const T2 &rhs) const {        \
     _Pragma("HLS inline");                                                     \
     vec_t<T, N> result;                                                        \
-    for (size_type i = 0; i < N; ++i) {                                        \
-      _Pragma("HLS unroll");                                                   \
-      result.set(i, get(i) op rhs);                                            \
-    }                                                                          \
+    internal::simd_apply<T, N>(                                                \
+        &get(0), rhs, &result[0], internal::name(),                            \
+        internal::simd_tag<internal::kind, T, N, T2>());                       \
     return result;                                                             \
   }
-  DEFINE_OP(+)
-  DEFINE_OP(-)
-  DEFINE_OP(*)
-  DEFINE_OP(/)
-  DEFINE_OP(%)
-  DEFINE_OP(&)
-  DEFINE_OP(|)
-  DEFINE_OP(^)
-  DEFINE_OP(<<)
-  DEFINE_OP(>>)
+  DEFINE_OP(+, plus_op, kSimdAll)
+  DEFINE_OP(-, minus_op, kSimdAll)
+  DEFINE_OP(*, multiplies_op, kSimdAll)
+  DEFINE_OP(/, divides_op, kSimdFloating)
+  DEFINE_OP(%, modulus_op, kSimdNone)
+  DEFINE_OP(&, bit_and_op, kSimdIntegral)
+  DEFINE_OP(|, bit_or_op, kSimdIntegral)
+  DEFINE_OP(^, bit_xor_op, kSimdIntegral)
+  DEFINE_OP(<<, shift_left_op, kSimdNone)
+  DEFINE_OP(>>, shift_right_op, kSimdNone)
 #undef DEFINE_OP
 
   // shift all elements by 1, put val at [N-1], and through away [0]
@@ -160,13 +614,12 @@ public:
   }
 
   // return true if and only if val exists
-  bool has(const T &val) {
-    bool result = false;
-    for (size_type i = 0; i < N; ++i) {
-      if (val == get(i))
-        result |= true;
-    }
-    return result;
+  bool has(const T &val) const {
+    vec_t<bool, N> mask;
+    internal::simd_compare<T, N>(
+        &get(0), val, &mask[0], internal::equal_to_op(),
+        internal::simd_tag<internal::kSimdAll, T, N, T>());
+    return any(mask);
   }
 };
 
@@ -244,27 +697,26 @@ template <typename T, typename... Args> inline auto cat(T arg, Args... args) {
 #endif // __cplusplus >= 201402L
 
 // binary arithemetic operators, vector on the right-hand side
-#define DEFINE_OP(op)                                                          \
+#define DEFINE_OP(op, name, kind)                                              \
   template <typename T, int N, typename T2>                                    \
   vec_t<T, N> operator op(const T2 &lhs, const vec_t<T, N> &rhs) {             \
     _Pragma("HLS inline");                                                     \
     vec_t<T, N> result;                                                        \
-    for (int i = 0; i < N; ++i) {                                              \
-      _Pragma("HLS unroll");                                                   \
-      result.set(i, lhs op rhs[i]);                                            \
-    }                                                                          \
+    internal::simd_apply<T, N>(                                                \
+        &rhs[0], lhs, &result[0], internal::reversed_op<internal::name>(),     \
+        internal::simd_tag<internal::kind, T, N, T2>());                       \
     return result;                                                             \
   }
-DEFINE_OP(+)
-DEFINE_OP(-)
-DEFINE_OP(*)
-DEFINE_OP(/)
-DEFINE_OP(%)
-DEFINE_OP(&)
-DEFINE_OP(|)
-DEFINE_OP(^)
-DEFINE_OP(<<)
-DEFINE_OP(>>)
+DEFINE_OP(+, plus_op, kSimdAll)
+DEFINE_OP(-, minus_op, kSimdAll)
+DEFINE_OP(*, multiplies_op, kSimdAll)
+DEFINE_OP(/, divides_op, kSimdFloating)
+DEFINE_OP(%, modulus_op, kSimdNone)
+DEFINE_OP(&, bit_and_op, kSimdIntegral)
+DEFINE_OP(|, bit_or_op, kSimdIntegral)
+DEFINE_OP(^, bit_xor_op, kSimdIntegral)
+DEFINE_OP(<<, shift_left_op, kSimdNone)
+DEFINE_OP(>>, shift_right_op, kSimdNone)
 #undef DEFINE_OP
 
 template <int N, typename T> vec_t<T, N> make_vec(T val) {
@@ -283,10 +735,8 @@ template <int N, typename T> vec_t<T, N> make_vec(T val) {
     }                                                                          \
     return vec;                                                                \
   }
-DEFINE_FUNC(exp)
 DEFINE_FUNC(exp2)
 DEFINE_FUNC(expm1)
-DEFINE_FUNC(log)
 DEFINE_FUNC(log10)
 DEFINE_FUNC(log1p)
 DEFINE_FUNC(log2)
@@ -316,20 +766,171 @@ DEFINE_FUNC(max)
 DEFINE_FUNC(min)
 #undef DEFINE_FUNC
 
-// reduction operation functions
-#define DEFINE_FUNC(func, op)                                                  \
-  template <typename T> T func(const vec_t<T, 1> &vec) {                       \
+// reduction operation functions, computed in a tree or in SIMD registers; the
+// order of floating-point operations is unspecified
+#define DEFINE_FUNC(func, name, kind)                                          \
+  template <typename T, int N> T func(const vec_t<T, N> &vec) {                \
     _Pragma("HLS inline");                                                     \
-    return vec[0];                                                             \
+    return internal::simd_reduce<T, N>(                                        \
+        &vec[0], internal::name(),                                             \
+        internal::simd_tag<internal::kind, T, N, const T *>());                \
+  }
+DEFINE_FUNC(sum, plus_op, kSimdAll)
+DEFINE_FUNC(product, multiplies_op, kSimdAll)
+DEFINE_FUNC(min, min_op, kSimdAll)
+DEFINE_FUNC(max, max_op, kSimdAll)
+DEFINE_FUNC(bit_and, bit_and_op, kSimdIntegral)
+DEFINE_FUNC(bit_or, bit_or_op, kSimdIntegral)
+DEFINE_FUNC(bit_xor, bit_xor_op, kSimdIntegral)
+#undef DEFINE_FUNC
+
+// return the index of the first minimum (argmin) or maximum (argmax) element;
+// unspecified if vec contains NaN
+#define DEFINE_FUNC(func, reduce_func, op)                                     \
+  template <typename T, int N> int func(const vec_t<T, N> &vec) {              \
+    _Pragma("HLS inline");                                                     \
+    if (internal::simd_lanes<T, N>() > 0) {                                    \
+      const T target = reduce_func(vec);                                       \
+      for (int i = 0; i < N; ++i) {                                            \
+        if (vec[i] == target) {                                                \
+          return i;                                                            \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    /* tree of indices, which are not ordered across subtrees */              \
+    int buf[N];                                                                \
+    for (int i = 0; i < N; ++i) {                                              \
+      _Pragma("HLS unroll");                                                   \
+      buf[i] = i;                                                              \
+    }                                                                          \
+    return internal::tree_reduce<N>(buf, [&vec](int lhs, int rhs) {            \
+      return vec[rhs] op vec[lhs] || (vec[rhs] == vec[lhs] && rhs < lhs)      \
+                 ? rhs                                                         \
+                 : lhs;                                                        \
+    });                                                                        \
+  }
+DEFINE_FUNC(argmin, min, <)
+DEFINE_FUNC(argmax, max, >)
+#undef DEFINE_FUNC
+
+// return sum(lhs[i] * rhs[i])
+template <typename T, int N>
+inline T dot(const vec_t<T, N> &lhs, const vec_t<T, N> &rhs) {
+  _Pragma("HLS inline");
+  return internal::simd_dot<T, N>(
+      &lhs[0], &rhs[0],
+      internal::simd_tag<internal::kSimdAll, T, N, const T *>());
+}
+
+// return a * b + c, rounded once if the target has fused multiply-add
+// instructions and floating-point contraction is not disabled
+template <typename T, int N>
+inline vec_t<T, N> fma(const vec_t<T, N> &a, const vec_t<T, N> &b,
+                       const vec_t<T, N> &c) {
+  _Pragma("HLS inline");
+  vec_t<T, N> result;
+  internal::simd_fma<T, N>(
+      &a[0], &b[0], &c[0], &result[0],
+      internal::simd_tag<internal::kSimdAll, T, N, const T *>());
+  return result;
+}
+
+// lane-wise comparison operators, returning a mask
+#define DEFINE_OP(op, name)                                                    \
+  template <typename T, int N, typename T2>                                    \
+  vec_t<bool, N> operator op(const vec_t<T, N> &lhs,                           \
+                             const vec_t<T2, N> &rhs) {                        \
+    _Pragma("HLS inline");                                                     \
+    vec_t<bool, N> result;                                                     \
+    internal::simd_compare<T, N>(                                              \
+        &lhs[0], &rhs[0], &result[0], internal::name(),                        \
+        internal::simd_tag<internal::kSimdAll, T, N, const T2 *>());           \
+    return result;                                                             \
   }                                                                            \
-  template <typename T, int N> T func(const vec_t<T, N> &vec) {                \
+  template <typename T, int N, typename T2>                                    \
+  vec_t<bool, N> operator op(const vec_t<T, N> &lhs, const T2 &rhs) {          \
+    _Pragma("HLS inline");                                                     \
+    vec_t<bool, N> result;                                                     \
+    internal::simd_compare<T, N>(                                              \
+        &lhs[0], rhs, &result[0], internal::name(),                            \
+        internal::simd_tag<internal::kSimdAll, T, N, T2>());                   \
+    return result;                                                             \
+  }                                                                            \
+  template <typename T, int N, typename T2>                                    \
+  vec_t<bool, N> operator op(const T2 &lhs, const vec_t<T, N> &rhs) {          \
+    _Pragma("HLS inline");                                                     \
+    vec_t<bool, N> result;                                                     \
+    internal::simd_compare<T, N>(                                              \
+        &rhs[0], lhs, &result[0], internal::reversed_op<internal::name>(),     \
+        internal::simd_tag<internal::kSimdAll, T, N, T2>());                   \
+    return result;                                                             \
+  }
+DEFINE_OP(==, equal_to_op)
+DEFINE_OP(!=, not_equal_to_op)
+DEFINE_OP(<, less_op)
+DEFINE_OP(<=, less_equal_op)
+DEFINE_OP(>, greater_op)
+DEFINE_OP(>=, greater_equal_op)
+#undef DEFINE_OP
+
+// return whether any (any) or all (all) lanes of mask are true
+#ifdef __SYNTHESIS__
+#define DEFINE_FUNC(func, reduce_func, name)                                   \
+  template <int N> bool func(const vec_t<bool, N> &mask) {                     \
     _Pragma("HLS inline");                                                     \
-    return func(truncated<N / 2>(vec)) op func(truncated<N / 2, N>(vec));      \
+    return reduce_func(mask);                                                  \
+  }
+#else // __SYNTHESIS__
+// bools are bytes of 0 or 1 on the host, so they are reduced as uint8_t lanes
+#define DEFINE_FUNC(func, reduce_func, name)                                   \
+  template <int N> bool func(const vec_t<bool, N> &mask) {                     \
+    return internal::simd_reduce<uint8_t, N>(                                  \
+               reinterpret_cast<const uint8_t *>(&mask[0]), internal::name(),  \
+               internal::simd_tag<internal::kSimdIntegral, uint8_t, N,         \
+                                  const uint8_t *>()) != 0;                    \
   }
-DEFINE_FUNC(sum, +)
-DEFINE_FUNC(product, *)
+#endif // __SYNTHESIS__
+DEFINE_FUNC(any, bit_or, bit_or_op)
+DEFINE_FUNC(all, bit_and, bit_and_op)
 #undef DEFINE_FUNC
 
+// return mask[i] ? a[i] : b[i] for each lane i
+template <typename T, int N>
+inline vec_t<T, N> select(const vec_t<bool, N> &mask, const vec_t<T, N> &a,
+                          const vec_t<T, N> &b) {
+  _Pragma("HLS inline");
+  vec_t<T, N> result;
+  internal::simd_select<T, N>(
+      &mask[0], &a[0], &b[0], &result[0],
+      internal::simd_tag<internal::kSimdAll, T, N, const T *>());
+  return result;
+}
+
+// return {vec[Idx]...}, e.g., shuffle<1, 0>(vec) swaps 2 lanes
+template <int... Idx, typename T, int N>
+inline vec_t<T, sizeof...(Idx)> shuffle(const vec_t<T, N> &vec) {
+  _Pragma("HLS inline");
+  static_assert(internal::is_in_range(N, Idx...), "index out of range");
+  vec_t<T, sizeof...(Idx)> result;
+  internal::simd_shuffle<T, N, Idx...>(
+      &vec[0], &result[0],
+      std::integral_constant<bool, (internal::is_simd_reg<T, N>() &&
+                                    sizeof...(Idx) == N)>());
+  return result;
+}
+
+// return {vec[idx[0]], vec[idx[1]], ...}; each index must be in [0, N)
+template <typename T, int N, typename I, int M>
+inline vec_t<T, M> permute(const vec_t<T, N> &vec, const vec_t<I, M> &idx) {
+  _Pragma("HLS inline");
+  vec_t<T, M> result;
+  internal::simd_permute<T, M>(
+      &vec[0], &idx[0], &result[0],
+      std::integral_constant<bool, (internal::is_simd_permutable<T, N, I>() &&
+                                    M == N)>());
+  return result;
+}
+
 template <typename T, int N>
 inline std::ostream &operator<<(std::ostream &os, const vec_t<T, N> &obj) {
   os << "{";
@@ -343,4 +944,13 @@ inline std::ostream &operator<<(std::ostream &os, const vec_t<T, N> &obj) {
 
 } // namespace task
 
+// exp, log, and more math functions vectorized for float and double
+#include "task/vec_math.h"
+
+// uint_t, int_t, and vec_t packing their lanes at their bit width
+#include "task/packed.h"
+
+// half, bfloat16, and fixed, with vectorized conversions from and to float
+#include "task/numeric.h"
+
 #endif // TASK_VEC_H_
@@ -0,0 +1,589 @@
+#ifndef TASK_VEC_MATH_H_
+#define TASK_VEC_MATH_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <limits>
+#include <type_traits>
+
+#ifndef __SYNTHESIS__
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif // __AVX__ || __SSE2__
+#endif // __SYNTHESIS__
+
+#include "task/vec.h"
+
+// Vectorized math functions of vec_t<float, N> and vec_t<double, N>.
+//
+// When vec_t operators are vectorized (see internal::kSimdBytes), the functions
+// below evaluate polynomial approximations on whole SIMD registers instead of
+// calling libm per lane. Otherwise, e.g., for HLS, other lane types, or if
+// TASK_USE_SCALAR_VEC is defined, they call the std:: function of each lane.
+//
+// Maximum error in units in the last place (ULP), measured against long double
+// libm on 12 million random inputs over each function's domain and rounded up,
+// with and without FMA instructions:
+//
+//   function   float   double   task::fast:: float   task::fast:: double
+//   exp        1.3     1.2      3.0                  2.6
+//   log        0.9     0.9      0.9                  0.8
+//   sqrt       0.5     0.5      -                    -
+//   rsqrt      1.5     1.5      3.0                  2.9
+//   sin, cos   2.5     1.6      2.5                  1.6
+//   tanh       1.4     1.4      1.7                  1.6
+//   pow        0.5     libm     exp of y * log(x); 110 for |y * log(x)| < 60
+//
+// Most of the errors are lower with FMA, e.g., those of exp are 0.94 (float)
+// and 0.89 (double).
+//
+// The precise functions handle NaN, infinities, zeros, subnormals, overflow,
+// and underflow like libm. sin and cos call libm for lanes of magnitude above
+// 8192 (float) or 2^20 (double), and double pow always calls libm. The
+// task::fast:: variants skip all of the special cases: inputs must be finite,
+// results must be normal numbers, and fast::log and fast::pow require positive
+// x. fast::sin and fast::cos lose accuracy beyond the libm thresholds above.
+
+namespace task {
+
+namespace internal {
+
+namespace math {
+
+enum accuracy { kPrecise, kFast };
+
+#ifndef __SYNTHESIS__
+template <typename T, int L> using reg_t = typename simd_reg<T, L>::type;
+template <typename T, int L>
+using int_reg_t =
+    typename simd_reg<typename mask_lane<sizeof(T)>::type, L>::type;
+
+// Layout of IEEE 754 floating-point numbers.
+template <typename T> struct ieee754;
+template <> struct ieee754<float> {
+  static constexpr int kMantissaBits = 23;
+  static constexpr int kBias = 127;
+};
+template <> struct ieee754<double> {
+  static constexpr int kMantissaBits = 52;
+  static constexpr int kBias = 1023;
+};
+
+template <typename To, typename From> inline To bit_cast(const From &from) {
+  static_assert(sizeof(To) == sizeof(From), "size mismatch");
+  To to;
+  memcpy(&to, &from, sizeof(to));
+  return to;
+}
+
+template <typename R, typename T> inline R splat(T val) {
+  return val - R{}; // keeps the sign of zero
+}
+
+// Evaluates c[0] * x^(K-1) + c[1] * x^(K-2) + ... + c[K-1].
+template <typename R, typename T, int K>
+inline R horner(const R &x, const T (&c)[K]) {
+  R y = x * c[0] + c[1];
+  for (int i = 2; i < K; ++i) {
+    y = y * x + c[i];
+  }
+  return y;
+}
+
+// Returns 2^n for n in [1 - bias, bias].
+template <typename T, int L> inline reg_t<T, L> pow2(int_reg_t<T, L> n) {
+  return bit_cast<reg_t<T, L>>((n + ieee754<T>::kBias)
+                               << ieee754<T>::kMantissaBits);
+}
+
+template <typename T, int L> inline reg_t<T, L> abs(reg_t<T, L> x) {
+  using I = typename mask_lane<sizeof(T)>::type;
+  return bit_cast<reg_t<T, L>>(bit_cast<int_reg_t<T, L>>(x) &
+                               std::numeric_limits<I>::max());
+}
+
+// e^x = 2^n * e^r, where n = round(x / ln2) and |r| <= ln2 / 2, and e^r is
+// evaluated with its Taylor series; the scaling is split in two so that
+// subnormal results are exact.
+template <accuracy A, typename T, int L> reg_t<T, L> exp(reg_t<T, L> x) {
+  using R = reg_t<T, L>;
+  using IR = int_reg_t<T, L>;
+  const bool is_float = std::is_same<T, float>::value;
+  // e^max_x and e^min_x are the largest and smallest positive numbers
+  const T max_x = is_float ? 88.72283905f : 709.782712893384;
+  const T min_x = is_float ? -103.9720840f : -745.1332191019412;
+  const T ln2_hi = is_float ? 0.693359375f : 6.93147180369123816490e-01;
+  const T ln2_lo = is_float ? -2.12194440e-4f : 1.90821492927058770002e-10;
+  const T log2e = 1.44269504088896340736;
+  static constexpr T kTaylor[] = {
+      1. / 6227020800, 1. / 479001600, 1. / 39916800, 1. / 3628800,
+      1. / 362880,     1. / 40320,     1. / 5040,     1. / 720,
+      1. / 120,        1. / 24,        1. / 6,        1. / 2,
+      1.,              1.};
+  // terms needed for < 0.5 ULP of truncation error, or a few ULPs if fast
+  constexpr int K = A == kFast ? (is_float ? 7 : 13) : (is_float ? 8 : 14);
+  T c[K];
+  for (int i = 0; i < K; ++i) {
+    c[i] = kTaylor[14 - K + i];
+  }
+
+  R y = x;
+  if (A == kPrecise) {
+    y = y < min_x ? splat<R>(min_x) : y;
+    y = y > max_x ? splat<R>(max_x) : y;
+  }
+  const R t = y * log2e;
+  const IR n = __builtin_convertvector(t + (t < 0 ? splat<R>(T(-.5))
+                                                  : splat<R>(T(.5))),
+                                       IR);
+  const R n_real = __builtin_convertvector(n, R);
+  const R r = (y - n_real * ln2_hi) - n_real * ln2_lo;
+  y = horner(r, c);
+  if (A == kFast) {
+    return y * pow2<T, L>(n);
+  }
+  const IR n_half = n >> 1;
+  y = y * pow2<T, L>(n_half) * pow2<T, L>(n - n_half);
+  y = x > max_x ? splat<R>(std::numeric_limits<T>::infinity()) : y;
+  y = x < min_x ? R{} : y;
+  return x != x ? x : y;
+}
+
+// log(x) = n * ln2 + log(m), where x = m * 2^n and m is in [sqrt(2)/2,
+// sqrt(2)); log(m) = 2 * atanh(s), where s = (m - 1) / (m + 1), is evaluated
+// as in fdlibm.
+template <accuracy A, typename T, int L> reg_t<T, L> log(reg_t<T, L> x) {
+  using R = reg_t<T, L>;
+  using I = typename mask_lane<sizeof(T)>::type;
+  using IR = int_reg_t<T, L>;
+  const bool is_float = std::is_same<T, float>::value;
+  constexpr int kMantissaBits = ieee754<T>::kMantissaBits;
+  const T ln2_hi = is_float ? 6.9313812256e-01f : 6.93147180369123816490e-01;
+  const T ln2_lo = is_float ? 9.0580006145e-06f : 1.90821492927058770002e-10;
+  const I one_bits = bit_cast<I>(T(1));
+  const I sqrt_half_bits = bit_cast<I>(T(0.70710678118654752440));
+
+  R y = x;
+  IR n = IR{};
+  if (A == kPrecise) {
+    // normalizes subnormals
+    const IR is_subnormal = y < std::numeric_limits<T>::min();
+    y = is_subnormal ? y * T(std::ldexp(1., kMantissaBits + 2)) : y;
+    n = is_subnormal ? n - (kMantissaBits + 2) : n;
+  }
+  IR bits = bit_cast<IR>(y) + (one_bits - sqrt_half_bits);
+  n += (bits >> kMantissaBits) - ieee754<T>::kBias;
+  bits = (bits & ((I(1) << kMantissaBits) - 1)) + sqrt_half_bits;
+  const R f = bit_cast<R>(bits) - 1;
+  const R s = f / (2 + f);
+  const R z = s * s;
+  const R w = z * z;
+  R poly;
+  if (is_float) {
+    static constexpr T kEven[] = {T(2.4279078841e-01), T(4.0000972152e-01)};
+    static constexpr T kOdd[] = {T(2.8498786688e-01), T(6.6666662693e-01)};
+    poly = w * horner(w, kEven) + z * horner(w, kOdd);
+  } else {
+    static constexpr T kEven[] = {T(1.531383769920937332e-01),
+                                  T(2.222219843214978396e-01),
+                                  T(3.999999999940941908e-01)};
+    static constexpr T kOdd[] = {
+        T(1.479819860511658591e-01), T(1.818357216161805012e-01),
+        T(2.857142874366239149e-01), T(6.666666666666735130e-01)};
+    poly = w * horner(w, kEven) + z * horner(w, kOdd);
+  }
+  const R half_f2 = T(.5) * f * f;
+  const R n_real = __builtin_convertvector(n, R);
+  y = s * (half_f2 + poly) + n_real * ln2_lo - half_f2 + f + n_real * ln2_hi;
+  if (A == kFast) {
+    return y;
+  }
+  y = x == std::numeric_limits<T>::infinity() ? x : y;
+  y = x == 0 ? splat<R>(-std::numeric_limits<T>::infinity()) : y;
+  return (x < 0) | (x != x) ? splat<R>(std::numeric_limits<T>::quiet_NaN())
+                            : y;
+}
+
+// Computes each lane with libm.
+template <typename T, int L, typename Func>
+inline reg_t<T, L> per_lane(reg_t<T, L> x, Func func) {
+  for (int i = 0; i < L; ++i) {
+    x[i] = func(x[i]);
+  }
+  return x;
+}
+
+// Uses the hardware square root instructions if available.
+template <typename T, int L> reg_t<T, L> sqrt(reg_t<T, L> x) {
+  return per_lane<T, L>(x, [](T lane) { return std::sqrt(lane); });
+}
+#define DEFINE_SQRT(type, lanes, intrinsic, native_type)                       \
+  template <>                                                                  \
+  inline reg_t<type, lanes> sqrt<type, lanes>(reg_t<type, lanes> x) {          \
+    return bit_cast<reg_t<type, lanes>>(intrinsic(bit_cast<native_type>(x)));  \
+  }
+#ifdef __AVX512F__
+// _mm512_sqrt_ps and _mm512_sqrt_pd trigger spurious -Wmaybe-uninitialized
+// warnings on GCC 12, which the zero-masking versions do not
+inline __m512 sqrt_ps512(__m512 x) {
+  return _mm512_maskz_sqrt_ps(__mmask16(-1), x);
+}
+inline __m512d sqrt_pd512(__m512d x) {
+  return _mm512_maskz_sqrt_pd(__mmask8(-1), x);
+}
+DEFINE_SQRT(float, 16, sqrt_ps512, __m512)
+DEFINE_SQRT(double, 8, sqrt_pd512, __m512d)
+#endif // __AVX512F__
+#ifdef __AVX__
+DEFINE_SQRT(float, 8, _mm256_sqrt_ps, __m256)
+DEFINE_SQRT(double, 4, _mm256_sqrt_pd, __m256d)
+#endif // __AVX__
+#ifdef __SSE2__
+DEFINE_SQRT(float, 4, _mm_sqrt_ps, __m128)
+DEFINE_SQRT(double, 2, _mm_sqrt_pd, __m128d)
+#endif // __SSE2__
+#undef DEFINE_SQRT
+
+// The fast version refines the classic bit-level estimate with Newton's
+// method.
+template <accuracy A, typename T, int L> reg_t<T, L> rsqrt(reg_t<T, L> x) {
+  using R = reg_t<T, L>;
+  using IR = int_reg_t<T, L>;
+  if (A == kPrecise) {
+    return 1 / sqrt<T, L>(x);
+  }
+  const bool is_float = std::is_same<T, float>::value;
+  const typename mask_lane<sizeof(T)>::type magic =
+      is_float ? 0x5f375a86 : 0x5fe6eb50c7b537a9 & -uint64_t(!is_float);
+  R y = bit_cast<R>(magic - (bit_cast<IR>(x) >> 1));
+  const R half_x = T(.5) * x;
+  for (int i = 0; i < (is_float ? 3 : 4); ++i) {
+    y = y * (T(1.5) - half_x * y * y);
+  }
+  return y;
+}
+
+// sin(x) and cos(x) are evaluated with the Cephes polynomials on
+// r = |x| - j * pi / 4 in [-pi / 4, pi / 4], where j is even; j selects the
+// polynomial and the sign.
+template <accuracy A, bool IsCos, typename T, int L>
+reg_t<T, L> sincos(reg_t<T, L> x) {
+  using R = reg_t<T, L>;
+  using IR = int_reg_t<T, L>;
+  const bool is_float = std::is_same<T, float>::value;
+  // pi / 4 = dp1 + dp2 + dp3 (+ dp4 for float), where all but the last part
+  // have enough trailing zeros so that j * dp is exact for |x| <= max_x
+  const T dp1 = is_float ? 7.8515625e-1f : 7.85398125648498535156e-1;
+  const T dp2 = is_float ? 2.41756439208984375e-4f : 3.77489470793079817668e-8;
+  const T dp3 = is_float ? 1.569278538e-7f : 2.69515142907905952645e-15;
+  const T dp4 = is_float ? 3.038550314e-11f : 0;
+  const T max_x = is_float ? 8192 : 1048576;
+
+  const R abs_x = abs<T, L>(x);
+  IR j = __builtin_convertvector(abs_x * T(1.27323954473516268615), IR);
+  j = (j + 1) & ~1;
+  const R j_real = __builtin_convertvector(j, R);
+  R r = ((abs_x - j_real * dp1) - j_real * dp2) - j_real * dp3;
+  if (is_float) {
+    r -= j_real * dp4;
+  }
+  const R z = r * r;
+  R sin_r, cos_r;
+  if (is_float) {
+    static constexpr T kSin[] = {T(-1.9515295891e-4), T(8.3321608736e-3),
+                                 T(-1.6666654611e-1)};
+    static constexpr T kCos[] = {T(2.443315711809948e-5),
+                                 T(-1.388731625493765e-3),
+                                 T(4.166664568298827e-2)};
+    sin_r = r + r * z * horner(z, kSin);
+    cos_r = 1 - T(.5) * z + z * z * horner(z, kCos);
+  } else {
+    static constexpr T kSin[] = {
+        T(1.58962301576546568060e-10), T(-2.50507477628578072866e-8),
+        T(2.75573136213857245213e-6),  T(-1.98412698295895385996e-4),
+        T(8.33333333332211858878e-3),  T(-1.66666666666666307295e-1)};
+    static constexpr T kCos[] = {
+        T(-1.13585365213876817300e-11), T(2.08757008419747316778e-9),
+        T(-2.75573141792967388112e-7),  T(2.48015872888517045348e-5),
+        T(-1.38888888888730564116e-3),  T(4.16666666666665929218e-2)};
+    sin_r = r + r * z * horner(z, kSin);
+    cos_r = 1 - T(.5) * z + z * z * horner(z, kCos);
+  }
+  // sin is negative for j % 8 in {4, 6}, cos for j % 8 in {2, 4}
+  const IR sign_bit = IR{} + std::numeric_limits<
+                                 typename mask_lane<sizeof(T)>::type>::min();
+  IR sign = ((IsCos ? j + 2 : j) & 4) != 0;
+  sign &= sign_bit;
+  if (!IsCos) {
+    sign ^= bit_cast<IR>(x) & sign_bit;
+  }
+  const R y = bit_cast<R>(
+      bit_cast<IR>((j & 2) == 0 ? (IsCos ? cos_r : sin_r)
+                                : (IsCos ? sin_r : cos_r)) ^
+      sign);
+  if (A == kPrecise) {
+    // large arguments lose accuracy in the reduction; leave them to libm
+    const IR is_large = !(abs_x <= max_x);
+    if (reduce_lanes<typename mask_lane<sizeof(T)>::type, L>(
+            is_large, bit_or_op(), std::integral_constant<bool, (L > 2)>())) {
+      R result = y;
+      for (int i = 0; i < L; ++i) {
+        if (is_large[i]) {
+          result[i] = IsCos ? std::cos(x[i]) : std::sin(x[i]);
+        }
+      }
+      return result;
+    }
+  }
+  return y;
+}
+
+// tanh(x) = 1 - 2 / (e^(2x) + 1), except for |x| < 0.625, where that cancels
+// and the Cephes polynomial is used instead. Both are evaluated on |x| and
+// take the sign of x, which keeps the sign of zero.
+template <accuracy A, typename T, int L> reg_t<T, L> tanh(reg_t<T, L> x) {
+  using R = reg_t<T, L>;
+  using IR = int_reg_t<T, L>;
+  const bool is_float = std::is_same<T, float>::value;
+  const R abs_x = abs<T, L>(x);
+  const R z = x * x;
+  R small;
+  if (is_float) {
+    static constexpr T kTanh[] = {
+        T(-5.70498872745e-3), T(2.06390887954e-2), T(-5.37397155531e-2),
+        T(1.33314422036e-1), T(-3.33332819422e-1)};
+    small = abs_x + abs_x * z * horner(z, kTanh);
+  } else {
+    static constexpr T kNum[] = {T(-9.64399179425052238628e-1),
+                                 T(-9.92877231001918586564e1),
+                                 T(-1.61468768441708447952e3)};
+    static constexpr T kDen[] = {T(1.), T(1.12811678491632931402e2),
+                                 T(2.23548839060100448583e3),
+                                 T(4.84406305325125486048e3)};
+    small = abs_x + abs_x * z * horner(z, kNum) / horner(z, kDen);
+  }
+  // tanh(x) rounds to 1 long before e^(2x) overflows
+  const R large =
+      1 - 2 / (exp<A, T, L>(2 * (abs_x > 20 ? splat<R>(T(20)) : abs_x)) + 1);
+  const IR sign_bit = bit_cast<IR>(x) & ~bit_cast<IR>(abs_x);
+  return bit_cast<R>(bit_cast<IR>(abs_x < T(.625) ? small : large) | sign_bit);
+}
+
+// Float pow is computed in double, where the error of log(x) is too small to
+// be amplified by y into float ULPs; L float lanes fit in L doubles of a
+// register twice as wide.
+template <int L>
+reg_t<float, L> pow_in_double(reg_t<float, L> x_float,
+                              reg_t<float, L> y_float) {
+  using D = reg_t<double, L>;
+  using IR = int_reg_t<double, L>;
+  const double inf = std::numeric_limits<double>::infinity();
+  const D x = __builtin_convertvector(x_float, D);
+  const D y = __builtin_convertvector(y_float, D);
+  const D abs_x = abs<double, L>(x);
+  D result = exp<kPrecise, double, L>(y * log<kPrecise, double, L>(abs_x));
+
+  // floats of magnitude 2^24 or more are even integers
+  const IR is_big = abs<double, L>(y) >= 16777216.;
+  const IR y_int = __builtin_convertvector(is_big ? D{} : y, IR);
+  const IR is_integer = is_big | (__builtin_convertvector(y_int, D) == y);
+  const IR is_odd = (y_int & 1) != 0;
+  // x^y has the sign of x for odd y, and is NaN for finite x < 0 and
+  // non-integer y
+  result = (bit_cast<IR>(x) < 0) & is_odd ? -result : result;
+  result = (x < 0) & (x != -inf) & (is_integer == 0)
+               ? splat<D>(std::numeric_limits<double>::quiet_NaN())
+               : result;
+  const IR is_one =
+      (y == 0) | (x == 1) | ((abs_x == 1) & (abs<double, L>(y) == inf));
+  result = is_one ? splat<D>(1.) : result;
+  return __builtin_convertvector(result, reg_t<float, L>);
+}
+
+// Double pow calls libm.
+template <typename T, int L>
+inline reg_t<T, L> pow_precise(reg_t<T, L> x, reg_t<T, L> y, std::false_type) {
+  for (int i = 0; i < L; ++i) {
+    x[i] = std::pow(x[i], y[i]);
+  }
+  return x;
+}
+
+// Splits the float lanes in halves so that the doubles fit in a register.
+template <typename T, int L>
+inline reg_t<T, L> pow_precise(reg_t<T, L> x, reg_t<T, L> y, std::true_type) {
+  constexpr int H = L / 2;
+  for (int i = 0; i < L; i += H) {
+    reg_t<float, H> x_half, y_half;
+    memcpy(&x_half, reinterpret_cast<T *>(&x) + i, sizeof(x_half));
+    memcpy(&y_half, reinterpret_cast<T *>(&y) + i, sizeof(y_half));
+    const reg_t<float, H> z = pow_in_double<H>(x_half, y_half);
+    memcpy(reinterpret_cast<T *>(&x) + i, &z, sizeof(z));
+  }
+  return x;
+}
+
+template <accuracy A, typename T, int L>
+reg_t<T, L> pow(reg_t<T, L> x, reg_t<T, L> y) {
+  if (A == kFast) {
+    return exp<A, T, L>(y * log<A, T, L>(x));
+  }
+  return pow_precise<T, L>(x, y, std::is_same<T, float>());
+}
+#endif // __SYNTHESIS__
+
+// Computes out[i] = func(in[i]) for i in [0, N) with libm.
+template <typename T, int N, typename Op>
+inline void apply(const T *in, const T *, T *out, Op, std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = Op::scalar(in[i]);
+  }
+}
+
+#ifndef __SYNTHESIS__
+// Processes simd_lanes<T, N>() lanes per register, including a last partial
+// register padded with zeros.
+template <typename T, int N, typename Op>
+inline void apply(const T *in, const T *, T *out, Op, std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  for (int i = 0; i < N; i += L) {
+    const int n = N - i < L ? N - i : L;
+    reg_t<T, L> x = {};
+    memcpy(&x, in + i, n * sizeof(T));
+    const reg_t<T, L> y = Op::template simd<T, L>(x);
+    memcpy(out + i, &y, n * sizeof(T));
+  }
+}
+#endif // __SYNTHESIS__
+
+template <typename T, int N, typename Op>
+inline void apply2(const T *lhs, const T *rhs, T *out, Op, std::false_type) {
+  for (int i = 0; i < N; ++i) {
+    _Pragma("HLS unroll");
+    out[i] = Op::scalar(lhs[i], rhs[i]);
+  }
+}
+
+#ifndef __SYNTHESIS__
+template <typename T, int N, typename Op>
+inline void apply2(const T *lhs, const T *rhs, T *out, Op, std::true_type) {
+  constexpr int L = simd_lanes<T, N>();
+  for (int i = 0; i < N; i += L) {
+    const int n = N - i < L ? N - i : L;
+    reg_t<T, L> x = {}, y = {};
+    memcpy(&x, lhs + i, n * sizeof(T));
+    memcpy(&y, rhs + i, n * sizeof(T));
+    const reg_t<T, L> z = Op::template simd<T, L>(x, y);
+    memcpy(out + i, &z, n * sizeof(T));
+  }
+}
+#endif // __SYNTHESIS__
+
+// Whether vec_t<T, N> math functions are vectorized.
+template <typename T, int N>
+struct is_simd
+    : std::integral_constant<bool, ((std::is_same<T, float>::value ||
+                                     std::is_same<T, double>::value) &&
+                                    simd_lanes<T, N>() > 0)> {};
+
+#ifdef __SYNTHESIS__
+#define DEFINE_SIMD(expr)
+#else // __SYNTHESIS__
+#define DEFINE_SIMD(expr)                                                      \
+  template <typename T, int L> static reg_t<T, L> simd(reg_t<T, L> x) {        \
+    return expr;                                                               \
+  }
+#endif // __SYNTHESIS__
+
+// Function objects of both the libm and the SIMD versions of each function.
+#define DEFINE_OP(func, libm_expr, simd_expr)                                  \
+  template <accuracy A> struct func##_op {                                     \
+    template <typename T> static T scalar(T x) { return libm_expr; }           \
+    DEFINE_SIMD(simd_expr)                                                     \
+  };
+DEFINE_OP(exp, std::exp(x), (math::exp<A, T, L>(x)))
+DEFINE_OP(log, std::log(x), (math::log<A, T, L>(x)))
+DEFINE_OP(sqrt, std::sqrt(x), (math::sqrt<T, L>(x)))
+DEFINE_OP(rsqrt, 1 / std::sqrt(x), (math::rsqrt<A, T, L>(x)))
+DEFINE_OP(sin, std::sin(x), (math::sincos<A, false, T, L>(x)))
+DEFINE_OP(cos, std::cos(x), (math::sincos<A, true, T, L>(x)))
+DEFINE_OP(tanh, std::tanh(x), (math::tanh<A, T, L>(x)))
+#undef DEFINE_OP
+#undef DEFINE_SIMD
+
+template <accuracy A> struct pow_op {
+  template <typename T> static T scalar(T x, T y) { return std::pow(x, y); }
+#ifndef __SYNTHESIS__
+  template <typename T, int L>
+  static reg_t<T, L> simd(reg_t<T, L> x, reg_t<T, L> y) {
+    return math::pow<A, T, L>(x, y);
+  }
+#endif // __SYNTHESIS__
+};
+
+} // namespace math
+
+} // namespace internal
+
+// unary math functions, vectorized for float and double
+#define DEFINE_FUNC(func, accuracy)                                            \
+  template <typename T, int N> vec_t<T, N> func(const vec_t<T, N> &vec) {      \
+    _Pragma("HLS inline");                                                     \
+    vec_t<T, N> result;                                                        \
+    internal::math::apply<T, N>(                                               \
+        &vec[0], &vec[0], &result[0],                                          \
+        internal::math::func##_op<internal::math::accuracy>(),                 \
+        internal::math::is_simd<T, N>());                                      \
+    return result;                                                             \
+  }
+DEFINE_FUNC(exp, kPrecise)
+DEFINE_FUNC(log, kPrecise)
+DEFINE_FUNC(sqrt, kPrecise)
+DEFINE_FUNC(rsqrt, kPrecise)
+DEFINE_FUNC(sin, kPrecise)
+DEFINE_FUNC(cos, kPrecise)
+DEFINE_FUNC(tanh, kPrecise)
+
+// pow(x, y) for each lane
+template <typename T, int N>
+vec_t<T, N> pow(const vec_t<T, N> &x, const vec_t<T, N> &y) {
+  _Pragma("HLS inline");
+  vec_t<T, N> result;
+  internal::math::apply2<T, N>(
+      &x[0], &y[0], &result[0],
+      internal::math::pow_op<internal::math::kPrecise>(),
+      internal::math::is_simd<T, N>());
+  return result;
+}
+
+/// Faster math functions at reduced accuracy; see vec_math.h for the errors
+/// and the inputs they accept.
+namespace fast {
+
+DEFINE_FUNC(exp, kFast)
+DEFINE_FUNC(log, kFast)
+DEFINE_FUNC(rsqrt, kFast)
+DEFINE_FUNC(sin, kFast)
+DEFINE_FUNC(cos, kFast)
+DEFINE_FUNC(tanh, kFast)
+
+template <typename T, int N>
+vec_t<T, N> pow(const vec_t<T, N> &x, const vec_t<T, N> &y) {
+  _Pragma("HLS inline");
+  vec_t<T, N> result;
+  internal::math::apply2<T, N>(
+      &x[0], &y[0], &result[0], internal::math::pow_op<internal::math::kFast>(),
+      internal::math::is_simd<T, N>());
+  return result;
+}
+
+} // namespace fast
+
+#undef DEFINE_FUNC
+
+} // namespace task
+
+#endif // TASK_VEC_MATH_H_
@@ -0,0 +1,230 @@
+#ifndef TASK_WRITE_COMBINER_H_
+#define TASK_WRITE_COMBINER_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#include "task/mmap.h"
+
+namespace task {
+
+namespace internal {
+
+// Copies `bytes` from `src` to `dst` with non-temporal stores, so that the
+// written lines bypass the cache. `dst` must be 16-byte aligned and `bytes` a
+// multiple of 16. The stores are weakly ordered until `store_fence` is called.
+inline void stream_copy(void *dst, const void *src, uint64_t bytes) {
+#ifdef __SSE2__
+  auto out = static_cast<__m128i *>(dst);
+  auto in = static_cast<const __m128i *>(src);
+  for (uint64_t i = 0; i < bytes / 16; ++i) {
+    _mm_stream_si128(out + i, _mm_loadu_si128(in + i));
+  }
+#else  // __SSE2__
+  memcpy(dst, src, bytes);
+#endif // __SSE2__
+}
+
+inline void store_fence() {
+#ifdef __SSE2__
+  _mm_sfence();
+#else  // __SSE2__
+  std::atomic_thread_fence(std::memory_order_release);
+#endif // __SSE2__
+}
+
+} // namespace internal
+
+/// Combines scattered writes to a @c task::mmap or @c task::async_mmap into
+/// chunks of consecutive elements.
+///
+/// Writes are buffered per destination region, e.g., per partition, and each
+/// region is expected to be written at consecutive addresses. A region's buffer
+/// is flushed when it reaches a @c ChunkBytes boundary of the destination, or
+/// when a write to the region is not consecutive. Whole chunks of a
+/// @c task::mmap are flushed with non-temporal stores, so the data do not
+/// pollute the cache; a @c task::async_mmap is flushed as a burst of write
+/// requests.
+///
+/// Written data are not guaranteed to be visible before @c flush returns. While
+/// a @c task::async_mmap is written via a @c task::write_combiner, its write
+/// responses are consumed by the @c task::write_combiner.
+///
+/// Canonical usage:
+/// @code{.cpp}
+///  void Kernel(task::mmap<Update> updates, ...) {
+///    task::write_combiner<Update> combiner(updates, num_partitions);
+///    ...
+///    combiner.write(pid, offsets[pid]++, update);
+///    ...
+///    combiner.flush();
+///  }
+/// @endcode
+///
+/// @tparam T          Type of each element.
+/// @tparam ChunkBytes Size of each region's buffer (in bytes), e.g., 64 for a
+///                    cache line or 4096 for a page.
+template <typename T, uint64_t ChunkBytes = 64> class write_combiner {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "T must be trivially copyable");
+  static_assert(ChunkBytes % 16 == 0, "ChunkBytes must be a multiple of 16");
+
+public:
+  /// Type of the addresses.
+  using addr_t = int64_t;
+
+  /// Number of elements buffered per region.
+  static constexpr uint64_t chunk_length =
+      ChunkBytes < sizeof(T) ? 1 : ChunkBytes / sizeof(T);
+
+  /// Constructs a @c task::write_combiner that writes to a @c task::mmap.
+  ///
+  /// @param mem          Memory to write to.
+  /// @param region_count Number of destination regions.
+  write_combiner(mmap<T> mem, uint64_t region_count)
+      : ptr_(mem.get()), async_mem_(nullptr), regions_(region_count),
+        is_traced_(internal::is_tracing()) {}
+
+  /// Constructs a @c task::write_combiner that writes to a
+  /// @c task::async_mmap.
+  ///
+  /// @param mem          Memory to write to; must outlive the combiner.
+  /// @param region_count Number of destination regions.
+  write_combiner(async_mmap<T> &mem, uint64_t region_count)
+      : ptr_(nullptr), async_mem_(&mem), regions_(region_count),
+        is_traced_(false) {}
+
+  write_combiner(const write_combiner &) = delete;
+  write_combiner &operator=(const write_combiner &) = delete;
+
+  /// Buffers a write of @c val to element @c addr of region @c region.
+  ///
+  /// @param region Destination region, in <tt>[0, region_count)</tt>.
+  /// @param addr   Destination address (in unit of element count).
+  /// @param val    Value to write.
+  void write(uint64_t region, addr_t addr, const T &val) {
+    auto &buffer = regions_[region];
+    if (addr != buffer.addr + addr_t(buffer.size)) {
+      flush_region(buffer);
+      buffer.addr = addr;
+      // chunks end at ChunkBytes boundaries so that whole lines are streamed
+      const uint64_t offset = get_offset(addr);
+      buffer.capacity = std::min<uint64_t>(
+          chunk_length, (ChunkBytes - offset + sizeof(T) - 1) / sizeof(T));
+    }
+    buffer.data[buffer.size++] = val;
+    if (buffer.size == buffer.capacity) {
+      flush_region(buffer);
+    }
+  }
+
+  /// Writes all buffered data and waits until they are visible.
+  ///
+  /// For @c task::async_mmap, waits until all writes are acknowledged.
+  void flush() {
+    for (auto &buffer : regions_) {
+      flush_region(buffer);
+    }
+    if (async_mem_ == nullptr) {
+      internal::store_fence();
+    } else {
+      while (ack_count_ < write_count_) {
+        receive_ack(/*is_blocking=*/true);
+      }
+    }
+  }
+
+  /// Writes the buffered data of region @c region.
+  ///
+  /// The data are not guaranteed to be visible before @c flush returns.
+  void flush(uint64_t region) { flush_region(regions_[region]); }
+
+private:
+  struct chunk {
+    addr_t addr = -1;      // address of data[0]
+    uint64_t size = 0;     // number of elements buffered
+    uint64_t capacity = 0; // number of elements before the chunk boundary
+    T data[chunk_length];
+  };
+
+  T *const ptr_;
+  async_mmap<T> *const async_mem_;
+  std::vector<chunk> regions_;
+  uint64_t write_count_ = 0; // writes sent to async_mem_
+  uint64_t ack_count_ = 0;   // writes acknowledged by async_mem_
+  const bool is_traced_;     // async_mmap traces its own writes
+
+  void flush_region(chunk &buffer) {
+    if (buffer.size == 0) {
+      return;
+    }
+    if (async_mem_ == nullptr) {
+      T *dst = ptr_ + buffer.addr;
+      if (buffer.size * sizeof(T) == ChunkBytes &&
+          get_offset(buffer.addr) == 0) {
+        internal::stream_copy(dst, buffer.data, ChunkBytes);
+      } else {
+        // partial lines are slow to stream; leave them to the cache
+        std::copy(buffer.data, buffer.data + buffer.size, dst);
+      }
+      if (is_traced_) {
+        internal::trace_access(ptr_, buffer.addr * sizeof(T),
+                               buffer.size * sizeof(T), trace::kWrite);
+      }
+    } else {
+      for (uint64_t i = 0; i < buffer.size; ++i) {
+        send(async_mem_->write_addr, buffer.addr + addr_t(i));
+        send(async_mem_->write_data, buffer.data[i]);
+      }
+      write_count_ += buffer.size;
+    }
+    buffer.addr += buffer.size;
+    buffer.capacity -= buffer.size;
+    if (buffer.capacity == 0) {
+      buffer.capacity = chunk_length;
+    }
+    buffer.size = 0;
+  }
+
+  // Returns the offset of element addr in its ChunkBytes-aligned chunk.
+  uint64_t get_offset(addr_t addr) const {
+    return async_mem_ == nullptr
+               ? reinterpret_cast<uintptr_t>(ptr_ + addr) % ChunkBytes
+               : uint64_t(addr) * sizeof(T) % ChunkBytes;
+  }
+
+  // Writes to a request channel of async_mem_. If it is full, receives all
+  // responses available first, so that the service is not blocked on them.
+  template <typename U> void send(ostream<U> &stream, const U &val) {
+    if (!stream.try_write(val)) {
+      while (receive_ack(/*is_blocking=*/false)) {
+      }
+      stream.write(val);
+    }
+  }
+
+  // Returns whether a write response is received.
+  bool receive_ack(bool is_blocking) {
+    typename async_mmap<T>::resp_t resp;
+    if (is_blocking) {
+      resp = async_mem_->write_resp.read();
+    } else if (!async_mem_->write_resp.try_read(resp)) {
+      return false;
+    }
+    ack_count_ += uint64_t(resp) + 1;
+    return true;
+  }
+};
+
+} // namespace task
+
+#endif // TASK_WRITE_COMBINER_H_
@@ -0,0 +1,246 @@
+// Shows live throughput of a running libtask program, like top.
+//
+// Usage: tasktop <pid> [interval_ms] [iterations]
+//
+// The program must be started with environment variable TASK_METRICS set.
+
+#include <cerrno>
+#include <cinttypes>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "task/metrics.h"
+
+using std::string;
+using std::vector;
+
+namespace metrics = task::metrics;
+
+namespace {
+
+// Copies a consistent snapshot of the segment of process `pid` into `buffer`.
+bool Sample(int pid, vector<char> &buffer) {
+  const string name = metrics::segment_name(pid);
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat sb;
+  void *ptr = MAP_FAILED;
+  if (fstat(fd, &sb) == 0 && sb.st_size >= off_t(metrics::segment_size())) {
+    ptr =
+        mmap(nullptr, metrics::segment_size(), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    return false;
+  }
+  const auto segment = static_cast<const metrics::header *>(ptr);
+  auto snapshot = reinterpret_cast<metrics::header *>(buffer.data());
+  bool succeeded = false;
+  if (segment->magic == metrics::kMagic &&
+      segment->version == metrics::kVersion) {
+    for (int retry = 0; retry < 1000 && !succeeded; ++retry) {
+      succeeded = metrics::read(segment, snapshot);
+      if (!succeeded) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  munmap(ptr, metrics::segment_size());
+  return succeeded;
+}
+
+string Truncate(const char *str, size_t width) {
+  string result = str;
+  if (result.size() > width) {
+    result = result.substr(0, width - 3) + "...";
+  }
+  return result;
+}
+
+const char *StateName(uint8_t state) {
+  switch (state) {
+  case metrics::kRunning:
+    return "running";
+  case metrics::kBlockedEmpty:
+    return "empty";
+  case metrics::kBlockedFull:
+    return "full";
+  case metrics::kFinished:
+    return "finished";
+  }
+  return "?";
+}
+
+void Show(const metrics::header *curr, const metrics::header *prev,
+          int rows) {
+  const auto tasks = metrics::tasks(curr);
+  const auto channels = metrics::channels(curr);
+
+  // rates are measured against the previous sample of the same task or
+  // channel, which may be in a different slot
+  const bool has_prev =
+      prev != nullptr && prev->timestamp_ns < curr->timestamp_ns;
+  const double seconds =
+      has_prev ? (curr->timestamp_ns - prev->timestamp_ns) * 1e-9 : 0.;
+  std::unordered_map<uint64_t, uint64_t> prev_token_counts;
+  std::unordered_map<uint64_t, uint64_t> prev_resume_counts;
+  if (has_prev) {
+    for (uint32_t i = 0; i < prev->channel_count; ++i) {
+      const auto &channel = metrics::channels(prev)[i];
+      prev_token_counts[channel.id] = channel.token_count;
+    }
+    for (uint32_t i = 0; i < prev->task_count; ++i) {
+      const auto &task = metrics::tasks(prev)[i];
+      prev_resume_counts[task.id] = task.resume_count;
+    }
+  }
+
+  int blocked_count = 0;
+  int finished_count = 0;
+  for (uint32_t i = 0; i < curr->task_count; ++i) {
+    if (tasks[i].state == metrics::kBlockedEmpty ||
+        tasks[i].state == metrics::kBlockedFull) {
+      ++blocked_count;
+    } else if (tasks[i].state == metrics::kFinished) {
+      ++finished_count;
+    }
+  }
+
+  printf("tasktop - pid %d - %u tasks (%d blocked, %d finished), "
+         "%u channels\n\n",
+         curr->pid, curr->task_count, blocked_count, finished_count,
+         curr->channel_count);
+
+  struct channel_row {
+    uint32_t index;
+    double rate;
+  };
+  vector<channel_row> channel_rows;
+  for (uint32_t i = 0; i < curr->channel_count; ++i) {
+    double rate = 0.;
+    auto it = prev_token_counts.find(channels[i].id);
+    if (it != prev_token_counts.end()) {
+      rate = (channels[i].token_count - it->second) / seconds;
+    }
+    channel_rows.push_back({i, rate});
+  }
+  std::stable_sort(channel_rows.begin(), channel_rows.end(),
+                   [](const channel_row &lhs, const channel_row &rhs) {
+                     return lhs.rate > rhs.rate;
+                   });
+  printf("%-40s %8s %9s %14s %14s\n", "CHANNEL", "DEPTH", "OCCUPANCY",
+         "TOKENS", "TOKENS/S");
+  for (int i = 0; i < std::min<int>(rows, channel_rows.size()); ++i) {
+    const auto &channel = channels[channel_rows[i].index];
+    printf("%-40s %8" PRIu64 " %8.0f%% %14" PRIu64 " %14.0f\n",
+           Truncate(channel.name, 40).c_str(), channel.depth,
+           channel.depth == 0 ? 0. : channel.size * 100. / channel.depth,
+           channel.token_count, channel_rows[i].rate);
+  }
+
+  // blocked tasks first, then running ones, then finished ones
+  vector<uint32_t> task_rows;
+  for (uint32_t i = 0; i < curr->task_count; ++i) {
+    task_rows.push_back(i);
+  }
+  auto rank = [tasks](uint32_t i) {
+    switch (tasks[i].state) {
+    case metrics::kBlockedEmpty:
+    case metrics::kBlockedFull:
+      return 0;
+    case metrics::kRunning:
+      return 1;
+    }
+    return 2;
+  };
+  std::stable_sort(
+      task_rows.begin(), task_rows.end(),
+      [&rank](uint32_t lhs, uint32_t rhs) { return rank(lhs) < rank(rhs); });
+  printf("\n%-40s %6s %8s %-30s %12s\n", "TASK", "REGION", "STATE",
+         "BLOCKED ON", "RESUMES/S");
+  for (int i = 0; i < std::min<int>(rows, task_rows.size()); ++i) {
+    const auto &task = tasks[task_rows[i]];
+    double rate = 0.;
+    auto it = prev_resume_counts.find(task.id);
+    if (it != prev_resume_counts.end()) {
+      rate = (task.resume_count - it->second) / seconds;
+    }
+    const string name = string(task.name) + (task.detached ? "*" : "");
+    const string channel =
+        task.blocked_channel < 0 ||
+                task.blocked_channel >= int64_t(curr->channel_count)
+            ? "-"
+            : Truncate(channels[task.blocked_channel].name, 30);
+    printf("%-40s %6d %8s %-30s %12.0f\n", Truncate(name.c_str(), 40).c_str(),
+           task.region, StateName(task.state), channel.c_str(), rate);
+  }
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <pid> [interval_ms] [iterations]"
+              << std::endl;
+    return 1;
+  }
+  const int pid = atoi(argv[1]);
+  const int interval_ms = argc > 2 ? atoi(argv[2]) : 1000;
+  const int iterations = argc > 3 ? atoi(argv[3]) : 0;
+  const bool is_tty = isatty(STDOUT_FILENO);
+
+  vector<char> curr(metrics::segment_size());
+  vector<char> prev(metrics::segment_size());
+  bool has_prev = false;
+  for (int i = 0; iterations == 0 || i < iterations; ++i) {
+    if (i > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+    if (kill(pid, 0) != 0 && errno == ESRCH) {
+      std::cerr << "process " << pid << " exited" << std::endl;
+      return 0;
+    }
+
+    int rows = 20;
+    winsize ws;
+    if (is_tty && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+      printf("\033[H\033[2J");
+      rows = std::max(1, (ws.ws_row - 8) / 2);
+    }
+    if (!Sample(pid, curr)) {
+      printf("waiting for metrics of process %d; "
+             "is it running with TASK_METRICS=1?\n",
+             pid);
+      has_prev = false;
+      fflush(stdout);
+      continue;
+    }
+    Show(reinterpret_cast<const metrics::header *>(curr.data()),
+         has_prev ? reinterpret_cast<const metrics::header *>(prev.data())
+                  : nullptr,
+         rows);
+    std::swap(curr, prev);
+    has_prev = true;
+  }
+  return 0;
+}
@@ -0,0 +1,303 @@
+// Summarizes a memory access trace of a libtask program.
+//
+// Usage: tracestat <trace> [line_size]
+//
+// The trace is written by a program run with environment variable TASK_TRACE
+// set to its filename. Reports the bytes accessed per bank and per task, the
+// stride histogram of each bank, and the reuse distance histogram in unit of
+// cache lines of line_size bytes (default: 64).
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "task/trace.h"
+
+using std::string;
+using std::vector;
+
+namespace trace = task::trace;
+
+namespace {
+
+struct Trace {
+  vector<trace::record> records;
+  std::map<uint64_t, string> tasks;
+  std::map<uint64_t, uint64_t> banks; // id -> base address
+};
+
+bool Load(const string &filename, Trace &result) {
+  std::ifstream file(filename, std::ios::binary);
+  const string data((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(trace::kMagic) ||
+      memcmp(data.data(), trace::kMagic, sizeof(trace::kMagic)) != 0) {
+    fprintf(stderr, "'%s' is not a libtask trace\n", filename.c_str());
+    return false;
+  }
+  const char *ptr = data.data() + sizeof(trace::kMagic);
+  const char *const end = data.data() + data.size();
+  while (ptr < end) {
+    const char tag = *ptr++;
+    uint64_t n;
+    if (!trace::get_varint(ptr, end, n)) {
+      break;
+    }
+    if (tag == trace::kChunkTag) {
+      if (n > uint64_t(end - ptr)) {
+        break;
+      }
+      const char *const chunk_end = ptr + n;
+      trace::record record;
+      while (ptr < chunk_end && trace::decode(ptr, chunk_end, record)) {
+        result.records.push_back(record);
+      }
+      ptr = chunk_end;
+    } else if (tag == trace::kTaskTag) {
+      for (uint64_t i = 0; i < n; ++i) {
+        uint64_t id, length;
+        if (!trace::get_varint(ptr, end, id) ||
+            !trace::get_varint(ptr, end, length) ||
+            length > uint64_t(end - ptr)) {
+          ptr = end;
+          break;
+        }
+        result.tasks[id] = string(ptr, length);
+        ptr += length;
+      }
+    } else if (tag == trace::kBankTag) {
+      for (uint64_t i = 0; i < n; ++i) {
+        uint64_t id, base;
+        if (!trace::get_varint(ptr, end, id) ||
+            !trace::get_varint(ptr, end, base)) {
+          ptr = end;
+          break;
+        }
+        result.banks[id] = base;
+      }
+    } else {
+      fprintf(stderr, "unknown section '%c'\n", tag);
+      return false;
+    }
+  }
+  if (ptr != end) {
+    fprintf(stderr, "'%s' is truncated\n", filename.c_str());
+  }
+  std::stable_sort(result.records.begin(), result.records.end(),
+                   [](const trace::record &lhs, const trace::record &rhs) {
+                     return lhs.timestamp_ns < rhs.timestamp_ns;
+                   });
+  return true;
+}
+
+// Returns floor(log2(n)) + 1, or 0 if n is 0.
+int Log2Bucket(uint64_t n) { return n == 0 ? 0 : 64 - __builtin_clzll(n); }
+
+// Formats the lower bound of a log2 bucket, e.g., 4K for bucket 13.
+string FormatBound(int bucket) {
+  if (bucket == 0) {
+    return "0";
+  }
+  const char *const units[] = {"", "K", "M", "G", "T", "P", "E"};
+  const int shift = bucket - 1;
+  return std::to_string(uint64_t(1) << (shift % 10)) + units[shift / 10];
+}
+
+// Prints a histogram of log2 buckets, which are negated for negative values.
+// INT32_MAX and INT32_MIN denote sequential and cold accesses, respectively.
+void PrintHistogram(const std::map<int, uint64_t> &histogram,
+                    const char *indent, bool is_signed) {
+  uint64_t total = 0;
+  for (const auto &bucket : histogram) {
+    total += bucket.second;
+  }
+  for (const auto &bucket : histogram) {
+    printf("%s%-20s %12" PRIu64 " %6.2f%%\n", indent,
+           bucket.first == INT32_MAX ? "sequential"
+           : bucket.first == INT32_MIN
+               ? "cold"
+               : ((bucket.first < 0 ? "-" : is_signed ? "+" : "") +
+                  FormatBound(std::abs(bucket.first)))
+                     .c_str(),
+           bucket.second, 100. * bucket.second / total);
+  }
+}
+
+struct Usage {
+  uint64_t request_count[3] = {};
+  uint64_t byte_count[3] = {};
+};
+
+void PrintUsage(const string &name, const Usage &usage) {
+  printf("  %-40s", name.c_str());
+  for (int kind = 0; kind < 3; ++kind) {
+    printf(" %10" PRIu64 " %14" PRIu64, usage.request_count[kind],
+           usage.byte_count[kind]);
+  }
+  printf("\n");
+}
+
+void PrintUsageHeader(const char *title) {
+  printf("%s\n  %-40s %10s %14s %10s %14s %10s %14s\n", title, "",
+         "reads", "read bytes", "writes", "write bytes", "accesses",
+         "access bytes");
+}
+
+void ReportUsage(const Trace &trace) {
+  std::map<uint64_t, Usage> bank_usage, task_usage;
+  for (const auto &record : trace.records) {
+    for (auto usage : {&bank_usage[record.bank], &task_usage[record.task]}) {
+      ++usage->request_count[record.kind];
+      usage->byte_count[record.kind] += record.size;
+    }
+  }
+
+  PrintUsageHeader("per bank:");
+  for (const auto &bank : bank_usage) {
+    char name[64];
+    auto it = trace.banks.find(bank.first);
+    snprintf(name, sizeof(name), "bank %" PRIu64 " @ 0x%" PRIx64, bank.first,
+             it == trace.banks.end() ? 0 : it->second);
+    PrintUsage(name, bank.second);
+  }
+  PrintUsageHeader("per task:");
+  for (const auto &task : task_usage) {
+    auto it = trace.tasks.find(task.first);
+    PrintUsage(it == trace.tasks.end() ? "task " + std::to_string(task.first)
+                                       : it->second,
+               task.second);
+  }
+}
+
+// Strides are measured between consecutive accesses of the same kind by the
+// same task to the same bank; "sequential" means an access starts where the
+// previous one ends.
+void ReportStrides(const Trace &trace) {
+  std::map<uint64_t, std::map<int, uint64_t>> histograms; // per bank
+  std::map<std::tuple<uint64_t, uint64_t, int>, const trace::record *> prevs;
+  for (const auto &record : trace.records) {
+    auto &prev = prevs[std::make_tuple(record.task, record.bank, record.kind)];
+    if (prev != nullptr) {
+      int bucket;
+      if (record.offset == prev->offset + prev->size) {
+        bucket = INT32_MAX;
+      } else if (record.offset >= prev->offset) {
+        bucket = Log2Bucket(record.offset - prev->offset);
+      } else {
+        bucket = -Log2Bucket(prev->offset - record.offset);
+      }
+      ++histograms[record.bank][bucket];
+    }
+    prev = &record;
+  }
+  printf("strides in bytes:\n");
+  for (const auto &histogram : histograms) {
+    printf("  bank %" PRIu64 ":\n", histogram.first);
+    PrintHistogram(histogram.second, "    ", /*is_signed=*/true);
+  }
+}
+
+// Returns the first and last cache lines accessed by record, in the address
+// space of all banks; banks without a known base address are placed apart.
+std::pair<uint64_t, uint64_t> GetLineRange(const Trace &trace,
+                                           const trace::record &record,
+                                           uint64_t line_size) {
+  auto it = trace.banks.find(record.bank);
+  const uint64_t base =
+      it != trace.banks.end() ? it->second : record.bank << 48;
+  return {(base + record.offset) / line_size,
+          (base + record.offset + record.size - 1) / line_size};
+}
+
+// Reuse distance is the number of distinct cache lines accessed between two
+// accesses to the same line, counted with a Fenwick tree over access indices
+// in which only the latest access to each line is marked.
+void ReportReuseDistance(const Trace &trace, uint64_t line_size) {
+  uint64_t access_count = 0;
+  for (const auto &record : trace.records) {
+    if (record.size > 0) {
+      const auto lines = GetLineRange(trace, record, line_size);
+      access_count += lines.second - lines.first + 1;
+    }
+  }
+  vector<int32_t> tree(access_count + 1);
+  auto update = [&](uint64_t i, int32_t delta) {
+    if (i >= access_count) {
+      fprintf(stderr, "access index %" PRIu64 " out of range [0, %" PRIu64
+              ")\n", i, access_count);
+      abort();
+    }
+    for (++i; i < tree.size(); i += i & -i) {
+      tree[i] += delta;
+    }
+  };
+  auto query = [&](uint64_t i) { // sum of [0, i)
+    int64_t sum = 0;
+    for (; i > 0; i -= i & -i) {
+      sum += tree[i];
+    }
+    return sum;
+  };
+
+  std::unordered_map<uint64_t, uint64_t> last_access; // line -> index
+  std::map<int, uint64_t> histogram;
+  uint64_t index = 0;
+  for (const auto &record : trace.records) {
+    if (record.size == 0) {
+      continue;
+    }
+    const auto lines = GetLineRange(trace, record, line_size);
+    for (uint64_t line = lines.first; line <= lines.second; ++line, ++index) {
+      auto it = last_access.find(line);
+      if (it == last_access.end()) {
+        ++histogram[INT32_MIN];
+        last_access.emplace(line, index);
+      } else {
+        const uint64_t distance = query(index) - query(it->second + 1);
+        ++histogram[Log2Bucket(distance)];
+        update(it->second, -1);
+        it->second = index;
+      }
+      update(index, 1);
+    }
+  }
+  printf("reuse distance in %" PRIu64 "-byte lines:\n", line_size);
+  PrintHistogram(histogram, "  ", /*is_signed=*/false);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s <trace> [line_size]\n", argv[0]);
+    return 1;
+  }
+  const uint64_t line_size = argc > 2 ? strtoull(argv[2], nullptr, 10) : 64;
+  if (line_size == 0) {
+    fprintf(stderr, "line_size must be positive\n");
+    return 1;
+  }
+
+  Trace trace;
+  if (!Load(argv[1], trace)) {
+    return 1;
+  }
+  printf("%zu accesses, %zu tasks, %zu banks\n", trace.records.size(),
+         trace.tasks.size(), trace.banks.size());
+  ReportUsage(trace);
+  ReportStrides(trace);
+  ReportReuseDistance(trace, line_size);
+  return 0;
+}